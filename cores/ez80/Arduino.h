@@ -34,6 +34,21 @@ extern "C"{
 #define _NOP() do { __asm("nop"); } while (0)
 #endif
 
+// Placement in the 8 KB zero wait state internal RAM (flash and external SRAM
+// have one wait state). RAMFUNC code and FASTDATA variables are copied there at
+// startup, FASTBSS variables are zeroed. Code called from a RAMFUNC, including
+// compiler helpers, still runs from flash. examples/RamFuncBenchmark times the
+// same code from all three memories.
+#define RAMFUNC  __attribute__((section(".ramfunc"), noinline))
+#define FASTDATA __attribute__((section(".fastdata")))
+#define FASTBSS  __attribute__((section(".fastbss")))
+
+// Called from the 1 ms tick, with interrupts disabled, when the canary at the
+// bottom of the stack has been overwritten (only with the stack in the
+// internal RAM). The default halts; a sketch can
+// define its own, e.g. to report the overflow. It must not return.
+void stackOverflow(void);
+
 #define NOT_A_PIN 255
 #define NOT_A_PORT 255
 
@@ -63,6 +78,8 @@ extern "C"{
 
 #ifdef __cplusplus
 /* cpp inports todo */
+#include "fast_gpio.h"
+#include "port_io.h"
 #endif
 
 #ifdef __cplusplus
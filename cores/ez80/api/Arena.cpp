@@ -0,0 +1,92 @@
+/*
+  Arena.cpp - Bump pointer allocator for short lived memory
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "Arena.h"
+#include "String.h"
+
+namespace arduino {
+
+ArenaScope *ArenaScope::_innermost = nullptr;
+
+Arena::Arena(void *buffer, size_t size) : _base((uint8_t *)buffer), _size(buffer ? size : 0), _used(0), _peak(0), _heap(false)
+{
+}
+
+Arena::Arena(size_t size) : _base((uint8_t *)malloc(size)), _size(0), _used(0), _peak(0), _heap(true)
+{
+	if (_base) _size = size;
+}
+
+Arena::~Arena()
+{
+	if (_heap) free(_base);
+}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+	size_t start = (_used + ((size_t)-(uintptr_t)(_base + _used) & (align - 1)));
+	if (start > _size || size > _size - start) return nullptr;
+	_used = start + size;
+	if (_used > _peak) _peak = _used;
+	return _base + start;
+}
+
+void *Arena::reallocate(void *p, size_t old_size, size_t new_size)
+{
+	if (!p) return allocate(new_size);
+	uint8_t *q = (uint8_t *)p;
+	if (q + old_size == _base + _used) {
+		// latest allocation, resize in place
+		size_t start = q - _base;
+		if (new_size > _size - start) return nullptr;
+		release(start + new_size);
+		_used = start + new_size;
+		if (_used > _peak) _peak = _used;
+		return p;
+	}
+	if (new_size <= old_size) return p;
+	void *n = allocate(new_size);
+	if (n) memcpy(n, p, old_size);
+	return n;
+}
+
+void Arena::deallocate(void *p, size_t size)
+{
+	if (p && (uint8_t *)p + size == _base + _used) release((uint8_t *)p - _base);
+}
+
+void Arena::release(size_t m)
+{
+	if (m >= _used) return;
+#if ARENA_DEBUG
+	memset(_base + m, ARENA_POISON, _used - m);
+#endif
+	_used = m;
+}
+
+ArenaScope::~ArenaScope()
+{
+	// leaveArena() takes the String out of the list
+	while (_strings) _strings->leaveArena();
+	_innermost = _outer;
+	_arena.release(_mark);
+}
+
+}
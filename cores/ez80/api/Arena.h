@@ -0,0 +1,134 @@
+/*
+  Arena.h - Bump pointer allocator for short lived memory
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef __cplusplus
+
+#ifndef _ARENA_
+#define _ARENA_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 1 to fill released memory with ARENA_POISON, so that use after release shows up
+#ifndef ARENA_DEBUG
+#define ARENA_DEBUG 0
+#endif
+#define ARENA_POISON 0xA5
+
+namespace arduino {
+
+class String;
+
+// Allocation is a pointer increment in one chunk of memory, and everything is
+// released at once with reset() or release(mark). deallocate() only gives the
+// memory back if it was the latest allocation.
+//
+//   static Arena scratch(4096);
+//
+//   void loop() {
+//     ArenaScope scope(scratch);        // Strings created below use scratch
+//     String line = String(millis()) + ": " + analogRead(A0);
+//     ...
+//   }                                   // all of it released here
+class Arena
+{
+  public:
+    Arena(void *buffer, size_t size);
+    // takes size bytes from the heap once
+    explicit Arena(size_t size);
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // nullptr when the arena is full; align must be a power of two
+    void *allocate(size_t size, size_t align = 1);
+    // grows or shrinks in place if p is the latest allocation, copies otherwise
+    void *reallocate(void *p, size_t old_size, size_t new_size);
+    void deallocate(void *p, size_t size);
+
+    size_t mark() const { return _used; }
+    // releases everything allocated after mark() returned m
+    void release(size_t m);
+    void reset() { release(0); }
+
+    bool owns(const void *p) const { return (const uint8_t *)p >= _base && (const uint8_t *)p < _base + _size; }
+    operator bool() const { return _base != nullptr; }
+    size_t capacity() const { return _size; }
+    size_t used() const { return _used; }
+    size_t available() const { return _size - _used; }
+    size_t highWaterMark() const { return _peak; }
+
+  private:
+    uint8_t *_base;
+    size_t _size;
+    size_t _used;
+    size_t _peak;
+    bool _heap;
+};
+
+// While an ArenaScope exists, new String buffers are taken from its arena
+// (falling back to the heap when it is full), and the arena is released to
+// where it was when the scope ends. Scopes nest. Strings that still hold a
+// buffer in the arena when the scope ends are moved to the heap, so a String
+// may outlive the scope it grew in. If the heap is full such a String is left
+// empty.
+class ArenaScope
+{
+  public:
+    explicit ArenaScope(Arena &arena) : _arena(arena), _mark(arena.mark()), _outer(_innermost), _strings(nullptr) { _innermost = this; }
+    ~ArenaScope();
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+    // arena of the innermost scope, nullptr outside of any scope
+    static Arena *current() { return _innermost ? &_innermost->_arena : nullptr; }
+
+  private:
+    friend class String;
+    Arena &_arena;
+    size_t _mark;
+    ArenaScope *_outer;
+    String *_strings;       // with a buffer in _arena, linked through String::nextInScope
+    static ArenaScope *_innermost;
+};
+
+// Standard allocator interface over an Arena, for containers
+template <typename T>
+class ArenaAllocator
+{
+  public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena &arena) : _arena(&arena) { }
+    template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : _arena(other.arena()) { }
+
+    T *allocate(size_t n) { return (T *)_arena->allocate(n * sizeof(T), alignof(T)); }
+    void deallocate(T *p, size_t n) { _arena->deallocate(p, n * sizeof(T)); }
+
+    Arena *arena() const { return _arena; }
+    template <typename U> bool operator==(const ArenaAllocator<U> &other) const { return _arena == other.arena(); }
+    template <typename U> bool operator!=(const ArenaAllocator<U> &other) const { return _arena != other.arena(); }
+
+  private:
+    Arena *_arena;
+};
+
+}
+
+#endif
+#endif
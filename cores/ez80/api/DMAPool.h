@@ -199,7 +199,7 @@ template <class T, size_t A=__CACHE_LINE_SIZE__> class DMAPool {
         static void *aligned_malloc(size_t size) {
             void **ptr, *stashed;
             size_t offset = A - 1 + sizeof(void *);
-            if ((A % 2) || !((stashed = ::malloc(size + offset)))) {
+            if ((A & (A - 1)) || !((stashed = ::malloc(size + offset)))) {
                 return nullptr;
             }
             ptr = (void **) (((uintptr_t) stashed + offset) & ~(A - 1));
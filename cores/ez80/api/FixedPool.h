@@ -0,0 +1,88 @@
+/*
+  FixedPool.h - Fixed block pool for interrupt context
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef __cplusplus
+
+#ifndef _FIXED_POOL_
+#define _FIXED_POOL_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include <fixed_pool.h>
+
+namespace arduino {
+
+// N objects of type T in static storage, allocated and released in O(1) with
+// interrupts masked for a few instructions, so both an ISR and the sketch can
+// use the same pool:
+//
+//   static FixedPool<CanMsg, 8> can_pool;
+//   CanMsg *msg = can_pool.create(id, len, data);   // in the receive ISR
+//   ...
+//   can_pool.destroy(msg);                           // in loop()
+//
+// See fixed_pool.h for the C version.
+template <typename T, size_t N>
+class FixedPool
+{
+  public:
+    FixedPool() : _pool(FIXED_POOL_INIT(_storage, sizeof(Slot), N)) { }
+    FixedPool(const FixedPool &) = delete;
+    FixedPool &operator=(const FixedPool &) = delete;
+
+    // uninitialised memory for one T, nullptr when the pool is exhausted
+    T *allocate() { return (T *)fixed_pool_alloc(&_pool); }
+    void deallocate(T *p) { fixed_pool_free(&_pool, p); }
+
+    template <typename... Args>
+    T *create(Args &&... args) {
+      void *p = fixed_pool_alloc(&_pool);
+      return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+    }
+    void destroy(T *p) {
+      if (!p) return;
+      p->~T();
+      fixed_pool_free(&_pool, p);
+    }
+
+    bool owns(const void *p) const {
+      return (const uint8_t *)p >= (const uint8_t *)_storage && (const uint8_t *)p < (const uint8_t *)(_storage + N);
+    }
+
+    size_t capacity() const { return N; }
+    size_t used() const { return _pool.used; }
+    size_t available() const { return N - _pool.used; }
+    // most blocks in use at the same time since startup
+    size_t highWaterMark() const { return _pool.peak; }
+
+  private:
+    union Slot {
+      void *next;
+      alignas(T) uint8_t object[sizeof(T)];
+    };
+
+    Slot _storage[N];
+    fixed_pool_t _pool;
+};
+
+}
+
+#endif
+#endif
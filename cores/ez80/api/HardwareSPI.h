@@ -143,3 +143,11 @@ class HardwareSPI
 typedef HardwareSPI SPIClass;
 
 }
+
+using arduino::SPISettings;
+using arduino::SPIMode;
+using arduino::SPI_MODE0;
+using arduino::SPI_MODE1;
+using arduino::SPI_MODE2;
+using arduino::SPI_MODE3;
+using arduino::HardwareSPI;
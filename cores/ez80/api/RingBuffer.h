@@ -22,6 +22,7 @@
 #ifndef _RING_BUFFER_
 #define _RING_BUFFER_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -127,7 +128,8 @@ int RingBufferN<N>::peek()
 template <int N>
 int RingBufferN<N>::nextIndex(int index)
 {
-  return (uint32_t)(index + 1) % N;
+  // a compare instead of % N, which is a library division for most N
+  return index + 1 < N ? index + 1 : 0;
 }
 
 template <int N>
@@ -136,6 +138,141 @@ bool RingBufferN<N>::isFull()
   return (_numElems == N);
 }
 
+// Single producer, single consumer ring buffer, e.g. a receive ISR storing and
+// loop() reading, that needs no interrupt masking: the producer only writes
+// _head and the consumer only writes _tail. Both count up freely and are
+// masked with N - 1 to index the buffer, so N must be a power of two and all
+// N bytes are usable. An index is one word, stored by a single instruction.
+//
+// Producer side: store_char(), write(), availableForStore()
+// Consumer side: read_char(), read(), peek(), readSpan(), consume(), clear()
+template <unsigned int N>
+class SPSCRingBufferN
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SPSCRingBufferN size must be a power of two");
+
+  public:
+    SPSCRingBufferN( void ) : _head(0), _tail(0) { }
+
+    bool store_char( uint8_t c );
+    // stores as much of data as fits with at most two memcpy(), returns the count
+    size_t write( const uint8_t *data, size_t n );
+    size_t availableForStore() const { return N - available(); }
+    bool isFull() const { return available() == N; }
+
+    int read_char();
+    size_t read( uint8_t *data, size_t n );
+    int peek();
+    size_t available() const { return (unsigned int)(_head - _tail); }
+    bool isEmpty() const { return _head == _tail; }
+    // Oldest stored bytes that are contiguous in the buffer, for parsing in
+    // place; length is 0 when empty. The rest, if any, starts at the
+    // beginning of the buffer and is returned by the next call after
+    // consume(length).
+    const uint8_t *readSpan( size_t &length );
+    // drops n bytes (at most available()) after peeking at them
+    void consume( size_t n );
+    void clear() { _tail = _head; }
+
+  private:
+    // keeps the compiler from moving buffer accesses across an index update
+    static inline void barrier() { __asm__ __volatile__("" ::: "memory"); }
+
+    uint8_t _buffer[N];
+    volatile unsigned int _head;    // written by the producer only
+    volatile unsigned int _tail;    // written by the consumer only
+};
+
+template <unsigned int N>
+bool SPSCRingBufferN<N>::store_char( uint8_t c )
+{
+  unsigned int head = _head;
+  if ((unsigned int)(head - _tail) == N)
+    return false;
+  _buffer[head & (N - 1)] = c;
+  barrier();
+  _head = head + 1;
+  return true;
+}
+
+template <unsigned int N>
+size_t SPSCRingBufferN<N>::write( const uint8_t *data, size_t n )
+{
+  unsigned int head = _head;
+  size_t space = N - (unsigned int)(head - _tail);
+  if (n > space)
+    n = space;
+  size_t index = head & (N - 1);
+  size_t first = N - index;
+  if (first > n)
+    first = n;
+  memcpy(_buffer + index, data, first);
+  memcpy(_buffer, data + first, n - first);
+  barrier();
+  _head = head + n;
+  return n;
+}
+
+template <unsigned int N>
+int SPSCRingBufferN<N>::read_char()
+{
+  unsigned int tail = _tail;
+  if (_head == tail)
+    return -1;
+  barrier();
+  uint8_t value = _buffer[tail & (N - 1)];
+  barrier();
+  _tail = tail + 1;
+  return value;
+}
+
+template <unsigned int N>
+size_t SPSCRingBufferN<N>::read( uint8_t *data, size_t n )
+{
+  unsigned int tail = _tail;
+  size_t count = (unsigned int)(_head - tail);
+  if (n > count)
+    n = count;
+  barrier();
+  size_t index = tail & (N - 1);
+  size_t first = N - index;
+  if (first > n)
+    first = n;
+  memcpy(data, _buffer + index, first);
+  memcpy(data + first, _buffer, n - first);
+  barrier();
+  _tail = tail + n;
+  return n;
+}
+
+template <unsigned int N>
+int SPSCRingBufferN<N>::peek()
+{
+  unsigned int tail = _tail;
+  if (_head == tail)
+    return -1;
+  barrier();
+  return _buffer[tail & (N - 1)];
+}
+
+template <unsigned int N>
+const uint8_t *SPSCRingBufferN<N>::readSpan( size_t &length )
+{
+  unsigned int tail = _tail;
+  size_t count = (unsigned int)(_head - tail);
+  size_t index = tail & (N - 1);
+  barrier();
+  length = N - index < count ? N - index : count;
+  return _buffer + index;
+}
+
+template <unsigned int N>
+void SPSCRingBufferN<N>::consume( size_t n )
+{
+  barrier();
+  _tail = _tail + n;
+}
+
 }
 
 #endif /* _RING_BUFFER_ */
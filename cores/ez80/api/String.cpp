@@ -20,6 +20,8 @@
 */
 
 #include "String.h"
+#include "Arena.h"
+#include "StringView.h"
 #include "Common.h"
 #include "itoa.h"
 #include "deprecated-avr-comp/avr/dtostrf.h"
@@ -28,6 +30,91 @@
 
 namespace arduino {
 
+/*********************************************/
+/*  Buffer Allocation                        */
+/*********************************************/
+
+// New buffers come from the arena of the innermost ArenaScope, if any, else
+// from the heap. A String with its buffer in an arena is in the list of that
+// scope, which moves the buffer to the heap when it ends. The buffer only
+// grows in its arena while its scope is the innermost one, otherwise it could
+// grow across the mark of an inner scope.
+
+void String::linkScope(ArenaScope *scope)
+{
+	bufferScope = scope;
+	nextInScope = scope->_strings;
+	scope->_strings = this;
+}
+
+void String::unlinkScope(void)
+{
+	String **p = &bufferScope->_strings;
+	while (*p != this) p = &(*p)->nextInScope;
+	*p = nextInScope;
+	bufferScope = NULL;
+}
+
+// old is NULL or the current buffer, and stays valid if this fails
+char *String::bufferRealloc(char *old, size_t oldSize, size_t newSize)
+{
+	ArenaScope *scope = ArenaScope::_innermost;
+	char *p;
+	if (old && !bufferScope) return (char *)realloc(old, newSize);
+	if (old && bufferScope == scope) {
+		p = (char *)scope->_arena.reallocate(old, oldSize, newSize);
+		if (p) return p;
+	}
+	// a new buffer, copied from old if there is one
+	p = scope ? (char *)scope->_arena.allocate(newSize) : NULL;
+	if (!p) {
+		scope = NULL;
+		p = (char *)malloc(newSize);
+		if (!p) return NULL;
+	}
+	if (old) {
+		memcpy(p, old, oldSize < newSize ? oldSize : newSize);
+		bufferFree(old, oldSize);
+	}
+	if (scope) linkScope(scope);
+	return p;
+}
+
+void String::bufferFree(char *old, size_t size)
+{
+	if (!old) return;
+	if (bufferScope) {
+		bufferScope->_arena.deallocate(old, size);
+		unlinkScope();
+	} else {
+		free(old);
+	}
+}
+
+// called when bufferScope ends. If the heap is full the String is left empty,
+// with the inline buffer, not invalid: the arena memory goes away with the scope
+void String::leaveArena(void)
+{
+	char *old = buffer;
+	if (len <= INLINE_CAPACITY) {
+		memcpy(inlineBuffer, old, len + 1);
+		buffer = inlineBuffer;
+		capacity = INLINE_CAPACITY;
+	} else {
+		buffer = (char *)malloc(len + 1);
+		if (buffer) {
+			memcpy(buffer, old, len + 1);
+			capacity = len;
+		} else {
+			buffer = inlineBuffer;
+			capacity = INLINE_CAPACITY;
+			len = 0;
+			inlineBuffer[0] = 0;
+		}
+	}
+	unlinkScope();
+}
+
 /*********************************************/
 /*  Static Member Initialisation             */
 /*********************************************/
@@ -57,6 +144,12 @@ String::String(const String &value)
 	*this = value;
 }
 
+String::String(const StringView &str)
+{
+	init();
+	copy(str.data(), str.length());
+}
+
 String::String(const __FlashStringHelper *pstr)
 {
 	init();
@@ -64,13 +157,9 @@ String::String(const __FlashStringHelper *pstr)
 }
 
 String::String(String &&rval)
-	: buffer(rval.buffer)
-	, capacity(rval.capacity)
-	, len(rval.len)
 {
-	rval.buffer = NULL;
-	rval.capacity = 0;
-	rval.len = 0;
+	init();
+	move(rval);
 }
 
 String::String(char c)
@@ -142,7 +231,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	if (buffer) free(buffer);
+	if (!isInline()) bufferFree(buffer, capacity + 1);
 }
 
 /*********************************************/
@@ -154,11 +243,12 @@ inline void String::init(void)
 	buffer = NULL;
 	capacity = 0;
 	len = 0;
+	bufferScope = NULL;
 }
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (!isInline()) bufferFree(buffer, capacity + 1);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -173,9 +263,51 @@ bool String::reserve(unsigned int size)
 	return false;
 }
 
+// for appending: grows by half the capacity at least, so a loop of s += c
+// reallocates O(log n) times instead of for every character
+bool String::reserveGrowing(unsigned int size)
+{
+	if (buffer && capacity >= size) return true;
+	if (buffer) {
+		unsigned int grown = capacity + capacity / 2;
+		if (grown > size && changeBuffer(grown)) return true;
+	}
+	return reserve(size);
+}
+
+void String::shrink_to_fit(void)
+{
+	if (!buffer || isInline() || capacity == len) return;
+	if (len <= INLINE_CAPACITY) {
+		char *heap = buffer;
+		unsigned int size = capacity + 1;
+		memcpy(inlineBuffer, heap, len + 1);
+		buffer = inlineBuffer;
+		capacity = INLINE_CAPACITY;
+		bufferFree(heap, size);
+		return;
+	}
+	char *newbuffer = bufferRealloc(buffer, capacity + 1, len + 1);
+	if (newbuffer) {
+		buffer = newbuffer;
+		capacity = len;
+	}
+}
+
 bool String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	if (!buffer && maxStrLen <= INLINE_CAPACITY) {
+		buffer = inlineBuffer;
+		capacity = INLINE_CAPACITY;
+		return true;
+	}
+	char *newbuffer;
+	if (isInline()) {
+		newbuffer = bufferRealloc(NULL, 0, maxStrLen + 1);
+		if (newbuffer) memcpy(newbuffer, inlineBuffer, len + 1);
+	} else {
+		newbuffer = bufferRealloc(buffer, capacity + 1, maxStrLen + 1);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -215,11 +347,20 @@ void String::move(String &rhs)
 {
 	if (this != &rhs)
 	{
-		free(buffer);
-
-		buffer = rhs.buffer;
-		len = rhs.len;
-		capacity = rhs.capacity;
+		if (rhs.isInline()) {
+			// nothing to take over, the characters are copied
+			copy(rhs.inlineBuffer, rhs.len);
+		} else {
+			if (!isInline()) bufferFree(buffer, capacity + 1);
+			buffer = rhs.buffer;
+			len = rhs.len;
+			capacity = rhs.capacity;
+			if (rhs.bufferScope) {
+				ArenaScope *scope = rhs.bufferScope;
+				rhs.unlinkScope();
+				linkScope(scope);
+			}
+		}
 
 		rhs.buffer = NULL;
 		rhs.len = 0;
@@ -237,6 +378,18 @@ String & String::operator = (const String &rhs)
 	return *this;
 }
 
+String & String::operator = (const StringView &rhs)
+{
+	// a slice of this string, moved down in place
+	if (buffer && rhs.data() >= buffer && rhs.data() <= buffer + len) {
+		len = rhs.length();
+		memmove(buffer, rhs.data(), len);
+		buffer[len] = '\0';
+		return *this;
+	}
+	return copy(rhs.data(), rhs.length());
+}
+
 String & String::operator = (String &&rval)
 {
 	move(rval);
@@ -268,12 +421,23 @@ bool String::concat(const String &s)
 	return concat(s.buffer, s.len);
 }
 
+bool String::concat(const StringView &s)
+{
+	// a slice of this string has to be found again after the buffer grows
+	if (buffer && s.data() >= buffer && s.data() < buffer + len) {
+		unsigned int offset = s.data() - buffer;
+		if (!reserveGrowing(len + s.length())) return false;
+		return concat(buffer + offset, s.length());
+	}
+	return concat(s.data(), s.length());
+}
+
 bool String::concat(const char *cstr, unsigned int length)
 {
 	unsigned int newlen = len + length;
 	if (!cstr) return false;
 	if (length == 0) return true;
-	if (!reserve(newlen)) return false;
+	if (!reserveGrowing(newlen)) return false;
 	memcpy(buffer + len, cstr, length);
 	len = newlen;
 	buffer[len] = '\0';
@@ -346,7 +510,7 @@ bool String::concat(const __FlashStringHelper * str)
 	int length = strlen_P((const char *) str);
 	if (length == 0) return true;
 	unsigned int newlen = len + length;
-	if (!reserve(newlen)) return false;
+	if (!reserveGrowing(newlen)) return false;
 	strcpy_P(buffer + len, (const char *) str);
 	len = newlen;
 	return true;
@@ -363,6 +527,13 @@ StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs)
 	return a;
 }
 
+StringSumHelper & operator + (const StringSumHelper &lhs, const StringView &rhs)
+{
+	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+	if (!a.concat(rhs.data(), rhs.length())) a.invalidate();
+	return a;
+}
+
 StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr)
 {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
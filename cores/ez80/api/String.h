@@ -48,10 +48,17 @@ class __FlashStringHelper;
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+// Read only slice of a string, see StringView.h
+class StringView;
+
+// Strings take their buffers from its arena while it exists, see Arena.h
+class ArenaScope;
+
 // The string class
 class String
 {
 	friend class StringSumHelper;
+	friend class ArenaScope;
 	// use a function pointer to allow for "if (s)" without the
 	// complications of an operator bool(). for more information, see:
 	// http://www.artima.com/cppsource/safebool.html
@@ -60,6 +67,8 @@ class String
 
 	static size_t const FLT_MAX_DECIMAL_PLACES = 10;
 	static size_t const DBL_MAX_DECIMAL_PLACES = FLT_MAX_DECIMAL_PLACES;
+	// strings up to this length are kept in the object instead of the heap
+	static unsigned int const INLINE_CAPACITY = 11;
 
 public:
 	// constructors
@@ -71,6 +80,7 @@ public:
 	String(const char *cstr, unsigned int length);
 	String(const uint8_t *cstr, unsigned int length) : String((const char*)cstr, length) {}
 	String(const String &str);
+	explicit String(const StringView &str);
 	String(const __FlashStringHelper *str);
 	String(String &&rval);
 	explicit String(char c);
@@ -88,6 +98,9 @@ public:
 	// is left unchanged).  reserve(0), if successful, will validate an
 	// invalid string (i.e., "if (s)" will be true afterwards)
 	bool reserve(unsigned int size);
+	// gives back the capacity beyond length(), concatenation grows the
+	// buffer ahead of the length
+	void shrink_to_fit(void);
 	inline unsigned int length(void) const {return len;}
 	inline bool isEmpty(void) const { return length() == 0; }
 
@@ -95,6 +108,7 @@ public:
 	// invalid, or if the memory allocation fails, the string will be
 	// marked as invalid ("if (s)" will be false).
 	String & operator = (const String &rhs);
+	String & operator = (const StringView &rhs);
 	String & operator = (const char *cstr);
 	String & operator = (const __FlashStringHelper *str);
 	String & operator = (String &&rval);
@@ -105,6 +119,7 @@ public:
 	// is left unchanged).  if the argument is null or invalid, the
 	// concatenation is considered unsuccessful.
 	bool concat(const String &str);
+	bool concat(const StringView &str);
 	bool concat(const char *cstr);
 	bool concat(const char *cstr, unsigned int length);
 	bool concat(const uint8_t *cstr, unsigned int length) {return concat((const char*)cstr, length);}
@@ -121,6 +136,7 @@ public:
 	// if there's not enough memory for the concatenated value, the string
 	// will be left unchanged (but this isn't signalled in any way)
 	String & operator += (const String &rhs)	{concat(rhs); return (*this);}
+	String & operator += (const StringView &rhs)	{concat(rhs); return (*this);}
 	String & operator += (const char *cstr)		{concat(cstr); return (*this);}
 	String & operator += (char c)			{concat(c); return (*this);}
 	String & operator += (unsigned char num)		{concat(num); return (*this);}
@@ -133,6 +149,7 @@ public:
 	String & operator += (const __FlashStringHelper *str){concat(str); return (*this);}
 
 	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, const StringView &rhs);
 	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
 	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
 	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
@@ -220,9 +237,19 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char inlineBuffer[INLINE_CAPACITY + 1];	// buffer points here for short strings
+	ArenaScope *bufferScope;	// scope whose arena holds buffer, NULL for the heap
+	String *nextInScope;	// next String in the list of bufferScope
 protected:
+	bool isInline(void) const { return buffer == inlineBuffer; }
+	char *bufferRealloc(char *old, size_t oldSize, size_t newSize);
+	void bufferFree(char *old, size_t size);
+	void linkScope(ArenaScope *scope);
+	void unlinkScope(void);
+	void leaveArena(void);
 	void init(void);
 	void invalidate(void);
+	bool reserveGrowing(unsigned int size);
 	bool changeBuffer(unsigned int maxStrLen);
 
 	// copy and move
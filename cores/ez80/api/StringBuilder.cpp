@@ -0,0 +1,37 @@
+/*
+  StringBuilder.cpp - Print into a growing String
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "StringBuilder.h"
+
+namespace arduino {
+
+size_t StringBuilder::write(uint8_t c)
+{
+	if (_str.concat((char)c)) return 1;
+	setWriteError();
+	return 0;
+}
+
+size_t StringBuilder::write(const uint8_t *buffer, size_t size)
+{
+	if (_str.concat((const char *)buffer, size)) return size;
+	setWriteError();
+	return 0;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+  StringBuilder.h - Print into a growing String
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef __cplusplus
+
+#ifndef _STRING_BUILDER_
+#define _STRING_BUILDER_
+
+#include "Print.h"
+#include "String.h"
+
+namespace arduino {
+
+// Everything Print can print, appended to one String. Numbers are converted
+// by Print's digit conversion into a small stack buffer and appended in one
+// write, without the temporary String of `s += String(n)` or `s + n`.
+//
+//   StringBuilder json(1024);            // one allocation for the payload
+//   json.print("{\"t\":");
+//   json.print(millis());
+//   json.print(",\"v\":");
+//   json.print(analogRead(A0) * 3.3 / 1023, 3);
+//   json.print('}');
+//   client.print(json.str());
+//
+// Without a reserve the buffer grows geometrically like String::concat().
+class StringBuilder : public Print
+{
+  public:
+    StringBuilder() { }
+    explicit StringBuilder(unsigned int reserve) { _str.reserve(reserve); }
+
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    template <typename T>
+    StringBuilder &operator<<(const T &value) { print(value); return *this; }
+
+    bool reserve(unsigned int size) { return _str.reserve(size); }
+    void clear() { _str.remove(0); }
+    unsigned int length() const { return _str.length(); }
+    const char *c_str() const { return _str.c_str(); }
+    const String &str() const { return _str; }
+    // moves the result out, the builder is empty afterwards
+    String release() { String s(static_cast<String &&>(_str)); _str = ""; return s; }
+
+  private:
+    String _str;
+};
+
+}
+
+using arduino::StringBuilder;
+
+#endif
+#endif
@@ -0,0 +1,134 @@
+/*
+  StringView.cpp - Read only slice of a string
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "StringView.h"
+
+namespace arduino {
+
+int StringView::indexOf(char ch, unsigned int fromIndex) const
+{
+	if (fromIndex >= _len) return -1;
+	const char *found = (const char *)memchr(_data + fromIndex, ch, _len - fromIndex);
+	return found ? found - _data : -1;
+}
+
+int StringView::indexOf(StringView str, unsigned int fromIndex) const
+{
+	if (fromIndex > _len || str._len > _len - fromIndex) return -1;
+	if (str._len == 0) return fromIndex;
+	// candidates for the first character, then compare the rest
+	const char *p = _data + fromIndex;
+	const char *last = _data + _len - str._len;
+	while (p <= last) {
+		p = (const char *)memchr(p, str._data[0], last - p + 1);
+		if (!p) return -1;
+		if (memcmp(p + 1, str._data + 1, str._len - 1) == 0) return p - _data;
+		p++;
+	}
+	return -1;
+}
+
+int StringView::lastIndexOf(char ch) const
+{
+	for (unsigned int i = _len; i > 0; i--) {
+		if (_data[i - 1] == ch) return i - 1;
+	}
+	return -1;
+}
+
+StringView StringView::substring(unsigned int left, unsigned int right) const
+{
+	if (left > right) {
+		unsigned int temp = right;
+		right = left;
+		left = temp;
+	}
+	if (left >= _len) return StringView(_data + _len, 0);
+	if (right > _len) right = _len;
+	return StringView(_data + left, right - left);
+}
+
+StringView StringView::trim() const
+{
+	const char *begin = _data;
+	const char *end = _data + _len;
+	while (begin < end && isspace((unsigned char)*begin)) begin++;
+	while (end > begin && isspace((unsigned char)end[-1])) end--;
+	return StringView(begin, end - begin);
+}
+
+bool StringView::split(char delimiter, StringView &token)
+{
+	if (_len == 0) return false;
+	const char *found = (const char *)memchr(_data, delimiter, _len);
+	if (!found) {
+		token = *this;
+		_data += _len;
+		_len = 0;
+		return true;
+	}
+	token = StringView(_data, found - _data);
+	_len -= found + 1 - _data;
+	_data = found + 1;
+	return true;
+}
+
+long StringView::toInt() const
+{
+	const char *p = _data;
+	const char *end = _data + _len;
+	bool negative = false;
+	long value = 0;
+	while (p < end && isspace((unsigned char)*p)) p++;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	while (p < end && isdigit((unsigned char)*p)) value = value * 10 + (*p++ - '0');
+	return negative ? -value : value;
+}
+
+float StringView::toFloat() const
+{
+	// atof() needs a terminated string, longer input has no more precision
+	char buf[32];
+	StringView v = trim();
+	unsigned int n = v._len < sizeof(buf) - 1 ? v._len : sizeof(buf) - 1;
+	memcpy(buf, v._data, n);
+	buf[n] = '\0';
+	return atof(buf);
+}
+
+int StringView::compareTo(StringView str) const
+{
+	unsigned int n = _len < str._len ? _len : str._len;
+	int cmp = memcmp(_data, str._data, n);
+	if (cmp) return cmp;
+	return (int)_len - (int)str._len;
+}
+
+bool StringView::equalsIgnoreCase(StringView str) const
+{
+	if (_len != str._len) return false;
+	for (unsigned int i = 0; i < _len; i++) {
+		if (tolower((unsigned char)_data[i]) != tolower((unsigned char)str._data[i])) return false;
+	}
+	return true;
+}
+
+}
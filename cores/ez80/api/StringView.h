@@ -0,0 +1,105 @@
+/*
+  StringView.h - Read only slice of a string
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef __cplusplus
+
+#ifndef _STRING_VIEW_
+#define _STRING_VIEW_
+
+#include <stddef.h>
+#include <string.h>
+#include "String.h"
+
+namespace arduino {
+
+// Pointer and length into characters owned by someone else (a String, a
+// receive buffer, a literal), so slicing and parsing never allocate. The
+// characters need not be '\0' terminated and must outlive the view.
+//
+//   char line[64];
+//   size_t n = Serial.readBytesUntil('\n', line, sizeof(line));
+//   StringView rest(line, n), cmd;
+//   rest.split(' ', cmd);
+//   if (cmd == "SET") {
+//     StringView key, value;
+//     rest.split('=', key);
+//     value = rest.trim();
+//     settings[key.toInt()] = value.toFloat();
+//   }
+class StringView
+{
+  public:
+    constexpr StringView() : _data(""), _len(0) { }
+    StringView(const char *cstr) : _data(cstr ? cstr : ""), _len(cstr ? strlen(cstr) : 0) { }
+    constexpr StringView(const char *data, unsigned int length) : _data(data), _len(length) { }
+    StringView(const String &str) : _data(str.c_str() ? str.c_str() : ""), _len(str.length()) { }
+
+    const char *data() const { return _data; }
+    unsigned int length() const { return _len; }
+    bool isEmpty() const { return _len == 0; }
+    char operator[](unsigned int index) const { return _data[index]; }
+    char charAt(unsigned int index) const { return index < _len ? _data[index] : 0; }
+    const char *begin() const { return _data; }
+    const char *end() const { return _data + _len; }
+
+    // same index rules as String, -1 when not found
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(StringView str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char ch) const;
+    bool startsWith(StringView prefix) const { return prefix._len <= _len && memcmp(_data, prefix._data, prefix._len) == 0; }
+    bool endsWith(StringView suffix) const { return suffix._len <= _len && memcmp(_data + _len - suffix._len, suffix._data, suffix._len) == 0; }
+
+    StringView substring(unsigned int beginIndex) const { return substring(beginIndex, _len); }
+    StringView substring(unsigned int beginIndex, unsigned int endIndex) const;
+    // without leading and trailing white space
+    StringView trim() const;
+    // Sets token to the characters before the first delimiter (or all of
+    // them) and drops those and the delimiter from this view. false once the
+    // view is empty:
+    //   StringView fields("12,,7"), f;
+    //   while (fields.split(',', f)) { ... }      // "12", "", "7"
+    bool split(char delimiter, StringView &token);
+
+    // like String::toInt() / toFloat(): leading white space, a sign, then as
+    // many digits as there are; 0 if there are none
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const { return toFloat(); }
+
+    int compareTo(StringView str) const;
+    bool equals(StringView str) const { return _len == str._len && memcmp(_data, str._data, _len) == 0; }
+    bool equalsIgnoreCase(StringView str) const;
+
+    friend bool operator==(StringView a, StringView b) { return a.equals(b); }
+    friend bool operator!=(StringView a, StringView b) { return !a.equals(b); }
+    friend bool operator<(StringView a, StringView b) { return a.compareTo(b) < 0; }
+    friend bool operator>(StringView a, StringView b) { return a.compareTo(b) > 0; }
+    friend bool operator<=(StringView a, StringView b) { return a.compareTo(b) <= 0; }
+    friend bool operator>=(StringView a, StringView b) { return a.compareTo(b) >= 0; }
+
+  private:
+    const char *_data;
+    unsigned int _len;
+};
+
+}
+
+using arduino::StringView;
+
+#endif
+#endif
@@ -0,0 +1,42 @@
+#ifndef __BLOCKDEV_H_
+#define __BLOCKDEV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sector based storage device, implemented by drivers such as the SdCard library
+   and used by the FAT code in clib. All sectors are BLOCKDEV_SECTOR_SIZE bytes.
+   The functions return 0 on success and a negative value on error. */
+
+#define BLOCKDEV_SECTOR_SIZE 512
+
+typedef struct blockdev {
+    int (*read)(struct blockdev *dev, uint32_t lba, void *buf, size_t count);
+    int (*write)(struct blockdev *dev, uint32_t lba, const void *buf, size_t count);
+    /* write back cached data, may be NULL */
+    int (*sync)(struct blockdev *dev);
+    uint32_t sectors;           /* device size in sectors */
+    void *ctx;                  /* driver data */
+} blockdev_t;
+
+static inline int blockdev_read(blockdev_t *dev, uint32_t lba, void *buf, size_t count) {
+    return dev->read(dev, lba, buf, count);
+}
+
+static inline int blockdev_write(blockdev_t *dev, uint32_t lba, const void *buf, size_t count) {
+    return dev->write(dev, lba, buf, count);
+}
+
+static inline int blockdev_sync(blockdev_t *dev) {
+    return dev->sync ? dev->sync(dev) : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,950 @@
+#include <stdlib.h>
+#include <string.h>
+#include "fat.h"
+
+#define SECTOR_SIZE         BLOCKDEV_SECTOR_SIZE
+#define SECTOR_SHIFT        9
+#define DIR_ENTRY_SIZE      32
+#define ENTRIES_PER_SECTOR  (SECTOR_SIZE / DIR_ENTRY_SIZE)
+
+// directory entry
+#define DIR_NAME            0
+#define DIR_ATTR            11
+#define DIR_CRT_TIME        14
+#define DIR_CRT_DATE        16
+#define DIR_ACC_DATE        18
+#define DIR_CLUS_HI         20
+#define DIR_WRT_TIME        22
+#define DIR_WRT_DATE        24
+#define DIR_CLUS_LO         26
+#define DIR_SIZE            28
+
+#define ATTR_READ_ONLY      0x01
+#define ATTR_VOLUME_ID      0x08            // also set in long name entries
+#define ATTR_DIRECTORY      0x10
+#define ATTR_ARCHIVE        0x20
+
+#define ENTRY_END           0x00
+#define ENTRY_DELETED       0xE5
+
+// there is no clock, new files get 2024-01-01 00:00
+#define FAT_DATE            (((2024 - 1980) << 9) | (1 << 5) | 1)
+#define FAT_TIME            0
+
+// fat_get() results besides cluster numbers and 0 (free)
+#define CLUSTER_EOC         0x0FFFFFFFUL
+#define CLUSTER_ERROR       0xFFFFFFFFUL
+#define FAT32_MASK          0x0FFFFFFFUL
+#define FREE_UNKNOWN        0xFFFFFFFFUL
+
+#define FSINFO_LEAD_SIG     0x41615252UL
+#define FSINFO_STRUC_SIG    0x61417272UL
+#define FSINFO_FREE_COUNT   488
+#define FSINFO_NEXT_FREE    492
+
+// fat_file_t.flags
+#define FILE_OPEN           0x01
+#define FILE_ENTRY_DIRTY    0x02            // size or first cluster changed
+#define FILE_BUF_DIRTY      0x04
+#define FILE_RESERVED       0x08            // the chain may be longer than the size
+
+#define CLUSTER_BITS        (vol.cluster_shift + SECTOR_SHIFT)
+
+typedef struct {
+    blockdev_t *dev;
+    uint8_t fat32;
+    uint8_t n_fats;
+    uint8_t cluster_shift;                  // log2 of the sectors per cluster
+    uint8_t fsinfo_dirty;
+    uint32_t fat_lba;
+    uint32_t fat_sectors;                   // per copy
+    uint32_t root_lba;                      // FAT16 root directory
+    uint16_t root_entries;
+    uint32_t root_cluster;                  // FAT32 root directory
+    uint32_t data_lba;                      // cluster 2
+    uint32_t max_cluster;
+    uint32_t next_free;                     // allocation hint
+    uint32_t free_count;
+    uint32_t fsinfo_lba;                    // 0 if there is none
+
+    // FAT and directory sectors
+    uint32_t win_lba;
+    uint8_t win_dirty;
+    uint8_t win[SECTOR_SIZE];
+} fat_volume_t;
+
+static fat_volume_t vol;
+
+// position in a directory
+typedef struct {
+    uint32_t cluster;                       // 0 in the FAT16 root directory
+    uint32_t lba;
+    uint16_t index;                         // entry number
+} dir_t;
+
+static inline uint16_t ld16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t ld32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void st16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void st32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t cluster_lba(uint32_t cluster) {
+    return vol.data_lba + ((cluster - 2) << vol.cluster_shift);
+}
+
+static inline int cluster_valid(uint32_t cluster) {
+    return cluster >= 2 && cluster <= vol.max_cluster;
+}
+
+//==============================================================
+// Sector window
+//==============================================================
+static int win_flush(void) {
+    if (!vol.win_dirty) return FAT_OK;
+    if (blockdev_write(vol.dev, vol.win_lba, vol.win, 1) < 0) return FAT_ERR_IO;
+    // FAT sectors go to every copy
+    if (vol.win_lba >= vol.fat_lba && vol.win_lba < vol.fat_lba + vol.fat_sectors) {
+        uint32_t lba = vol.win_lba;
+        for (uint8_t i = 1; i < vol.n_fats; i++) {
+            lba += vol.fat_sectors;
+            if (blockdev_write(vol.dev, lba, vol.win, 1) < 0) return FAT_ERR_IO;
+        }
+    }
+    vol.win_dirty = 0;
+    return FAT_OK;
+}
+
+static int win_load(uint32_t lba) {
+    if (lba == vol.win_lba) return FAT_OK;
+    int r = win_flush();
+    if (r) return r;
+    if (blockdev_read(vol.dev, lba, vol.win, 1) < 0) {
+        vol.win_lba = FAT_NO_SECTOR;
+        return FAT_ERR_IO;
+    }
+    vol.win_lba = lba;
+    return FAT_OK;
+}
+
+// makes lba a zero filled window sector without reading it
+static int win_zero(uint32_t lba) {
+    int r = win_flush();
+    if (r) return r;
+    memset(vol.win, 0, SECTOR_SIZE);
+    vol.win_lba = lba;
+    vol.win_dirty = 1;
+    return FAT_OK;
+}
+
+//==============================================================
+// FAT
+//==============================================================
+// next cluster of the chain, 0 if free, CLUSTER_EOC at the end of the chain
+static uint32_t fat_get(uint32_t cluster) {
+    uint32_t v;
+    if (vol.fat32) {
+        if (win_load(vol.fat_lba + (cluster >> 7))) return CLUSTER_ERROR;
+        v = ld32(vol.win + ((uint16_t)cluster & 127) * 4) & FAT32_MASK;
+    } else {
+        if (win_load(vol.fat_lba + (cluster >> 8))) return CLUSTER_ERROR;
+        v = ld16(vol.win + ((uint16_t)cluster & 255) * 2);
+    }
+    if (v == 0 || cluster_valid(v)) return v;
+    return CLUSTER_EOC;
+}
+
+static int fat_set(uint32_t cluster, uint32_t value) {
+    uint8_t *p;
+    int r;
+    if (vol.fat32) {
+        r = win_load(vol.fat_lba + (cluster >> 7));
+        if (r) return r;
+        p = vol.win + ((uint16_t)cluster & 127) * 4;
+        st32(p, (ld32(p) & ~FAT32_MASK) | (value & FAT32_MASK));
+    } else {
+        r = win_load(vol.fat_lba + (cluster >> 8));
+        if (r) return r;
+        p = vol.win + ((uint16_t)cluster & 255) * 2;
+        st16(p, (uint16_t)value);
+    }
+    vol.win_dirty = 1;
+    return FAT_OK;
+}
+
+// first free cluster from `from` on, wrapping around; 0 if the volume is full
+static uint32_t find_free(uint32_t from) {
+    uint32_t c = from;
+    for (uint32_t n = vol.max_cluster - 1; n; n--) {
+        if (!cluster_valid(c)) c = 2;
+        const uint32_t v = fat_get(c);
+        if (v == CLUSTER_ERROR) return v;
+        if (v == 0) return c;
+        c++;
+    }
+    return 0;
+}
+
+// first run of n free clusters from `from` on, 0 if there is none
+static uint32_t find_run(uint32_t n, uint32_t from) {
+    uint32_t c = from, start = 0, len = 0;
+    for (uint32_t left = vol.max_cluster - 1; left; left--) {
+        if (!cluster_valid(c)) {
+            c = 2;
+            len = 0;
+        }
+        const uint32_t v = fat_get(c);
+        if (v == CLUSTER_ERROR) return v;
+        if (v == 0) {
+            if (!len) start = c;
+            if (++len == n) return start;
+        } else {
+            len = 0;
+        }
+        c++;
+    }
+    return 0;
+}
+
+static void count_alloc(uint32_t n, uint32_t next_free) {
+    if (vol.free_count != FREE_UNKNOWN) vol.free_count -= n;
+    vol.next_free = next_free;
+    vol.fsinfo_dirty = 1;
+}
+
+// Allocates a cluster and appends it to the chain ending at prev (if not 0).
+// The cluster after prev is taken if it is free, so files grow contiguously.
+static uint32_t cluster_alloc(uint32_t prev) {
+    const uint32_t c = find_free(prev ? prev + 1 : vol.next_free);
+    if (c == 0 || c == CLUSTER_ERROR) return c;
+    if (fat_set(c, CLUSTER_EOC) || (prev && fat_set(prev, c))) return CLUSTER_ERROR;
+    count_alloc(1, c + 1);
+    return c;
+}
+
+static int chain_free(uint32_t c) {
+    while (cluster_valid(c)) {
+        const uint32_t next = fat_get(c);
+        if (next == CLUSTER_ERROR) return FAT_ERR_IO;
+        const int r = fat_set(c, 0);
+        if (r) return r;
+        if (vol.free_count != FREE_UNKNOWN) vol.free_count++;
+        vol.fsinfo_dirty = 1;
+        c = next;
+    }
+    return FAT_OK;
+}
+
+//==============================================================
+// Volume
+//==============================================================
+static int is_boot_sector(const uint8_t *s) {
+    return (s[0] == 0xEB || s[0] == 0xE9) && ld16(s + 11) == SECTOR_SIZE && s[13] != 0 &&
+           ld16(s + 14) != 0 && s[16] != 0;
+}
+
+int fat_mount(blockdev_t *dev) {
+    uint32_t lba = 0;
+    int r;
+
+    if (vol.dev) fat_unmount();
+    vol.dev = dev;
+    vol.win_lba = FAT_NO_SECTOR;
+    vol.win_dirty = 0;
+    vol.fsinfo_dirty = 0;
+
+    if ((r = win_load(0))) goto fail;
+    if (!is_boot_sector(vol.win)) {
+        // partition table: first FAT16 or FAT32 partition
+        r = FAT_ERR_NO_FS;
+        if (ld16(vol.win + 510) != 0xAA55) goto fail;
+        for (uint8_t i = 0; i < 4 && !lba; i++) {
+            const uint8_t *p = vol.win + 446 + i * 16;
+            switch (p[4]) {
+                case 0x04: case 0x06: case 0x0E:    // FAT16
+                case 0x0B: case 0x0C:               // FAT32
+                    lba = ld32(p + 8);
+                    break;
+            }
+        }
+        if (!lba) goto fail;
+        if ((r = win_load(lba))) goto fail;
+        r = FAT_ERR_NO_FS;
+        if (!is_boot_sector(vol.win)) goto fail;
+    }
+
+    {
+        const uint8_t *b = vol.win;
+        const uint8_t spc = b[13];
+        uint32_t total = ld16(b + 19);
+        uint32_t fat_sectors = ld16(b + 22);
+        if (!total) total = ld32(b + 32);
+        if (!fat_sectors) fat_sectors = ld32(b + 36);
+
+        r = FAT_ERR_NO_FS;
+        if (spc & (spc - 1)) goto fail;
+        vol.cluster_shift = 0;
+        while ((1u << vol.cluster_shift) < spc) vol.cluster_shift++;
+        vol.n_fats = b[16];
+        vol.fat_sectors = fat_sectors;
+        vol.root_entries = ld16(b + 17);
+        vol.fat_lba = lba + ld16(b + 14);
+        vol.root_lba = vol.fat_lba + vol.n_fats * fat_sectors;
+        vol.data_lba = vol.root_lba + ((uint32_t)vol.root_entries * DIR_ENTRY_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        if (!fat_sectors || total <= vol.data_lba - lba) goto fail;
+
+        const uint32_t clusters = (total - (vol.data_lba - lba)) >> vol.cluster_shift;
+        if (clusters < 4085) goto fail;     // FAT12
+        vol.fat32 = clusters >= 65525;
+        vol.max_cluster = clusters + 1;
+        // never beyond the end of the FAT
+        const uint32_t fat_entries = fat_sectors * (vol.fat32 ? SECTOR_SIZE / 4 : SECTOR_SIZE / 2);
+        if (vol.max_cluster >= fat_entries) vol.max_cluster = fat_entries - 1;
+
+        vol.next_free = 2;
+        vol.free_count = FREE_UNKNOWN;
+        vol.fsinfo_lba = 0;
+        if (vol.fat32) {
+            vol.root_cluster = ld32(b + 44);
+            const uint16_t fsinfo = ld16(b + 48);
+            if (fsinfo != 0 && fsinfo != 0xFFFF) vol.fsinfo_lba = lba + fsinfo;
+        }
+    }
+
+    if (vol.fsinfo_lba) {
+        if ((r = win_load(vol.fsinfo_lba))) goto fail;
+        if (ld32(vol.win) == FSINFO_LEAD_SIG && ld32(vol.win + 484) == FSINFO_STRUC_SIG) {
+            const uint32_t free_count = ld32(vol.win + FSINFO_FREE_COUNT);
+            const uint32_t next_free = ld32(vol.win + FSINFO_NEXT_FREE);
+            if (free_count < vol.max_cluster) vol.free_count = free_count;
+            if (cluster_valid(next_free)) vol.next_free = next_free;
+        } else {
+            vol.fsinfo_lba = 0;
+        }
+    }
+    return FAT_OK;
+
+fail:
+    vol.dev = NULL;
+    return r;
+}
+
+int fat_sync(void) {
+    int r;
+    if (!vol.dev) return FAT_ERR_NOT_MOUNTED;
+    if ((r = win_flush())) return r;
+    if (vol.fsinfo_lba && vol.fsinfo_dirty) {
+        if ((r = win_load(vol.fsinfo_lba))) return r;
+        st32(vol.win + FSINFO_FREE_COUNT, vol.free_count);
+        st32(vol.win + FSINFO_NEXT_FREE, vol.next_free);
+        vol.win_dirty = 1;
+        if ((r = win_flush())) return r;
+    }
+    vol.fsinfo_dirty = 0;
+    return blockdev_sync(vol.dev) < 0 ? FAT_ERR_IO : FAT_OK;
+}
+
+int fat_unmount(void) {
+    const int r = fat_sync();
+    vol.dev = NULL;
+    return r;
+}
+
+uint32_t fat_free(void) {
+    if (!vol.dev) return 0;
+    if (vol.free_count == FREE_UNKNOWN) {
+        uint32_t n = 0;
+        for (uint32_t c = 2; c <= vol.max_cluster; c++) {
+            const uint32_t v = fat_get(c);
+            if (v == CLUSTER_ERROR) return 0;
+            if (v == 0) n++;
+        }
+        vol.free_count = n;
+        vol.fsinfo_dirty = 1;
+    }
+    if (vol.free_count > (0xFFFFFFFFUL >> CLUSTER_BITS)) return 0xFFFFFFFFUL;
+    return vol.free_count << CLUSTER_BITS;
+}
+
+//==============================================================
+// Directories
+//==============================================================
+static inline uint32_t entry_cluster(const uint8_t *e) {
+    uint32_t c = ld16(e + DIR_CLUS_LO);
+    if (vol.fat32) c |= (uint32_t)ld16(e + DIR_CLUS_HI) << 16;
+    return c;
+}
+
+// cluster 0 is the root directory
+static void dir_rewind(dir_t *d, uint32_t cluster) {
+    if (cluster == 0 && vol.fat32) cluster = vol.root_cluster;
+    d->cluster = cluster;
+    d->lba = cluster ? cluster_lba(cluster) : vol.root_lba;
+    d->index = 0;
+}
+
+static uint8_t *dir_entry(dir_t *d) {
+    if (win_load(d->lba)) return NULL;
+    return vol.win + (d->index % ENTRIES_PER_SECTOR) * DIR_ENTRY_SIZE;
+}
+
+// Moves to the next entry. At the end of the directory this returns
+// FAT_ERR_NOT_FOUND, or with `extend` adds a zeroed cluster to it.
+static int dir_next(dir_t *d, uint8_t extend) {
+    const uint16_t index = d->index + 1;
+    if (index == 0) return FAT_ERR_FULL;
+    if (index % ENTRIES_PER_SECTOR == 0) {
+        if (d->cluster == 0) {
+            if (index >= vol.root_entries) return extend ? FAT_ERR_FULL : FAT_ERR_NOT_FOUND;
+            d->lba++;
+        } else if (((index / ENTRIES_PER_SECTOR) & ((1u << vol.cluster_shift) - 1)) == 0) {
+            uint32_t next = fat_get(d->cluster);
+            if (next == CLUSTER_ERROR) return FAT_ERR_IO;
+            if (!cluster_valid(next)) {
+                if (!extend) return FAT_ERR_NOT_FOUND;
+                next = cluster_alloc(d->cluster);
+                if (next == CLUSTER_ERROR) return FAT_ERR_IO;
+                if (next == 0) return FAT_ERR_FULL;
+                for (uint8_t i = 0; i < (1u << vol.cluster_shift); i++) {
+                    const int r = win_zero(cluster_lba(next) + i);
+                    if (r) return r;
+                }
+            }
+            d->cluster = next;
+            d->lba = cluster_lba(next);
+        } else {
+            d->lba++;
+        }
+    }
+    d->index = index;
+    return FAT_OK;
+}
+
+// Converts the next path component to an 8.3 entry name. Returns the rest of
+// the path, or NULL if the component is not a valid name.
+static const char *make_name(const char *path, uint8_t *name) {
+    uint8_t i = 0, limit = 8;
+    char c;
+
+    memset(name, ' ', 11);
+    if (path[0] == '.') {
+        // "." and ".." entries of subdirectories
+        name[i++] = '.';
+        if (path[1] == '.') name[i++] = '.';
+        return (path[i] == '/' || path[i] == '\0') ? path + i : NULL;
+    }
+    while ((c = *path) != '\0' && c != '/') {
+        path++;
+        if (c == '.') {
+            if (limit == 11) return NULL;
+            i = 8;
+            limit = 11;
+            continue;
+        }
+        if (i >= limit || (uint8_t)c < 0x20 || strchr("\"*+,:;<=>?[\\]|", c)) return NULL;
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        name[i++] = (uint8_t)c;
+    }
+    if (name[0] == ' ') return NULL;
+    if (name[0] == ENTRY_DELETED) name[0] = 0x05;
+    return path;
+}
+
+static int dir_find(dir_t *d, uint32_t cluster, const uint8_t *name) {
+    dir_rewind(d, cluster);
+    for (;;) {
+        const uint8_t *e = dir_entry(d);
+        if (!e) return FAT_ERR_IO;
+        if (e[DIR_NAME] == ENTRY_END) return FAT_ERR_NOT_FOUND;
+        if (e[DIR_NAME] != ENTRY_DELETED && !(e[DIR_ATTR] & ATTR_VOLUME_ID) && !memcmp(e, name, 11)) {
+            return FAT_OK;
+        }
+        const int r = dir_next(d, 0);
+        if (r) return r;
+    }
+}
+
+// Looks up path and leaves d on its entry. If only the last component is
+// missing, the result is FAT_ERR_NOT_FOUND with *parent set to the directory it
+// would be in and name to its entry name; otherwise *parent is CLUSTER_ERROR.
+static int path_find(const char *path, dir_t *d, uint8_t *name, uint32_t *parent) {
+    uint32_t cluster = 0;
+
+    *parent = CLUSTER_ERROR;
+    while (*path == '/') path++;
+    for (;;) {
+        if (!(path = make_name(path, name))) return FAT_ERR_NAME;
+        while (*path == '/') path++;
+        const int r = dir_find(d, cluster, name);
+        if (r) {
+            if (r == FAT_ERR_NOT_FOUND && !*path) *parent = cluster;
+            return r;
+        }
+        if (!*path) return FAT_OK;
+        const uint8_t *e = dir_entry(d);
+        if (!e) return FAT_ERR_IO;
+        if (!(e[DIR_ATTR] & ATTR_DIRECTORY)) return FAT_ERR_NOT_FOUND;
+        cluster = entry_cluster(e);
+    }
+}
+
+// adds an empty file entry to the directory, d is left on it
+static int dir_create(dir_t *d, uint32_t cluster, const uint8_t *name) {
+    uint8_t *e;
+    dir_rewind(d, cluster);
+    for (;;) {
+        if (!(e = dir_entry(d))) return FAT_ERR_IO;
+        if (e[DIR_NAME] == ENTRY_END || e[DIR_NAME] == ENTRY_DELETED) break;
+        const int r = dir_next(d, 1);
+        if (r) return r;
+    }
+    memset(e, 0, DIR_ENTRY_SIZE);
+    memcpy(e + DIR_NAME, name, 11);
+    e[DIR_ATTR] = ATTR_ARCHIVE;
+    st16(e + DIR_CRT_TIME, FAT_TIME);
+    st16(e + DIR_CRT_DATE, FAT_DATE);
+    st16(e + DIR_ACC_DATE, FAT_DATE);
+    st16(e + DIR_WRT_TIME, FAT_TIME);
+    st16(e + DIR_WRT_DATE, FAT_DATE);
+    vol.win_dirty = 1;
+    return FAT_OK;
+}
+
+//==============================================================
+// Cluster chain of a file
+//==============================================================
+static fat_extent_t *extent_new(fat_file_t *f, uint32_t index, uint32_t cluster) {
+    fat_extent_t *e = &f->extents[f->extent_next];
+    f->extent_next = (uint8_t)((f->extent_next + 1) % FAT_FILE_EXTENTS);
+    e->index = index;
+    e->cluster = cluster;
+    e->count = 1;
+    return e;
+}
+
+// cluster after c, appending a new one at the end of the chain if alloc is set
+static uint32_t chain_next(fat_file_t *f, uint32_t c, uint8_t alloc) {
+    uint32_t next = fat_get(c);
+    if (next == CLUSTER_ERROR) {
+        f->error = FAT_ERR_IO;
+        return 0;
+    }
+    if (cluster_valid(next)) return next;
+    if (!alloc) return 0;
+    next = cluster_alloc(c);
+    if (next == CLUSTER_ERROR || next == 0) {
+        f->error = next ? FAT_ERR_IO : FAT_ERR_FULL;
+        return 0;
+    }
+    return next;
+}
+
+// Cluster number `index` of the file, 0 past the end of the chain or on error.
+// *run is set to the number of consecutive clusters from there, at most want.
+// The extents remember where the chain is contiguous, so seeking and
+// sequential access do not walk the FAT again.
+static uint32_t chain_map(fat_file_t *f, uint32_t index, uint32_t want, uint8_t alloc, uint32_t *run) {
+    fat_extent_t *e = NULL, *below = NULL;
+    uint32_t c, next;
+
+    if (!f->start) {
+        if (!alloc) return 0;
+        c = cluster_alloc(0);
+        if (c == CLUSTER_ERROR || c == 0) {
+            f->error = c ? FAT_ERR_IO : FAT_ERR_FULL;
+            return 0;
+        }
+        f->start = c;
+        f->flags |= FILE_ENTRY_DIRTY;
+        e = extent_new(f, 0, c);
+    } else {
+        for (uint8_t i = 0; i < FAT_FILE_EXTENTS; i++) {
+            fat_extent_t *x = &f->extents[i];
+            if (!x->count) continue;
+            if (index >= x->index && index < x->index + x->count) {
+                e = x;
+                break;
+            }
+            if (x->index + x->count <= index && (!below || x->index > below->index)) below = x;
+        }
+    }
+    if (!e) {
+        e = below ? below : extent_new(f, 0, f->start);
+        while (e->index + e->count <= index) {
+            c = e->cluster + e->count - 1;
+            if (!(next = chain_next(f, c, alloc))) return 0;
+            if (next == c + 1) e->count++;
+            else e = extent_new(f, e->index + e->count, next);
+        }
+    }
+    // grow the extent over the rest of the transfer
+    while (e->index + e->count < index + want) {
+        c = e->cluster + e->count - 1;
+        next = fat_get(c);
+        if (next == CLUSTER_ERROR) {
+            f->error = FAT_ERR_IO;
+            return 0;
+        }
+        if (next == CLUSTER_EOC && alloc && c < vol.max_cluster) {
+            // only the cluster right after the chain, anything else is left to the next call
+            const uint32_t v = fat_get(c + 1);
+            if (v == CLUSTER_ERROR) {
+                f->error = FAT_ERR_IO;
+                return 0;
+            }
+            if (v == 0) next = cluster_alloc(c);
+        }
+        if (next != c + 1) break;
+        e->count++;
+    }
+    *run = e->index + e->count - index;
+    if (*run > want) *run = want;
+    return e->cluster + (index - e->index);
+}
+
+static inline uint32_t clusters_for(uint32_t size) {
+    return (size >> CLUSTER_BITS) + ((size & ((1UL << CLUSTER_BITS) - 1)) != 0);
+}
+
+// releases the clusters past the end of the file
+static int chain_trim(fat_file_t *f) {
+    const uint32_t used = clusters_for(f->size);
+    uint32_t run, last, next;
+    int r;
+
+    f->flags &= ~FILE_RESERVED;
+    if (!f->start) return FAT_OK;
+    if (!used) {
+        r = chain_free(f->start);
+        f->start = 0;
+        f->flags = (uint8_t)((f->flags | FILE_ENTRY_DIRTY) & ~FILE_BUF_DIRTY);
+        f->buf_pos = FAT_NO_SECTOR;
+        memset(f->extents, 0, sizeof(f->extents));
+        return r;
+    }
+    if (!(last = chain_map(f, used - 1, 1, 0, &run))) return f->error ? f->error : FAT_ERR_IO;
+    if ((next = fat_get(last)) == CLUSTER_ERROR) return FAT_ERR_IO;
+    if (!cluster_valid(next)) return FAT_OK;
+    if ((r = fat_set(last, CLUSTER_EOC))) return r;
+    for (uint8_t i = 0; i < FAT_FILE_EXTENTS; i++) {
+        fat_extent_t *x = &f->extents[i];
+        if (x->index >= used) x->count = 0;
+        else if (x->index + x->count > used) x->count = used - x->index;
+    }
+    return chain_free(next);
+}
+
+//==============================================================
+// Files
+//==============================================================
+// First sector of file offset pos and the number of consecutive sectors from
+// there, at most `sectors`. 0 past the end of the chain or on error.
+static uint32_t file_lba(fat_file_t *f, uint32_t pos, uint32_t sectors, uint8_t alloc, uint32_t *count) {
+    const uint32_t in_cluster = (pos >> SECTOR_SHIFT) & ((1UL << vol.cluster_shift) - 1);
+    const uint32_t want = (in_cluster + sectors + (1UL << vol.cluster_shift) - 1) >> vol.cluster_shift;
+    uint32_t run;
+    const uint32_t c = chain_map(f, pos >> CLUSTER_BITS, want, alloc, &run);
+    if (!c) return 0;
+    const uint32_t n = (run << vol.cluster_shift) - in_cluster;
+    *count = n < sectors ? n : sectors;
+    return cluster_lba(c) + in_cluster;
+}
+
+static int buf_flush(fat_file_t *f) {
+    if (f->flags & FILE_BUF_DIRTY) {
+        if (blockdev_write(vol.dev, f->buf_lba, f->buf, 1) < 0) return f->error = FAT_ERR_IO;
+        f->flags &= ~FILE_BUF_DIRTY;
+    }
+    return FAT_OK;
+}
+
+// Makes buf hold the sector of pos. Sectors past the end of the file are zero
+// filled instead of read.
+static int buf_load(fat_file_t *f, uint32_t pos, uint8_t alloc) {
+    const uint32_t sector_pos = pos & ~(uint32_t)(SECTOR_SIZE - 1);
+    uint32_t n, lba;
+
+    if (f->buf_pos == sector_pos) return FAT_OK;
+    if (buf_flush(f)) return f->error;
+    if (!(lba = file_lba(f, sector_pos, 1, alloc, &n))) {
+        // a chain shorter than the file is a damaged file system
+        if (!f->error) f->error = FAT_ERR_IO;
+        return f->error;
+    }
+    if (sector_pos >= f->size) {
+        memset(f->buf, 0, SECTOR_SIZE);
+    } else if (blockdev_read(vol.dev, lba, f->buf, 1) < 0) {
+        f->buf_pos = FAT_NO_SECTOR;
+        return f->error = FAT_ERR_IO;
+    }
+    f->buf_pos = sector_pos;
+    f->buf_lba = lba;
+    return FAT_OK;
+}
+
+int fat_open(fat_file_t *f, const char *path, uint8_t mode) {
+    uint8_t name[11];
+    uint32_t parent;
+    uint8_t *e;
+    dir_t d;
+    int r;
+
+    f->flags = 0;
+    if (!vol.dev) return FAT_ERR_NOT_MOUNTED;
+    if (!(f->buf = (uint8_t *)malloc(SECTOR_SIZE))) return FAT_ERR_NO_MEMORY;
+
+    r = path_find(path, &d, name, &parent);
+    if (r == FAT_OK) {
+        r = FAT_ERR_EXISTS;
+        if ((mode & FAT_CREATE) && (mode & FAT_EXCL)) goto fail;
+        r = FAT_ERR_IO;
+        if (!(e = dir_entry(&d))) goto fail;
+        r = FAT_ERR_DENIED;
+        if (e[DIR_ATTR] & ATTR_DIRECTORY) goto fail;
+        if ((e[DIR_ATTR] & ATTR_READ_ONLY) && (mode & (FAT_WRITE | FAT_TRUNC))) goto fail;
+        f->start = entry_cluster(e);
+        f->size = ld32(e + DIR_SIZE);
+    } else if (r == FAT_ERR_NOT_FOUND && (mode & FAT_CREATE) && parent != CLUSTER_ERROR) {
+        if ((r = dir_create(&d, parent, name))) goto fail;
+        f->start = 0;
+        f->size = 0;
+    } else {
+        goto fail;
+    }
+
+    f->dir_lba = d.lba;
+    f->dir_offset = (uint16_t)((d.index % ENTRIES_PER_SECTOR) * DIR_ENTRY_SIZE);
+    f->mode = mode;
+    f->flags = FILE_OPEN;
+    f->error = 0;
+    f->pos = 0;
+    f->buf_pos = FAT_NO_SECTOR;
+    f->extent_next = 0;
+    memset(f->extents, 0, sizeof(f->extents));
+    if ((mode & FAT_TRUNC) && f->start) {
+        r = chain_free(f->start);
+        f->start = 0;
+        f->size = 0;
+        f->flags |= FILE_ENTRY_DIRTY;
+        if (r) goto fail;
+    } else if ((mode & FAT_TRUNC) && f->size) {
+        f->size = 0;
+        f->flags |= FILE_ENTRY_DIRTY;
+    }
+    if (mode & FAT_APPEND) f->pos = f->size;
+    return FAT_OK;
+
+fail:
+    free(f->buf);
+    f->buf = NULL;
+    f->flags = 0;
+    return r;
+}
+
+int fat_flush(fat_file_t *f) {
+    int r;
+    if (!(f->flags & FILE_OPEN)) return FAT_ERR_DENIED;
+    if (buf_flush(f)) return f->error;
+    if (f->flags & FILE_ENTRY_DIRTY) {
+        if ((r = win_load(f->dir_lba))) return f->error = (int8_t)r;
+        uint8_t *e = vol.win + f->dir_offset;
+        st16(e + DIR_CLUS_HI, (uint16_t)(f->start >> 16));
+        st16(e + DIR_CLUS_LO, (uint16_t)f->start);
+        st32(e + DIR_SIZE, f->size);
+        e[DIR_ATTR] |= ATTR_ARCHIVE;
+        vol.win_dirty = 1;
+        f->flags &= ~FILE_ENTRY_DIRTY;
+    }
+    if ((r = fat_sync())) f->error = (int8_t)r;
+    return r;
+}
+
+int fat_close(fat_file_t *f) {
+    int r = FAT_OK, r2;
+    if (!(f->flags & FILE_OPEN)) return FAT_ERR_DENIED;
+    if (f->flags & FILE_RESERVED) r = chain_trim(f);
+    r2 = fat_flush(f);
+    free(f->buf);
+    f->buf = NULL;
+    f->flags = 0;
+    return r ? r : r2;
+}
+
+size_t fat_read(fat_file_t *f, void *buf, size_t len) {
+    uint8_t *dst = (uint8_t *)buf;
+    size_t done = 0;
+
+    if (!(f->mode & FAT_READ)) {
+        f->error = FAT_ERR_DENIED;
+        return 0;
+    }
+    if (f->pos >= f->size) return 0;
+    if (len > f->size - f->pos) len = (size_t)(f->size - f->pos);
+
+    while (done < len) {
+        const uint16_t offset = (uint16_t)f->pos & (SECTOR_SIZE - 1);
+        size_t n = len - done;
+        if (offset == 0 && n >= SECTOR_SIZE) {
+            // whole sectors go straight to the caller, as many as are contiguous
+            uint32_t count;
+            const uint32_t lba = file_lba(f, f->pos, n >> SECTOR_SHIFT, 0, &count);
+            if (!lba) {
+                if (!f->error) f->error = FAT_ERR_IO;
+                break;
+            }
+            // the buffered sector may be newer than the device
+            if ((f->flags & FILE_BUF_DIRTY) && f->buf_lba >= lba && f->buf_lba < lba + count && buf_flush(f)) break;
+            if (blockdev_read(vol.dev, lba, dst + done, (size_t)count) < 0) {
+                f->error = FAT_ERR_IO;
+                break;
+            }
+            n = (size_t)count << SECTOR_SHIFT;
+        } else {
+            if (buf_load(f, f->pos, 0)) break;
+            if (n > (size_t)(SECTOR_SIZE - offset)) n = SECTOR_SIZE - offset;
+            memcpy(dst + done, f->buf + offset, n);
+        }
+        done += n;
+        f->pos += n;
+    }
+    return done;
+}
+
+// zero fills from the end of the file to pos
+static int fill_gap(fat_file_t *f) {
+    const uint32_t end = f->pos;
+    f->pos = f->size;
+    while (f->pos < end) {
+        if (buf_load(f, f->pos, 1)) return f->error;
+        const uint16_t offset = (uint16_t)f->pos & (SECTOR_SIZE - 1);
+        uint32_t n = SECTOR_SIZE - offset;
+        if (n > end - f->pos) n = end - f->pos;
+        memset(f->buf + offset, 0, (size_t)n);
+        f->pos += n;
+        f->size = f->pos;
+        f->flags |= FILE_BUF_DIRTY | FILE_ENTRY_DIRTY;
+    }
+    return FAT_OK;
+}
+
+size_t fat_write(fat_file_t *f, const void *buf, size_t len) {
+    const uint8_t *src = (const uint8_t *)buf;
+    size_t done = 0;
+
+    if (!(f->mode & FAT_WRITE)) {
+        f->error = FAT_ERR_DENIED;
+        return 0;
+    }
+    if (!len) return 0;
+    if (f->mode & FAT_APPEND) f->pos = f->size;
+    if (f->pos > f->size && fill_gap(f)) return 0;
+    if (len > 0xFFFFFFFFUL - f->pos) len = (size_t)(0xFFFFFFFFUL - f->pos);
+
+    while (done < len) {
+        const uint16_t offset = (uint16_t)f->pos & (SECTOR_SIZE - 1);
+        size_t n = len - done;
+        if (offset == 0 && n >= SECTOR_SIZE) {
+            uint32_t count;
+            const uint32_t lba = file_lba(f, f->pos, n >> SECTOR_SHIFT, 1, &count);
+            if (!lba) break;
+            // the buffered sector is overwritten
+            if (f->buf_pos != FAT_NO_SECTOR && f->buf_lba >= lba && f->buf_lba < lba + count) {
+                f->buf_pos = FAT_NO_SECTOR;
+                f->flags &= ~FILE_BUF_DIRTY;
+            }
+            if (blockdev_write(vol.dev, lba, src + done, (size_t)count) < 0) {
+                f->error = FAT_ERR_IO;
+                break;
+            }
+            n = (size_t)count << SECTOR_SHIFT;
+        } else {
+            if (buf_load(f, f->pos, 1)) break;
+            if (n > (size_t)(SECTOR_SIZE - offset)) n = SECTOR_SIZE - offset;
+            memcpy(f->buf + offset, src + done, n);
+            f->flags |= FILE_BUF_DIRTY;
+        }
+        done += n;
+        f->pos += n;
+        if (f->pos > f->size) {
+            f->size = f->pos;
+            f->flags |= FILE_ENTRY_DIRTY;
+        }
+    }
+    return done;
+}
+
+int fat_seek(fat_file_t *f, uint32_t pos) {
+    if (!(f->flags & FILE_OPEN)) return FAT_ERR_DENIED;
+    f->pos = pos;
+    return FAT_OK;
+}
+
+int fat_reserve(fat_file_t *f, uint32_t size) {
+    const uint32_t need = clusters_for(size);
+    uint32_t have = 0, last = 0, run, c;
+    int r;
+
+    if (!(f->mode & FAT_WRITE)) return FAT_ERR_DENIED;
+    if (!need) return FAT_OK;
+    if (f->start) {
+        if (chain_map(f, need - 1, 1, 0, &run)) return FAT_OK;
+        if (f->error) return f->error;
+        // the walk ended on the extent at the end of the chain
+        for (uint8_t i = 0; i < FAT_FILE_EXTENTS; i++) {
+            const fat_extent_t *x = &f->extents[i];
+            if (x->count && x->index + x->count > have) {
+                have = x->index + x->count;
+                last = x->cluster + x->count - 1;
+            }
+        }
+    }
+
+    const uint32_t n = need - have;
+    c = find_run(n, last ? last + 1 : vol.next_free);
+    if (c == CLUSTER_ERROR) return FAT_ERR_IO;
+    if (c == 0) return FAT_ERR_FULL;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((r = fat_set(c + i, i + 1 < n ? c + i + 1 : CLUSTER_EOC))) return r;
+    }
+    if (last) {
+        if ((r = fat_set(last, c))) return r;
+    } else {
+        f->start = c;
+        f->flags |= FILE_ENTRY_DIRTY;
+    }
+    count_alloc(n, c + n);
+    extent_new(f, have, c)->count = n;
+    f->flags |= FILE_RESERVED;
+    return FAT_OK;
+}
+
+int fat_remove(const char *path) {
+    uint8_t name[11];
+    uint32_t parent;
+    uint8_t *e;
+    dir_t d;
+    int r;
+
+    if (!vol.dev) return FAT_ERR_NOT_MOUNTED;
+    if ((r = path_find(path, &d, name, &parent))) return r;
+    if (!(e = dir_entry(&d))) return FAT_ERR_IO;
+    if (e[DIR_ATTR] & (ATTR_DIRECTORY | ATTR_READ_ONLY)) return FAT_ERR_DENIED;
+    const uint32_t start = entry_cluster(e);
+    e[DIR_NAME] = ENTRY_DELETED;
+    vol.win_dirty = 1;
+    if ((r = chain_free(start))) return r;
+    return fat_sync();
+}
@@ -0,0 +1,332 @@
+/* malloc / free / realloc
+   ----------------------
+
+Segregated fit allocator on top of sbrk().
+
+Every block starts with a one word header (3 bytes on the eZ80) holding the
+block size, a multiple of GRAIN, and two flags in the low bits:
+    BLOCK_FREE       the block is free
+    BLOCK_PREV_FREE  the block before it is free
+A free block also stores the next / previous pointer of its free list after the
+header and its size again in its last word (boundary tag), so free() merges
+with both neighbours in O(1). A zero size header marks the end of the heap.
+
+Free blocks are kept in one list per power of two size class, bin b holding
+the sizes 2^b .. 2^(b+1) - 1, and a bitmap tells which bins are not empty.
+malloc() looks at up to FIT_SCAN blocks of the bin of the requested size for a
+fit, otherwise any block of the next non-empty bin above fits, so allocation
+and free() take a bounded number of steps however many blocks are live. The
+rest of a block that is larger than needed goes back to its bin, and when no
+block fits the last free block of the heap is extended with sbrk().
+
+realloc() resizes in place whenever it can: it shrinks by splitting off the
+tail, and grows into a following free block and / or the top of the heap.
+
+The bytes in allocated blocks and their high water mark are counted for
+heap_stats() (mem_stats.h).
+
+extras/host/malloc builds this file on a PC, with a stress test and a
+comparison against a model of the first fit allocator it replaced.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "mem_stats.h"
+
+void *sbrk(int incr);
+extern char __heapbot; // Defined by the linker
+extern char __heaptop; // Defined by the linker
+
+#define WORD            sizeof(size_t)
+#define GRAIN           (WORD < 4 ? 4 : WORD)
+#define BLOCK_FREE      1
+#define BLOCK_PREV_FREE 2
+#define BLOCK_FLAGS     (GRAIN - 1)
+#define MIN_BLOCK       (4 * WORD)          /* header, next, prev, footer */
+#define FIT_SCAN        8
+#define NBINS           (8 * WORD)
+
+typedef struct free_block {
+    size_t header;
+    struct free_block *next;
+    struct free_block *prev;
+} free_block_t;
+
+static free_block_t *bins[NBINS];
+static size_t binmap;
+static unsigned char *heap_end;             /* end of heap header, NULL before the first sbrk() */
+static size_t heap_used;
+static size_t heap_peak;
+
+#define HEADER(p)       (*(size_t *)(p))
+#define SIZE(p)         (HEADER(p) & ~(size_t)BLOCK_FLAGS)
+
+static void count_used(size_t add)
+{
+    heap_used += add;
+    if (heap_used > heap_peak) heap_peak = heap_used;
+}
+
+static const unsigned char log2_16[16] = { 0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 };
+
+/* floor(log2(size)), size < 2^24 */
+static unsigned char bin_of(size_t size)
+{
+    unsigned char b = 0;
+    if (size >> 16) {
+        size >>= 16;
+        b = 16;
+    }
+    if (size >> 8) {
+        size >>= 8;
+        b += 8;
+    }
+    if (size >> 4) {
+        size >>= 4;
+        b += 4;
+    }
+    return b + log2_16[size];
+}
+
+static void bin_insert(unsigned char *p, size_t size)
+{
+    free_block_t *f = (free_block_t *)p;
+    unsigned char b = bin_of(size);
+    f->prev = NULL;
+    f->next = bins[b];
+    if (f->next) f->next->prev = f;
+    bins[b] = f;
+    binmap |= (size_t)1 << b;
+}
+
+static void bin_remove(unsigned char *p)
+{
+    free_block_t *f = (free_block_t *)p;
+    if (f->next) f->next->prev = f->prev;
+    if (f->prev) {
+        f->prev->next = f->next;
+    } else {
+        unsigned char b = bin_of(SIZE(p));
+        bins[b] = f->next;
+        if (!f->next) binmap &= ~((size_t)1 << b);
+    }
+}
+
+/* makes p a free block of size bytes, the block before it is in use */
+static void make_free(unsigned char *p, size_t size)
+{
+    HEADER(p) = size | BLOCK_FREE;
+    *(size_t *)(p + size - WORD) = size;
+    HEADER(p + size) |= BLOCK_PREV_FREE;
+    bin_insert(p, size);
+}
+
+/* takes size bytes off the start of the free block p, which is out of its bin */
+static void *use_block(unsigned char *p, size_t size)
+{
+    size_t have = SIZE(p);
+    size_t prev_free = HEADER(p) & BLOCK_PREV_FREE;
+    if (have - size >= MIN_BLOCK) {
+        make_free(p + size, have - size);
+    } else {
+        size = have;
+        HEADER(p + size) &= ~(size_t)BLOCK_PREV_FREE;
+    }
+    HEADER(p) = size | prev_free;
+    count_used(size);
+    return p + WORD;
+}
+
+/* whether sbrk() continues right after the end header */
+static int heap_contiguous(void)
+{
+    return heap_end && (unsigned char *)sbrk(0) == heap_end + WORD;
+}
+
+/* moves the end of the heap by incr bytes, the end header moves along */
+static int extend(size_t incr)
+{
+    if (!sbrk(incr)) return 0;
+    heap_end += incr;
+    HEADER(heap_end) = 0;
+    return 1;
+}
+
+/* grows the heap so that a free block of at least size bytes ends at the new
+   end, taking in the last block if it is free; the block is out of its bin */
+static unsigned char *grow(size_t size)
+{
+    unsigned char *p;
+    if (heap_contiguous()) {
+        size_t last = 0;
+        if (HEADER(heap_end) & BLOCK_PREV_FREE) last = *(size_t *)(heap_end - WORD);
+        p = heap_end - last;
+        if (last >= size) {
+            /* big enough already, malloc() did not get to it in its bin */
+            bin_remove(p);
+            return p;
+        }
+        if (!extend(size - last)) return NULL;
+        /* the old end header becomes part of the block */
+        if (last) bin_remove(p);
+        HEADER(p) = size;
+        return p;
+    }
+    /* first call, or someone else moved the break: a new region starts and
+       the old end header stays as a barrier */
+    p = (unsigned char *)sbrk(size + WORD);
+    if (!p) return NULL;
+    HEADER(p) = size;
+    heap_end = p + size;
+    HEADER(heap_end) = 0;
+    return p;
+}
+
+/* gives the tail of the used block p beyond size bytes back to the bins */
+static void trim(unsigned char *p, size_t size)
+{
+    size_t have = SIZE(p);
+    if (have - size < MIN_BLOCK) return;
+
+    unsigned char *tail = p + size;
+    size_t tail_size = have - size;
+    unsigned char *next = p + have;
+    if (HEADER(next) & BLOCK_FREE) {
+        bin_remove(next);
+        tail_size += SIZE(next);
+    }
+    HEADER(p) = size | (HEADER(p) & BLOCK_PREV_FREE);
+    make_free(tail, tail_size);
+}
+
+/* block size for n bytes, 0 if too large */
+static size_t block_size(size_t n)
+{
+    size_t size;
+    if (n > ((size_t)-1 >> 2)) return 0;
+    size = (n + WORD + BLOCK_FLAGS) & ~(size_t)BLOCK_FLAGS;
+    return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+void *malloc(size_t n)
+{
+    size_t size = block_size(n);
+    unsigned char b;
+    unsigned char *p;
+
+    if (!size) return NULL;
+
+    /* first fit among the first blocks of the bin of the size, every block
+       of the bins above fits */
+    b = bin_of(size);
+    free_block_t *f = bins[b];
+    for (unsigned char i = 0; f && i < FIT_SCAN; i++, f = f->next) {
+        if (SIZE(f) >= size) {
+            p = (unsigned char *)f;
+            bin_remove(p);
+            return use_block(p, size);
+        }
+    }
+    b++;
+
+    if (b < NBINS && (binmap >> b)) {
+        size_t m = binmap >> b;
+        while (!(m & 1)) {
+            m >>= 1;
+            b++;
+        }
+        p = (unsigned char *)bins[b];
+        bin_remove(p);
+        return use_block(p, size);
+    }
+
+    p = grow(size);
+    if (!p) return NULL;
+    HEADER(p) |= BLOCK_FREE;
+    return use_block(p, size);
+}
+
+void free(void *ptr)
+{
+    unsigned char *p;
+    size_t size;
+
+    if (!ptr) return;
+    p = (unsigned char *)ptr - WORD;
+    size = SIZE(p);
+    heap_used -= size;
+
+    unsigned char *next = p + size;
+    if (HEADER(next) & BLOCK_FREE) {
+        bin_remove(next);
+        size += SIZE(next);
+    }
+    if (HEADER(p) & BLOCK_PREV_FREE) {
+        size_t prev = *(size_t *)(p - WORD);
+        p -= prev;
+        bin_remove(p);
+        size += prev;
+    }
+    make_free(p, size);
+}
+
+void *realloc(void *ptr, size_t n)
+{
+    unsigned char *p;
+    unsigned char *next;
+    size_t size, have, avail;
+    void *q;
+
+    if (!ptr) return malloc(n);
+    size = block_size(n);
+    if (!size) return NULL;
+    p = (unsigned char *)ptr - WORD;
+    have = SIZE(p);
+    if (size <= have) {
+        trim(p, size);
+        heap_used -= have - SIZE(p);
+        return ptr;
+    }
+
+    /* the following free block and the top of the heap */
+    next = p + have;
+    avail = have;
+    if (HEADER(next) & BLOCK_FREE) avail += SIZE(next);
+    if (avail < size && p + avail == heap_end && heap_contiguous()) {
+        if (extend(size - avail)) avail = size;
+    }
+    if (avail >= size) {
+        if (HEADER(next) & BLOCK_FREE) bin_remove(next);
+        HEADER(p) = avail | (HEADER(p) & BLOCK_PREV_FREE);
+        HEADER(p + avail) &= ~(size_t)BLOCK_PREV_FREE;
+        trim(p, size);
+        count_used(SIZE(p) - have);
+        return ptr;
+    }
+
+    q = malloc(n);
+    if (!q) return NULL;
+    memcpy(q, ptr, have - WORD);
+    free(ptr);
+    return q;
+}
+
+void heap_stats(heap_stats_t *stats)
+{
+    stats->size = (unsigned char *)sbrk(0) - (unsigned char *)&__heapbot;
+    stats->limit = &__heaptop - &__heapbot;
+    stats->used = heap_used;
+    stats->peak = heap_peak;
+    stats->free_blocks = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    for (unsigned char b = 0; b < NBINS; b++) {
+        for (free_block_t *f = bins[b]; f; f = f->next) {
+            size_t size = SIZE(f);
+            stats->free_blocks++;
+            stats->free_bytes += size;
+            if (size > stats->largest_free) stats->largest_free = size;
+        }
+    }
+}
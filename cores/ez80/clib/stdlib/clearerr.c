@@ -13,16 +13,12 @@ Parameters
 */
 
 #include <stdio.h>
-#include <errno.h>
-#include <agon/mos.h>
-
-extern FILE _file_streams[FOPEN_MAX];
 
 void clearerr(FILE *stream)
 {
     if ( stream == NULL ) return;
 
-    _file_streams[stream->fhandle].eof = 0;
-    _file_streams[stream->fhandle].err = 0;
+    stream->eof = 0;
+    stream->err = 0;
     return;
 }
@@ -0,0 +1,61 @@
+#ifndef __FAT_STREAM_H_
+#define __FAT_STREAM_H_
+
+/* FILE streams on the FAT file system (fat.h).
+
+   _file_streams[0..2] are stdin, stdout and stderr as the toolchain's stdio
+   expects them, with fhandle FH_STDIN, FH_STDOUT and FH_STDERR. They go to
+   getchar() / putchar() and are never handed out by fopen().
+   An open file is _file_streams[i], i >= _FILE_FIRST, with fhandle = i + 1,
+   the file behind it is _fat_files[i - _FILE_FIRST]. fhandle 0 marks a free
+   slot. */
+
+#include <stdio.h>
+#include <errno.h>
+#include "fat.h"
+
+/* console handles as the toolchain's getchar() / putchar() compare them, or
+   fhandle = i + 1 of their entries when it has none */
+#if defined(__has_include)
+#if __has_include(<agon/mos.h>)
+#include <agon/mos.h>
+#endif
+#endif
+#ifndef FH_STDIN
+#define FH_STDIN    1
+#define FH_STDOUT   2
+#define FH_STDERR   3
+#endif
+
+#define _FILE_FIRST 3
+
+#ifndef EIO
+#define EIO     EINVAL
+#endif
+#ifndef ENOSPC
+#define ENOSPC  EIO
+#endif
+#ifndef ENOMEM
+#define ENOMEM  EIO
+#endif
+#ifndef EEXIST
+#define EEXIST  EACCES
+#endif
+#ifndef EMFILE
+#define EMFILE  EINVAL
+#endif
+
+extern FILE _file_streams[FOPEN_MAX];
+extern fat_file_t _fat_files[FOPEN_MAX - _FILE_FIRST];
+
+/* file behind an open stream, NULL for the console and closed streams */
+static inline fat_file_t *_fat_stream(FILE *stream)
+{
+    if ( stream < _file_streams + _FILE_FIRST || stream >= _file_streams + FOPEN_MAX || stream->fhandle == 0 ) return NULL;
+    return &_fat_files[stream - _file_streams - _FILE_FIRST];
+}
+
+/* errno value for a FAT_ERR_ code */
+int _fat_errno(int fat_error);
+
+#endif
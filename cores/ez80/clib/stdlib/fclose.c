@@ -4,7 +4,7 @@
 
 The C library function int fclose(FILE *stream) function flushes the stream pointed to by stream
 (writing any buffered output data using fflush(3)) and closes the underlying file descriptor.
-Note that there is currently no buffering in this simple implimentation.
+This writes back the buffered sector and the directory entry of the file.
 
 Declaration: Following is the declaration for fclose() function.
   int fclose(FILE *stream)
@@ -20,22 +20,23 @@ Return Value
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
-
-extern FILE _file_streams[FOPEN_MAX];
+#include <errno.h>
+#include "fat_stream.h"
 
 int fclose(FILE *stream)
 {
-    uint8_t mos_fh;
-
-    if ( stream == NULL ) return EOF;
-
-    mos_fh = stream->fhandle;
-    if ( mos_fh == FH_STDIN || mos_fh == FH_STDOUT || mos_fh == FH_STDERR ) return EOF;
+    fat_file_t *file;
+    int stat;
 
-    _file_streams[mos_fh - 1].fhandle = 0;
+    if ( stream == NULL || !(file = _fat_stream(stream)) ) return EOF;
 
-    mos_fclose( mos_fh );           // Returns number of files still open - not an error indication
+    stat = fat_close( file );
+    stream->fhandle = 0;
 
-    return 0;                       // There is no error from MOS, so assume okay
+    if ( stat )
+    {
+        errno = _fat_errno( stat );
+        return EOF;
+    }
+    return 0;
 }
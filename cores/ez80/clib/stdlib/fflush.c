@@ -13,14 +13,37 @@ Return Value
   This function returns a zero value on success. If an error occurs, EOF is returned and
   the error indicator is set (i.e. feof).
 
+  If stream is a NULL pointer, all open files are flushed.
+
 Notes:
-  This currently does nothing as stdio is not buffered.
+  For files this writes back the buffered sector and the directory entry. The console
+  streams are not buffered.
 */
 
 #include <stdio.h>
+#include "fat_stream.h"
 
 int fflush(FILE *stream)
 {
+    fat_file_t *file;
+    int ret = 0;
+
+    if ( stream == NULL )
+    {
+        for ( int i = _FILE_FIRST; i < FOPEN_MAX; i++ )
+        {
+            if ( _file_streams[i].fhandle && fflush( &_file_streams[i] ) ) ret = EOF;
+        }
+        return ret;
+    }
+
     stream->unget_char = 0;
+    if ( !(file = _fat_stream(stream)) ) return 0;
+
+    if ( fat_flush(file) )
+    {
+        stream->err = 1;
+        return EOF;
+    }
     return 0;
 }
@@ -17,30 +17,29 @@ Return Value
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
+#include "fat_stream.h"
 
 int fgetc(FILE *stream)
 {
     int c;
-    uint8_t mos_fh = stream->fhandle;
+    unsigned char b;
+    fat_file_t *file;
 
     if (stream == NULL || stream == stdout || stream == stderr) c = EOF;
     else if ( (c = stream->unget_char) ) stream->unget_char = 0;
-    else if (mos_fh == FH_STDIN) {
-        c = inchar();
-        putchar(c);
-        if ( c == '\r' ) { c = '\n'; putchar(c); }
-    }
+    else if (stream == stdin) c = getchar();
+    else if ( !(file = _fat_stream(stream)) ) c = EOF;
     else {
-        c = mos_fgetc(stream->fhandle);
+        c = fat_read(file, &b, 1) ? b : EOF;
         if ( stream->text_mode && c == '\r' ) {         // Do CR/LF translation for text files
-            c = mos_fgetc(stream->fhandle);
-            if ( c != '\n' ) ungetc( c, stream );       // Put back if just CR and not CR/LF
+            if ( fat_read(file, &b, 1) ) {
+                if ( b == '\n' ) c = '\n';
+                else ungetc( b, stream );               // Put back if just CR and not CR/LF
+            }
         }
+        if ( c == EOF && file->error ) stream->err = 1;
     }
 
-    if ( c == 0 ) c = EOF;              // mos routine returns zero if error
-
     if ( stream ) {
         if (c == EOF) stream->eof = 1;
     }
@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "fat_stream.h"
+
+unsigned int fgetsize(FILE *file) {
+
+    if(file == NULL) return 0;
+
+    fat_file_t *fileobject = _fat_stream(file);
+    if(fileobject == NULL) return 0;
+    return fat_size(fileobject);
+}
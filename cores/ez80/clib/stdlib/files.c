@@ -0,0 +1,39 @@
+/* File stream table
+   -----------------
+
+stdin, stdout, stderr and the streams opened by fopen(), and the FAT files
+behind the latter, see fat_stream.h.
+*/
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "fat_stream.h"
+
+FILE _file_streams[FOPEN_MAX] = {
+    { .fhandle = FH_STDIN, .text_mode = true },
+    { .fhandle = FH_STDOUT, .text_mode = true },
+    { .fhandle = FH_STDERR, .text_mode = true },
+};
+fat_file_t _fat_files[FOPEN_MAX - _FILE_FIRST];
+
+int _fat_errno(int fat_error)
+{
+    switch( fat_error )
+    {
+        case FAT_ERR_NOT_FOUND:
+        case FAT_ERR_NAME:
+        case FAT_ERR_NOT_MOUNTED:
+            return ENOENT;
+        case FAT_ERR_EXISTS:
+            return EEXIST;
+        case FAT_ERR_DENIED:
+            return EACCES;
+        case FAT_ERR_FULL:
+            return ENOSPC;
+        case FAT_ERR_NO_MEMORY:
+            return ENOMEM;
+        default:
+            return EIO;
+    }
+}
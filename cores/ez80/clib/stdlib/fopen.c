@@ -58,50 +58,39 @@ Return value:
        return a FILE pointer.  Otherwise, NULL is returned and errno is
        set to indicate the error.
 
-Calls: uint8_t  mos_fopen(char *fname, unit8_t mode);   // returns filehandle, or 0 on error
-
-Mode flag - from FatFS documentation:
-
-FA_READ             Specifies read access to the file. Data can be read from the file.
-FA_WRITE            Specifies write access to the file. Data can be written to the file. Combine with FA_READ for read-write access.
-FA_OPEN_EXISTING    Opens a file. The function fails if the file is not existing. (Default)
-FA_CREATE_NEW       Creates a new file. The function fails with FR_EXIST if the file is existing.
-FA_CREATE_ALWAYS    Creates a new file. If the file is existing, it will be truncated and overwritten.
-FA_OPEN_ALWAYS      Opens the file if it is existing. If not, a new file will be created.
-FA_OPEN_APPEND      Same as FA_OPEN_ALWAYS except the read/write pointer is set end of the file.
-
-"r"                 FA_READ
-"r+"                FA_READ | FA_WRITE
-"w"                 FA_CREATE_ALWAYS | FA_WRITE
-"w+"                FA_CREATE_ALWAYS | FA_WRITE | FA_READ
-"a"                 FA_OPEN_APPEND | FA_WRITE
-"a+"                FA_OPEN_APPEND | FA_WRITE | FA_READ
-"wx"                FA_CREATE_NEW | FA_WRITE
-"w+x"               FA_CREATE_NEW | FA_WRITE | FA_READ
+Calls: int fat_open(fat_file_t *f, const char *path, uint8_t mode);   // returns 0, or FAT_ERR_ on error
+
+The file system must have been mounted with fat_mount() before. Mode flags (fat.h):
+
+"r"                 FAT_READ
+"r+"                FAT_READ | FAT_WRITE
+"w"                 FAT_WRITE | FAT_CREATE | FAT_TRUNC
+"w+"                FAT_WRITE | FAT_CREATE | FAT_TRUNC | FAT_READ
+"a"                 FAT_WRITE | FAT_CREATE | FAT_APPEND
+"a+"                FAT_WRITE | FAT_CREATE | FAT_APPEND | FAT_READ
+"wx"                FAT_WRITE | FAT_CREATE | FAT_TRUNC | FAT_EXCL
+"w+x"               FAT_WRITE | FAT_CREATE | FAT_TRUNC | FAT_EXCL | FAT_READ
 
 Mods / updates:
 13/07/2023 -  correct modes "a" and "a+" despite documentation file is opened for writing at the beginning 
               of the file. Work around added to seek to end of the file.
+              Now FAT_APPEND moves every write to the end of the file, the initial read position
+              is the end of the file.
 */
 
-//#include <fileioc.h>
-
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <agon/mos.h>
 #include <stdbool.h>
-
-extern FILE _file_streams[FOPEN_MAX];
+#include "fat_stream.h"
 
 uint8_t __fmodeflags(const char *);
 
 FILE* fopen(const char *__restrict filename, const char *__restrict mode)
 {
-    uint8_t mos_fh;             // file handled returned by MOS (0 = error)
     uint8_t index;              // index into _file_streams table
-    uint8_t flags;              // flags computed from the mode string
+    int stat;
 
     /* Check for valid initial mode character */
     if (!strchr("rwa", *mode)) {
@@ -109,28 +98,30 @@ FILE* fopen(const char *__restrict filename, const char *__restrict mode)
         return NULL;
     }
 
-    /* Compute the flags to pass to open() */
-    flags = __fmodeflags(mode);
-
+    for ( index = _FILE_FIRST; index < FOPEN_MAX; index++ )
+    {
+        if ( _file_streams[index].fhandle == 0 ) break;
+    }
+    if ( index == FOPEN_MAX )
+    {
+        errno = EMFILE;
+        return NULL;
+    }
 
-    mos_fh = mos_fopen(filename, flags);
-    if (mos_fh == 0)
+    stat = fat_open( &_fat_files[index - _FILE_FIRST], filename, __fmodeflags(mode) );
+    if ( stat )
     {
+        errno = _fat_errno( stat );
         return NULL;
     }
 
-    index = mos_fh - 1;
-    _file_streams[index].fhandle = mos_fh;
+    _file_streams[index].fhandle = index + 1;
     _file_streams[index].eof = 0;
     _file_streams[index].err = 0;
     _file_streams[index].unget_char = 0;
     if ( strchr(mode, 'b') ) _file_streams[index].text_mode = false;
     else _file_streams[index].text_mode = true;
 
-    // workaround for bug in MOS / FatFS
-
-    if ( mode[0] == 'a' ) fseek( &_file_streams[index], 0L, SEEK_END );
-
     return &_file_streams[index];
 }
 
@@ -139,26 +130,15 @@ uint8_t __fmodeflags(const char *mode)
 {
     uint8_t flags;
 
-    if (strchr(mode, '+')) flags = FA_READ | FA_WRITE;
-    else if (*mode == 'r') flags = FA_READ;
-    else flags = FA_WRITE;
+    if (strchr(mode, '+')) flags = FAT_READ | FAT_WRITE;
+    else if (*mode == 'r') flags = FAT_READ;
+    else flags = FAT_WRITE;
 
     if (*mode == 'w') {
-       if (strchr(mode, 'x')) flags |= FA_CREATE_NEW;
-              else flags |= FA_CREATE_ALWAYS;
+       flags |= FAT_CREATE | FAT_TRUNC;
+       if (strchr(mode, 'x')) flags |= FAT_EXCL;
        }
-    if (*mode == 'a') flags |= FA_OPEN_APPEND;
+    if (*mode == 'a') flags |= FAT_CREATE | FAT_APPEND;
 
     return flags;
 }
-
-/* Mapping of mode string to flags from FatFS documents (copied here for reference)
-"r"                 FA_READ
-"r+"                FA_READ | FA_WRITE
-"w"                 FA_CREATE_ALWAYS | FA_WRITE
-"w+"                FA_CREATE_ALWAYS | FA_WRITE | FA_READ
-"a"                 FA_OPEN_APPEND | FA_WRITE
-"a+"                FA_OPEN_APPEND | FA_WRITE | FA_READ
-"wx"                FA_CREATE_NEW | FA_WRITE
-"w+x"               FA_CREATE_NEW | FA_WRITE | FA_READ
-*/
\ No newline at end of file
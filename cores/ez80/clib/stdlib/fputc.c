@@ -18,34 +18,25 @@ Return Value
   If an error occurs, EOF is returned and the error indicator is set.
 */
 
-
 #include <stdio.h>
-#include <agon/mos.h>
-
-void fput_char( int c, FILE *stream );
+#include "fat_stream.h"
 
 int fputc(int c, FILE *stream)
 {
-    int ret = c;
+    unsigned char b[2];
+    size_t n = 0;
+    fat_file_t *file;
 
-    if (stream == NULL || stream == stdin) ret = EOF;
-    else {
-        if ( stream->text_mode && c == '\n' ) fput_char( '\r', stream );
-        fput_char( c, stream );
-    }
+    if (stream == NULL || stream == stdin) return EOF;
+    if (stream == stdout || stream == stderr) return putchar(c);
+    if ( !(file = _fat_stream(stream)) ) return EOF;
+
+    if ( stream->text_mode && c == '\n' ) b[n++] = '\r';
+    b[n++] = (unsigned char)c;
 
-    if ( stream ) {
-        if (ret == EOF) stream->eof = 1;
-        if (ret != c) stream->err = 1;
+    if ( fat_write(file, b, n) != n ) {
+        stream->err = 1;
+        return EOF;
     }
-    
-    return ret;
+    return (unsigned char)c;
 }
-
-void fput_char( int c, FILE *stream )
-{
-    uint8_t mos_fh = stream->fhandle;
-
-    if ( mos_fh == FH_STDOUT || mos_fh == FH_STDERR ) outchar(c);
-    else mos_fputc(stream->fhandle, (char)c );         // The mos routine does not return anything
-}
\ No newline at end of file
@@ -20,21 +20,22 @@ Return Value
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
+#include "fat_stream.h"
 
 size_t fread(void *ptr, size_t size, size_t count, FILE *__restrict stream)
 {
     size_t nbytes;
     size_t len = size * count;
+    char *p = (char *)ptr;
+    fat_file_t *file;
 
-    if (stream == NULL || stream == stdout || stream == stderr) return 0;
+    if (stream == NULL || stream == stdout || stream == stderr || size == 0) return 0;
 
     // For stdin read characters one by one using fgetc upto size*count characters
 
     if (stream == stdin)
     {
         int c;
-        char *p = (char *)ptr;
 
         for ( nbytes = 0; nbytes < len; nbytes++ )
         {
@@ -44,10 +45,23 @@ size_t fread(void *ptr, size_t size, size_t count, FILE *__restrict stream)
         return nbytes / size;
     }
 
-    // For regular file use mos_fread
+    // For regular file use fat_read, whole sectors go straight into ptr
 
-    nbytes = mos_fread( stream->fhandle, ptr, len );
-    if ( nbytes != len ) stream->err = 1;
+    if ( !(file = _fat_stream(stream)) ) return 0;
+
+    nbytes = 0;
+    if ( len && stream->unget_char )
+    {
+        *p++ = stream->unget_char;
+        stream->unget_char = 0;
+        nbytes = 1;
+    }
+    nbytes += fat_read( file, p, len - nbytes );
+    if ( nbytes != len )
+    {
+        if ( file->error ) stream->err = 1;
+        else stream->eof = 1;
+    }
 
     return nbytes / size;
 }
@@ -17,8 +17,7 @@ Parameters
     SEEK_END    End of file.
     SEEK_SET    Beginning of file.
 
-    NOTE: SEEK_END is not currently supported on Agon as doesn't seem to be a way to find the
-    file lenght. If this functionality is required, close and reopen the file in append mode.
+    Seeking past the end of the file is allowed, a following write fills the gap with zeros.
 
 Return Value
   If successful, fseek and returns 0. Otherwise, it returns a nonzero value. On
@@ -26,38 +25,45 @@ Return Value
   or if origin isn't one of allowed values described below, the function invokes the
   invalid parameter handler, as described in Parameter validation. If execution is allowed
   to continue, these functions set errno to EINVAL and return -1.
-  On Agon there is currently no "invalid parameter handler"
+  There is currently no "invalid parameter handler"
 
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
 #include <errno.h>
+#include "fat_stream.h"
 
 int fseek(FILE *stream, long int offset, int origin)
 {
-    if (stream == NULL || stream->fhandle >= FH_STDIN )
+    fat_file_t *file;
+
+    if (stream == NULL || !(file = _fat_stream(stream)))
     {
         errno = EINVAL;
         return -1;
     }
 
-    stream->unget_char = 0;
-
-    FIL *file_struct = mos_getfil( stream->fhandle );
     switch( origin )
     {
         case SEEK_SET:
             break;
         case SEEK_CUR:
-            offset += (long)(file_struct->fptr);
+            offset += (long)fat_tell(file) - (stream->unget_char ? 1 : 0);
             break;
         case SEEK_END:
-            offset += (long)(file_struct->obj.objsize);
+            offset += (long)fat_size(file);
             break;
         default:
             errno = EINVAL;
             return -1;
     }
-    return mos_flseek( stream->fhandle, offset );
+    if ( offset < 0 )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stream->unget_char = 0;
+    stream->eof = 0;
+    return fat_seek( file, (uint32_t)offset ) ? -1 : 0;
 }
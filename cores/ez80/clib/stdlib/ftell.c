@@ -19,22 +19,22 @@ Return Value
   constants, defined in ERRNO.H. EINVAL means an invalid stream argument was passed to the
   function, also returns this for devices incapable of seeking
   (such as terminals and printers).
-  On Agon there is currently no "invalid parameter handler"
+  There is currently no "invalid parameter handler"
 */
 
 #include <stdio.h>
 #include <errno.h>
-#include <agon/mos.h>
+#include "fat_stream.h"
 
 long int ftell(FILE *stream)
 {
-    if (stream == NULL || stream->fhandle >= FH_STDIN)
+    fat_file_t *file;
+
+    if (stream == NULL || !(file = _fat_stream(stream)))
     {
         errno = EINVAL;
         return -1L;
     }
 
-    FIL *file_struct = mos_getfil( stream->fhandle );
-
-    return (long)(file_struct->fptr);
+    return (long)fat_tell(file) - (stream->unget_char ? 1 : 0);
 }
@@ -20,14 +20,15 @@ Return Value
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
+#include "fat_stream.h"
 
 size_t fwrite(const void *__restrict ptr, size_t size, size_t count, FILE *__restrict stream)
 {
     size_t nbytes;
     size_t len = size * count;
+    fat_file_t *file;
 
-    if (stream == NULL || stream == stdin) return 0;
+    if (stream == NULL || stream == stdin || size == 0) return 0;
 
     // For stdout & stderr write characters one by one using fputc upto size*count characters
 
@@ -42,9 +43,11 @@ size_t fwrite(const void *__restrict ptr, size_t size, size_t count, FILE *__res
         return nbytes / size;
     }
 
-    // For regular file use mos_fwrite
+    // For regular file use fat_write, whole sectors go straight from ptr to the device
 
-    nbytes = mos_fwrite( stream->fhandle, (char *)ptr, len );
+    if ( !(file = _fat_stream(stream)) ) return 0;
+
+    nbytes = fat_write( file, ptr, len );
     if ( nbytes != len ) stream->err = 1;
 
     return nbytes / size;
@@ -16,30 +16,15 @@ Return Value
 */
 
 #include <stdio.h>
-#include <agon/mos.h>
 #include <errno.h>
+#include "fat_stream.h"
 
 int remove(const char *fname)
 {
     int stat;
 
-    if ( !(stat = mos_del(fname)) ) return 0;
-
-    switch( stat )
-    {
-        case FR_NO_FILE:
-        case FR_NO_PATH:
-        case FR_INVALID_NAME:
-            errno = ENOENT;
-            break;
-        case FR_DENIED:
-        case FR_EXIST:
-        case FR_WRITE_PROTECTED:
-            errno = EACCES;
-            break;
-        default:
-            errno = EINVAL;
-    }
+    if ( !(stat = fat_remove(fname)) ) return 0;
 
+    errno = _fat_errno( stat );
     return -1;
 }
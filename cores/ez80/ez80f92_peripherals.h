@@ -16,3 +16,59 @@ enum {
     TMR_CTL_IRQ_EN     = (1 << 6),  // Interrupt enable
     TMR_CTL_PRT_IRQ    = (1 << 7)   // timer has reached end of count? (readonly)
 };
+
+//==============================================================
+// Bit masks for SPI_CTL and SPI_SR (from product spec)
+//==============================================================
+
+enum {
+    SPI_CTL_CPHA       = (1 << 2),  // clock phase, 1 = sample on the trailing edge
+    SPI_CTL_CPOL       = (1 << 3),  // clock polarity, 1 = SCK idles high
+    SPI_CTL_MASTER_EN  = (1 << 4),  // master mode
+    SPI_CTL_SPI_EN     = (1 << 5),  // enable SPI
+    SPI_CTL_IRQ_EN     = (1 << 7)   // interrupt on SPIF
+};
+
+enum {
+    SPI_SR_MODF        = (1 << 4),  // mode fault, /SS went low in master mode
+    SPI_SR_WCOL        = (1 << 6),  // SPI_TSR written during a transfer
+    SPI_SR_SPIF        = (1 << 7)   // transfer complete, reading SPI_SR clears the flags
+};
+
+//==============================================================
+// Bit masks for I2C_CTL (from product spec)
+//==============================================================
+
+enum {
+    I2C_CTL_AAK        = (1 << 2),  // acknowledge received bytes / own slave address
+    I2C_CTL_IFLG       = (1 << 3),  // state changed, writing 0 continues the bus state machine
+    I2C_CTL_STP        = (1 << 4),  // send STOP
+    I2C_CTL_STA        = (1 << 5),  // send (repeated) START
+    I2C_CTL_ENAB       = (1 << 6),  // enable the bus interface
+    I2C_CTL_IEN        = (1 << 7)   // interrupt on IFLG
+};
+
+//==============================================================
+// Flash controller (from product spec)
+//==============================================================
+
+enum {
+    FLASH_KEY_1        = 0xB6,      // written to FLASH_KEY in this order, unlocks
+    FLASH_KEY_2        = 0x49       // the next write to FLASH_FDIV or FLASH_PROT
+};
+
+enum {
+    FLASH_PGCTL_MASS_ERASE = (1 << 0),
+    FLASH_PGCTL_PG_ERASE   = (1 << 1),  // erase the page in FLASH_PAGE, clears when done
+    FLASH_PGCTL_ROW_PGM    = (1 << 2)   // row programming through FLASH_DATA
+};
+
+enum {
+    FLASH_IRQ_MASS_VIO = (1 << 0),  // mass erase of a protected block
+    FLASH_IRQ_PG_VIO   = (1 << 1),  // page erase of a protected block
+    FLASH_IRQ_RP_TMO   = (1 << 2),  // row programming time-out
+    FLASH_IRQ_WR_VIO   = (1 << 3),  // write to a protected block
+    FLASH_IRQ_DONE     = (1 << 5),  // erase / program done, reading FLASH_IRQ clears the flags
+    FLASH_IRQ_ERR_IEN  = (1 << 6),
+    FLASH_IRQ_DONE_IEN = (1 << 7)
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <ez80f92.h>
+#include "pins_api.h"
+#include "pin_irq.h"
+
+//==============================================================
+// Compile-time GPIO access
+//==============================================================
+// digitalWrite() takes the pin as a runtime value, so the port register has to be
+// computed and is accessed through BC (in a,(bc) / out (bc),a). When the pin is a
+// constant, the register address and the bit mask are known at compile time and
+// every access becomes an in0 / and|or|xor / out0 sequence without a call, after a
+// test of the port's entry in pin_irq_port.
+//
+//     FastPin<PB3>::output();
+//     FastPin<PB3>::high();
+//     FastPin<PB3>::toggle();
+//     if (FastPin<PD2>::read()) { ... }
+//
+// Like digitalWrite() the set/clear/toggle operations are a read-modify-write of the
+// whole port, an ISR changing other pins of the same port in between is not guarded.
+// If the port has attachInterrupt() pins, whose DR bits do not read back, they take
+// the slower, guarded path of digitalWrite() instead (port_dr_update(), pin_irq.h).
+// examples/GpioToggleBenchmark compares the write times with digitalWrite().
+
+template <pin_size_t PIN>
+struct FastPin {
+    static_assert(GET_PORT(PIN) <= PORTD, "FastPin needs a pin of PORTB, PORTC or PORTD");
+
+    static constexpr uint8_t port = GET_PORT(PIN);
+    static constexpr uint8_t mask = (uint8_t)(1u << GET_PIN(PIN));
+    /* PB_DR = 0x9A, PC_DR = 0x9E, PD_DR = 0xA2, DDR, ALT1 and ALT2 follow DR */
+    static constexpr uint8_t dr = PB_DR + (port << 2u);
+    static constexpr uint8_t ddr = PB_DDR + (port << 2u);
+    static constexpr uint8_t alt1 = PB_ALT1 + (port << 2u);
+    static constexpr uint8_t alt2 = PB_ALT2 + (port << 2u);
+
+    static inline __attribute__((always_inline)) void high() { port_dr_update(port, (uint8_t)~mask, mask); }
+    static inline __attribute__((always_inline)) void low() { port_dr_update(port, (uint8_t)~mask, 0); }
+    static inline __attribute__((always_inline)) void toggle() { port_dr_update(port, 0xFF, mask); }
+    static inline __attribute__((always_inline)) void write(bool value) {
+        if (value) {
+            high();
+        } else {
+            low();
+        }
+    }
+    static inline __attribute__((always_inline)) bool read() { return (IO(dr) & mask) != 0; }
+
+    /* modes as in pinMode(): ALT2 and ALT1 cleared, DDR selects the direction */
+    static inline __attribute__((always_inline)) void output() {
+        IO(alt2) &= (uint8_t)~mask;
+        IO(alt1) &= (uint8_t)~mask;
+        IO(ddr) &= (uint8_t)~mask;
+    }
+    static inline __attribute__((always_inline)) void input() {
+        IO(alt2) &= (uint8_t)~mask;
+        IO(alt1) &= (uint8_t)~mask;
+        IO(ddr) |= mask;
+    }
+};
+
+// Function style variants. With a constant pin they compile to the same code as
+// FastPin<pin>, with a variable pin they behave like digitalWrite() and digitalRead().
+static inline __attribute__((always_inline)) void digitalWriteFast(pin_size_t pin, PinStatus status) {
+    const uint8_t pin_mask = (uint8_t)(1u << GET_PIN(pin));
+    port_dr_update(GET_PORT(pin), (uint8_t)~pin_mask, status == LOW ? 0 : pin_mask);
+}
+
+static inline __attribute__((always_inline)) void digitalToggleFast(pin_size_t pin) {
+    port_dr_update(GET_PORT(pin), 0xFF, (uint8_t)(1u << GET_PIN(pin)));
+}
+
+static inline __attribute__((always_inline)) PinStatus digitalReadFast(pin_size_t pin) {
+    const uint8_t ioport_dr = PB_DR + (uint8_t)(GET_PORT(pin) << 2u);
+    return (IO((int)ioport_dr) & (uint8_t)(1u << GET_PIN(pin))) != 0 ? HIGH : LOW;
+}
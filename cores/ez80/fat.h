@@ -0,0 +1,115 @@
+#ifndef __FAT_H_
+#define __FAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blockdev.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* FAT16 / FAT32 file system on a blockdev_t, used by the stdio file functions
+   (fopen, fread, fwrite, ...) in clib. One volume can be mounted at a time,
+   either a superfloppy or the first FAT partition of an MBR disk.
+
+       SdCard card;
+       card.begin(SPI, PB2);
+       fat_mount(card.blockdev());
+       FILE *f = fopen("/LOGS/DATA.CSV", "a");
+
+   Paths are absolute, '/' separated, with 8.3 names (matched case insensitive,
+   created in upper case). Long file name entries are skipped.
+
+   Data is read and written in whole sectors straight between the caller's
+   buffer and the device wherever the file position is sector aligned, across
+   as many contiguous clusters as the transfer covers; only partial sectors go
+   through the 512 byte buffer of the open file. New clusters are taken right
+   after the file's last cluster when that one is free, and fat_reserve()
+   allocates one contiguous run up front, e.g. for a log file, so that later
+   appends never touch the FAT.
+
+   The code only depends on the C library and blockdev_t, so it also builds on
+   a PC against a disk image file, see extras/host/fat. */
+
+#define FAT_OK              0
+#define FAT_ERR_IO          (-1)        /* device read / write failed */
+#define FAT_ERR_NO_FS       (-2)        /* no FAT16 / FAT32 volume found */
+#define FAT_ERR_NOT_MOUNTED (-3)
+#define FAT_ERR_NOT_FOUND   (-4)
+#define FAT_ERR_EXISTS      (-5)
+#define FAT_ERR_DENIED      (-6)        /* read only file, directory, or wrong access mode */
+#define FAT_ERR_NAME        (-7)        /* not a valid 8.3 path */
+#define FAT_ERR_FULL        (-8)        /* no free cluster or directory entry */
+#define FAT_ERR_NO_MEMORY   (-9)
+
+/* fat_open() mode flags */
+#define FAT_READ            0x01
+#define FAT_WRITE           0x02
+#define FAT_CREATE          0x04        /* create the file if it does not exist */
+#define FAT_TRUNC           0x08        /* discard the contents */
+#define FAT_EXCL            0x10        /* with FAT_CREATE: fail if the file exists */
+#define FAT_APPEND          0x20        /* every write goes to the end of the file */
+
+/* clusters of a file that are known to be consecutive */
+typedef struct fat_extent {
+    uint32_t index;             /* position in the cluster chain */
+    uint32_t cluster;
+    uint32_t count;             /* 0 = unused */
+} fat_extent_t;
+
+#define FAT_FILE_EXTENTS    4
+
+typedef struct fat_file {
+    uint32_t size;
+    uint32_t pos;
+    uint32_t start;             /* first cluster, 0 for an empty file */
+    uint32_t dir_lba;           /* directory entry */
+    uint16_t dir_offset;
+    uint8_t mode;
+    uint8_t flags;
+    int8_t error;               /* last error, 0 if none */
+    uint8_t extent_next;        /* next extent slot to replace */
+    fat_extent_t extents[FAT_FILE_EXTENTS];
+    uint32_t buf_pos;           /* file offset of the sector in buf, FAT_NO_SECTOR if none */
+    uint32_t buf_lba;
+    uint8_t *buf;               /* BLOCKDEV_SECTOR_SIZE bytes */
+} fat_file_t;
+
+#define FAT_NO_SECTOR       0xFFFFFFFFUL
+
+/* Reads the volume information from dev. Any mounted volume is synced and
+   unmounted first. */
+int fat_mount(blockdev_t *dev);
+/* Writes back all cached data. Open files must be closed before. */
+int fat_unmount(void);
+/* Writes back the cached FAT and directory sectors and syncs the device. */
+int fat_sync(void);
+/* free space in bytes, counts the clusters on the first call after mounting
+   unless the FAT32 FSInfo sector has the number */
+uint32_t fat_free(void);
+
+int fat_open(fat_file_t *f, const char *path, uint8_t mode);
+int fat_close(fat_file_t *f);
+/* writes back the buffered sector and the directory entry */
+int fat_flush(fat_file_t *f);
+/* return the number of bytes transferred, f->error is set if it is short
+   because of an error */
+size_t fat_read(fat_file_t *f, void *buf, size_t len);
+size_t fat_write(fat_file_t *f, const void *buf, size_t len);
+/* positions past the end are allowed, the gap reads as zeros after a write */
+int fat_seek(fat_file_t *f, uint32_t pos);
+static inline uint32_t fat_tell(fat_file_t *f) { return f->pos; }
+static inline uint32_t fat_size(fat_file_t *f) { return f->size; }
+/* Allocates one contiguous run of clusters so the file can grow to size
+   bytes without further allocation. Clusters the file has not used are
+   released again by fat_close(). */
+int fat_reserve(fat_file_t *f, uint32_t size);
+
+int fat_remove(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
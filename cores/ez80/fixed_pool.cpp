@@ -0,0 +1,43 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "irq.h"
+#include "fixed_pool.h"
+
+void fixed_pool_init(fixed_pool_t *pool, void *storage, size_t block_size, size_t count)
+{
+    pool->free_list = NULL;
+    pool->block_size = FIXED_POOL_BLOCK_SIZE(block_size);
+    pool->fresh = (uint8_t *)storage;
+    pool->end = pool->fresh + pool->block_size * count;
+    pool->count = count;
+    pool->used = 0;
+    pool->peak = 0;
+}
+
+void *fixed_pool_alloc(fixed_pool_t *pool)
+{
+    uint8_t state = irq_save();
+    void *block = pool->free_list;
+    if (block) {
+        pool->free_list = *(void **)block;
+    } else if (pool->fresh != pool->end) {
+        block = pool->fresh;
+        pool->fresh += pool->block_size;
+    } else {
+        irq_restore(state);
+        return NULL;
+    }
+    if (++pool->used > pool->peak) pool->peak = pool->used;
+    irq_restore(state);
+    return block;
+}
+
+void fixed_pool_free(fixed_pool_t *pool, void *block)
+{
+    if (!block) return;
+    uint8_t state = irq_save();
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->used--;
+    irq_restore(state);
+}
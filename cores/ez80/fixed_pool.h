@@ -0,0 +1,57 @@
+#ifndef __FIXED_POOL_H_
+#define __FIXED_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pool of equally sized blocks in static storage, for allocations in interrupt
+   handlers or anywhere malloc() is not wanted. fixed_pool_alloc() and
+   fixed_pool_free() are O(1) and run with interrupts disabled for a few
+   instructions (irq.h), so they can be called from both sides.
+
+       FIXED_POOL_DEFINE(frames, sizeof(frame_t), 16);
+       frame_t *f = (frame_t *)fixed_pool_alloc(&frames);
+       ...
+       fixed_pool_free(&frames, f);
+
+   Blocks that were never used are handed out in order from the storage, so a
+   pool needs no initialisation at runtime. arduino::FixedPool<T, N> in
+   api/FixedPool.h is the typed C++ version. */
+
+typedef struct fixed_pool {
+    void *free_list;            /* released blocks */
+    uint8_t *fresh;             /* first block never handed out */
+    uint8_t *end;               /* end of the storage */
+    size_t block_size;          /* at least sizeof(void *) */
+    size_t count;
+    size_t used;
+    size_t peak;                /* high water mark of used */
+} fixed_pool_t;
+
+#define FIXED_POOL_BLOCK_SIZE(size) ((size) < sizeof(void *) ? sizeof(void *) : (size))
+#define FIXED_POOL_INIT(storage, block_size, count) \
+    { NULL, (uint8_t *)(storage), (uint8_t *)(storage) + FIXED_POOL_BLOCK_SIZE(block_size) * (count), \
+      FIXED_POOL_BLOCK_SIZE(block_size), (count), 0, 0 }
+/* defines a pool `name` with static storage for count blocks of size bytes */
+#define FIXED_POOL_DEFINE(name, size, count) \
+    static uint8_t name##_storage[FIXED_POOL_BLOCK_SIZE(size) * (count)]; \
+    fixed_pool_t name = FIXED_POOL_INIT(name##_storage, size, count)
+
+/* for storage that is not known at compile time */
+void fixed_pool_init(fixed_pool_t *pool, void *storage, size_t block_size, size_t count);
+/* NULL when all blocks are in use */
+void *fixed_pool_alloc(fixed_pool_t *pool);
+/* block must come from this pool, NULL is ignored */
+void fixed_pool_free(fixed_pool_t *pool, void *block);
+
+static inline size_t fixed_pool_available(const fixed_pool_t *pool) { return pool->count - pool->used; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "flash.h"
+
+// flash_ramfunc.S, return FLASH_IRQ with interrupts disabled
+extern "C" uint8_t flash_erase_raw(uint8_t page);
+extern "C" uint8_t flash_row_raw(uint8_t page, uint8_t row, uint8_t col, const uint8_t *src, size_t count);
+
+// FLASH_FDIV for a 154..193 kHz flash clock
+#define FLASH_DIV   ((F_CPU + 192999UL) / 193000UL)
+
+#define FLASH_IRQ_ERRORS (FLASH_IRQ_MASS_VIO | FLASH_IRQ_PG_VIO | FLASH_IRQ_RP_TMO | FLASH_IRQ_WR_VIO)
+
+// the row being programmed, the source may be in flash itself
+static uint8_t row_buffer[FLASH_ROW_SIZE];
+static uint8_t saved_prot;
+
+static bool in_range(uintptr_t addr, size_t len)
+{
+    uintptr_t first = ((uintptr_t)__flash_image_end + FLASH_PAGE_SIZE - 1) & ~(uintptr_t)(FLASH_PAGE_SIZE - 1);
+    return addr >= first && addr <= (uintptr_t)__flash_end && len <= (uintptr_t)__flash_end - addr;
+}
+
+//==============================================================
+// Controller unlock
+//==============================================================
+
+static void unlock(uint8_t page)
+{
+    __asm("di");
+    IO(FLASH_KEY) = FLASH_KEY_1;
+    IO(FLASH_KEY) = FLASH_KEY_2;
+    IO(FLASH_FDIV) = FLASH_DIV;
+    saved_prot = IO(FLASH_PROT);
+    IO(FLASH_KEY) = FLASH_KEY_1;
+    IO(FLASH_KEY) = FLASH_KEY_2;
+    IO(FLASH_PROT) = saved_prot & ~(1 << (page >> 3));
+    (void)IO(FLASH_IRQ);        // clear stale flags
+}
+
+static int relock(uint8_t status)
+{
+    IO(FLASH_KEY) = FLASH_KEY_1;
+    IO(FLASH_KEY) = FLASH_KEY_2;
+    IO(FLASH_PROT) = saved_prot;
+    __asm("ei");
+    return (status & FLASH_IRQ_ERRORS) ? FLASH_ERR_WRITE : FLASH_OK;
+}
+
+//==============================================================
+// API
+//==============================================================
+
+int flash_erase_page(const void *addr)
+{
+    uintptr_t a = (uintptr_t)addr & ~(uintptr_t)(FLASH_PAGE_SIZE - 1);
+    if (!in_range(a, FLASH_PAGE_SIZE)) return FLASH_ERR_RANGE;
+
+    uint8_t page = a / FLASH_PAGE_SIZE;
+    unlock(page);
+    int ret = relock(flash_erase_raw(page));
+    if (ret != FLASH_OK) return ret;
+
+    const uint8_t *p = (const uint8_t *)a;
+    for (size_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+        if (p[i] != 0xFF) return FLASH_ERR_VERIFY;
+    }
+    return FLASH_OK;
+}
+
+int flash_program(const void *dst, const void *src, size_t len)
+{
+    uintptr_t a = (uintptr_t)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    if (!in_range(a, len)) return FLASH_ERR_RANGE;
+
+    while (len) {
+        // one row at a time, FLASH_COL does not carry into FLASH_ROW
+        uint8_t col = a % FLASH_ROW_SIZE;
+        size_t n = FLASH_ROW_SIZE - col;
+        if (n > len) n = len;
+        memcpy(row_buffer, s, n);
+
+        uint8_t page = a / FLASH_PAGE_SIZE;
+        uint8_t row = (a / FLASH_ROW_SIZE) % (FLASH_PAGE_SIZE / FLASH_ROW_SIZE);
+        unlock(page);
+        int ret = relock(flash_row_raw(page, row, col, row_buffer, n));
+        if (ret != FLASH_OK) return ret;
+        if (memcmp((const void *)a, row_buffer, n) != 0) return FLASH_ERR_VERIFY;
+
+        a += n;
+        s += n;
+        len -= n;
+    }
+    return FLASH_OK;
+}
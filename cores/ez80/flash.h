@@ -0,0 +1,41 @@
+#ifndef __FLASH_H_
+#define __FLASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runtime erase and programming of the internal flash. The flash is memory
+   mapped from address 0, so it is read through plain pointers.
+
+   Erased bytes read 0xFF and programming can only clear bits, so a byte is
+   written once between two erases of its page. The controller part of both
+   functions runs from RAM with interrupts disabled, and interrupts are enabled
+   again afterwards. Pages holding the program are refused. */
+
+#define FLASH_PAGE_SIZE     2048
+#define FLASH_ROW_SIZE      256
+#define FLASH_BLOCK_SIZE    16384       /* unit of FLASH_PROT */
+
+#define FLASH_OK            0
+#define FLASH_ERR_RANGE     (-1)        /* outside the flash or inside the program */
+#define FLASH_ERR_WRITE     (-2)        /* the controller reported a violation or time-out */
+#define FLASH_ERR_VERIFY    (-3)        /* read back differs, e.g. the bytes were not erased */
+
+/* end of the program image and of the flash (linker script) */
+extern char __flash_image_end[];
+extern char __flash_end[];
+
+/* erases the page containing addr */
+int flash_erase_page(const void *addr);
+/* programs len bytes at dst, src may be in flash as well */
+int flash_program(const void *dst, const void *src, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
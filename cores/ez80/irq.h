@@ -0,0 +1,25 @@
+#ifndef __IRQ_H_
+#define __IRQ_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Critical sections that nest and also work inside interrupt handlers:
+
+       uint8_t state = irq_save();
+       ...
+       irq_restore(state);
+
+   irq_save() disables interrupts and returns whether they were enabled before
+   (IEF2), irq_restore() enables them again only in that case. */
+uint8_t irq_save(void);
+void irq_restore(uint8_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
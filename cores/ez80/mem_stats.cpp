@@ -0,0 +1,49 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "uart.h"
+#include "mem_stats.h"
+
+#define MEM_STATS_VERSION 1
+
+// __stack and ___stack_limit in the linker script
+extern "C" char _stack[];
+extern "C" volatile unsigned int __stack_limit;
+
+// the lowest 3 bytes of the stack hold the canary, painting starts above
+size_t stack_high_water(void)
+{
+    const uint8_t *p = (const uint8_t *)&__stack_limit + 3;
+    while (p < (const uint8_t *)_stack && *p == STACK_PAINT)
+        p++;
+    return (const uint8_t *)_stack - p;
+}
+
+void mem_stats(mem_stats_t *stats)
+{
+    uint8_t here;
+    heap_stats(&stats->heap);
+    stats->stack_size = _stack - (char *)&__stack_limit;
+    stats->stack_used = _stack - (char *)&here;
+    stats->stack_peak = stack_high_water();
+}
+
+void mem_stats_dump(void)
+{
+    mem_stats_t stats;
+    mem_stats(&stats);
+
+    const size_t *values = (const size_t *)&stats;
+    const uint8_t count = sizeof(stats) / sizeof(size_t);
+    uint8_t frame[4 + sizeof(stats) / sizeof(size_t) * 3];
+    uint8_t *p = frame;
+    *p++ = 'M';
+    *p++ = 'S';
+    *p++ = MEM_STATS_VERSION;
+    *p++ = count;
+    for (uint8_t i = 0; i < count; i++) {
+        *p++ = (uint8_t)values[i];
+        *p++ = (uint8_t)(values[i] >> 8);
+        *p++ = (uint8_t)(values[i] >> 16);
+    }
+    uart0_write(frame, sizeof(frame));
+}
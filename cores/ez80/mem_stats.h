@@ -0,0 +1,53 @@
+#ifndef __MEM_STATS_H_
+#define __MEM_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Heap and stack usage, to size _Min_Heap_Size / _Min_Stack_Size in the linker
+   script from what a sketch really needs.
+
+   startup.S fills the stack with STACK_PAINT, so the deepest point the stack
+   ever reached is found by looking for the first overwritten byte. Heap sizes
+   include the block headers of malloc(). */
+
+#define STACK_PAINT 0xA5    /* same as in startup.S */
+
+typedef struct heap_stats {
+    size_t size;                /* taken from sbrk() so far */
+    size_t limit;               /* most sbrk() can give, __heaptop - __heapbot */
+    size_t used;                /* in allocated blocks */
+    size_t peak;                /* high water mark of used */
+    size_t free_blocks;         /* blocks in the free lists */
+    size_t free_bytes;
+    size_t largest_free;        /* free_bytes much larger than this means fragmentation */
+} heap_stats_t;
+
+typedef struct mem_stats {
+    heap_stats_t heap;
+    size_t stack_size;          /* reserved for the stack by the linker script */
+    size_t stack_used;          /* at the time of the call */
+    size_t stack_peak;          /* high water mark since reset */
+} mem_stats_t;
+
+/* in clib/malloc.c, walks the free lists */
+void heap_stats(heap_stats_t *stats);
+size_t stack_high_water(void);
+void mem_stats(mem_stats_t *stats);
+
+/* Sends mem_stats() over UART0 as one frame:
+       'M' 'S' version(1) count(10) then count values of 3 bytes, little endian,
+       in the order of mem_stats_t (heap.size .. stack_peak)
+   Nothing else is sent, so it can be mixed with text output and picked out by
+   the 'M' 'S' marker. */
+void mem_stats_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __PIN_IRQ_H_
+#define __PIN_IRQ_H_
+
+#include <stdint.h>
+#include <ez80f92.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* DR bits of the pins that attachInterrupt() put into an interrupt mode.
+
+   For those pins DR selects the edge or level and writing 1 clears a latched
+   edge, but reading Px_DR returns the pin levels. A read-modify-write of the
+   port therefore has to put the configuration back, pin_irq_dr_value() does
+   that for a value read from DR:
+
+       IO(PC_DR) = pin_irq_dr_value(PORTC, IO(PC_DR)) | mask;
+
+   Updated by attachInterrupt() / detachInterrupt() with interrupts disabled,
+   read by the trampolines in wiring_interrupts_isr.S. Every writer of Px_DR
+   goes through it: interrupt handlers with pin_irq_dr_value(), the rest with
+   port_dr_update(). */
+typedef struct {
+    uint8_t mask;               /* pins in an interrupt mode */
+    uint8_t dr;                 /* their DR bits */
+} pin_irq_port_t;
+
+extern pin_irq_port_t pin_irq_port[3];
+
+static inline uint8_t pin_irq_dr_value(uint8_t port, uint8_t value)
+{
+    return (uint8_t)((value & ~pin_irq_port[port].mask) | pin_irq_port[port].dr);
+}
+
+/* DR = (DR & keep) ^ flip with interrupts disabled, the DR bits of the
+   interrupt pins stay as configured */
+void pin_irq_dr_update(uint8_t port, uint8_t keep, uint8_t flip);
+
+/* the same for any port; a plain in0/out0 read-modify-write, not guarded
+   against interrupt handlers, when the port has no interrupt pins */
+static inline void port_dr_update(uint8_t port, uint8_t keep, uint8_t flip)
+{
+    if (pin_irq_port[port].mask) {
+        pin_irq_dr_update(port, keep, flip);
+    } else {
+        /* PB_DR = 0x9A, PC_DR = 0x9E, PD_DR = 0xA2 */
+        const int dr = PB_DR + (port << 2u);
+        IO(dr) = (uint8_t)((IO(dr) & keep) ^ flip);
+    }
+}
+
+/* drops an edge latched for pin, call with interrupts disabled */
+void pin_irq_clear(uint8_t pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <ez80f92.h>
+#include "pins_api.h"
+#include "pin_irq.h"
+
+//==============================================================
+// Port-wide GPIO access
+//==============================================================
+// port is PORTB, PORTC or PORTD from pins_api.h. Bit n of the value is pin n of
+// the port, e.g. bit 3 of PORTC is PC3. The port is not range checked, these are
+// meant to be as fast as a single in0/out0 when the port is a constant. The writes
+// leave the DR bits of attachInterrupt() pins as configured, see port_dr_update().
+
+static inline uint8_t port_dr(uint8_t port) {
+    /* PB_DR = 0x9A, PC_DR = 0x9E, PD_DR = 0xA2 */
+    return PB_DR + (uint8_t)(port << 2u);
+}
+
+// writes all 8 pins of the port at once
+static inline void portWrite(uint8_t port, uint8_t value) {
+    if (pin_irq_port[port].mask) {
+        pin_irq_dr_update(port, 0, value);
+    } else {
+        IO((int)port_dr(port)) = value;
+    }
+}
+
+// writes only the pins set in mask, the other pins keep their level
+static inline void portWriteMasked(uint8_t port, uint8_t mask, uint8_t value) {
+    port_dr_update(port, (uint8_t)~mask, (uint8_t)(value & mask));
+}
+
+static inline uint8_t portRead(uint8_t port) {
+    return IO((int)port_dr(port));
+}
+
+// pinMode() for all pins of the port set in mask, supports INPUT, OUTPUT and OUTPUT_OPENDRAIN
+void portMode(uint8_t port, uint8_t mask, PinMode mode);
+
+//==============================================================
+// ParallelBus
+//==============================================================
+// Data lines are `width` neighbouring pins of one port starting at bit `shift`,
+// e.g. PORTC with shift 0 and width 8 for PC0..PC7. Every write() puts the data
+// on the port with one masked port write and then pulses the strobe pin, which
+// latches the byte into e.g. a 74HC573 or the E input of an HD44780 display.
+// If the data or strobe port has attachInterrupt() pins, every port write goes
+// through port_dr_update() instead, which is several times slower.
+//
+//     ParallelBus lcd(PORTC, PB5);
+//     lcd.begin();
+//     lcd.write(0x38);
+class ParallelBus
+{
+public:
+    ParallelBus(uint8_t data_port, pin_size_t strobe_pin, uint8_t shift = 0, uint8_t width = 8,
+                PinStatus strobe_active = HIGH);
+
+    // configures data and strobe pins as outputs, strobe inactive
+    void begin();
+    // data pins back to inputs
+    void end();
+
+    void write(uint8_t value);
+    void write(const uint8_t *buffer, size_t size);
+
+    // data pins as inputs, strobe active, samples the data pins, strobe inactive.
+    // The data pins stay inputs until the next write().
+    uint8_t read();
+
+private:
+    void drive();
+    bool shared() { return (pin_irq_port[data_port].mask | pin_irq_port[strobe_port].mask) != 0; }
+    void strobe() {
+        port_dr_update(strobe_port, 0xFF, strobe_mask);
+        port_dr_update(strobe_port, 0xFF, strobe_mask);
+    }
+
+    uint8_t data_dr;
+    uint8_t data_mask;
+    uint8_t data_shift;
+    uint8_t data_port;
+    uint8_t strobe_dr;
+    uint8_t strobe_port;
+    uint8_t strobe_mask;
+    bool strobe_high;
+    bool driving;
+};
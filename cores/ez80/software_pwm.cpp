@@ -5,6 +5,7 @@
 #include "ez80f92_peripherals.h"
 #include "vectors.h"
 #include "pins_api.h"
+#include "pin_irq.h"
 
 //==============================================================
 // Configuration
@@ -16,21 +17,54 @@
 //#define PWM_BASE_FREQ_HZ (8*2250)
 #define MAX_EVENTS       (MAX_PWM_CHANNELS + 1)
 
-#define PWM_PORT_DR      IO(PC_DR)
+// PC_DR outside the handler goes through port_dr_update(), see pin_irq.h
+#define PWM_PORT         PORTC
+
+// Use the smallest TMR1 prescaler that still gives at least one tick per PWM step.
+// The higher the timer resolution, the closer the base frequency can go to 8*2250 Hz.
+#if ((F_CPU / 4) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION)) >= 1 && ((F_CPU / 4) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION)) * 255 <= 0xFFFF
+#define PWM_CLK_DIVIDER  4
+#define PWM_CTL_CLKDIV   TMR_CTL_CLKDIV_4
+#elif ((F_CPU / 16) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION)) >= 1 && ((F_CPU / 16) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION)) * 255 <= 0xFFFF
+#define PWM_CLK_DIVIDER  16
+#define PWM_CTL_CLKDIV   TMR_CTL_CLKDIV_16
+#elif ((F_CPU / 64) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION)) * 255 <= 0xFFFF
+#define PWM_CLK_DIVIDER  64
+#define PWM_CTL_CLKDIV   TMR_CTL_CLKDIV_64
+#else
+#define PWM_CLK_DIVIDER  256
+#define PWM_CTL_CLKDIV   TMR_CTL_CLKDIV_256
+#endif
+
+// CPU cycles spent between the TMR1 end-of-count and the point where PRT1_Handler
+// has written the next reload value (interrupt acknowledge, both vector jump tables
+// and the fast path of software_pwm_isr.S), counted from the UM0077 instruction
+// timings. Only the vector table and the first jump table are read from flash
+// with its wait state, the rest runs from the internal RAM (170 cycles when all
+// of it was in flash and external SRAM).
+#define PWM_ISR_CYCLES   120
+// Two events closer together than this cannot be serviced in time, so the schedule
+// builder merges them. At 1125 Hz this is 2 steps, at 8*2250 Hz it is 30 steps.
+#define PWM_MIN_EVENT_STEPS \
+    ((PWM_ISR_CYCLES + (PWM_CLK_DIVIDER * PWM_TICKS_PER_STEP) - 1) / (PWM_CLK_DIVIDER * PWM_TICKS_PER_STEP))
+
+#define PWM_TICKS_PER_STEP ((F_CPU / PWM_CLK_DIVIDER) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION))
 
 //==============================================================
 // Timer helpers
 //==============================================================
 static inline uint16_t ticks_per_step(void) {
-    const uint32_t divider = 64;
-    return (uint16_t)((F_CPU / divider) / (PWM_BASE_FREQ_HZ * PWM_RESOLUTION));
+    return (uint16_t)PWM_TICKS_PER_STEP;
 }
 
-static inline void timer_arm_oneshot(uint16_t ticks) {
+static inline void timer_set_reload(uint16_t ticks) {
     IO(TMR1_RR_L) = (uint8_t)(ticks & 0xFF);
     IO(TMR1_RR_H) = (uint8_t)(ticks >> 8);
-    IO(TMR1_CTL) = TMR_CTL_MODE_SP | TMR_CTL_RST_EN |
-                   TMR_CTL_CLKDIV_64 |
+}
+
+static inline void timer_start_continuous(void) {
+    IO(TMR1_CTL) = TMR_CTL_MODE_CONT | TMR_CTL_RST_EN |
+                   PWM_CTL_CLKDIV |
                    TMR_CTL_IRQ_EN |
                    TMR_CTL_PRT_EN;
 }
@@ -41,71 +75,59 @@ static inline void timer_stop(void) { IO(TMR1_CTL) = 0x00; timerRunning = false;
 //==============================================================
 // Structures and globals
 //==============================================================
+
+// One entry per port transition. The ISR in software_pwm_isr.S streams these out
+// without any decoding: PC_DR = (PC_DR & and_mask) | or_mask, followed by the two
+// TMR1 reload bytes. TMR1 runs in continuous mode, so the reload register always
+// holds the length of the interval *after* the one currently being counted. That
+// is why every event carries the duration of the interval that follows the next event.
 typedef struct {
-    uint8_t set_mask;
-    uint8_t inv_clr_mask;
-    uint16_t ticks;
+    uint8_t and_mask;
+    uint8_t or_mask;
+    uint16_t next_reload;
 } pwm_event_t;
 
-static pwm_event_t schedule_a[MAX_EVENTS];
-static pwm_event_t schedule_b[MAX_EVENTS];
-static pwm_event_t *active_schedule = schedule_a;
-static pwm_event_t *build_schedule = schedule_b;
+static_assert(sizeof(pwm_event_t) == 4, "software_pwm_isr.S relies on 4 byte events");
 
-static uint8_t active_schedule_count = 0;
-static uint8_t build_schedule_count = 0;
-static uint8_t current_event = 0;
-static uint8_t pwm_duties[MAX_PWM_CHANNELS] = {0};
-static uint8_t pwm_active_mask = 0;
+// everything the ISR touches is in the internal RAM, like the ISR itself
+static FASTBSS pwm_event_t schedule_a[MAX_EVENTS];
+static FASTBSS pwm_event_t schedule_b[MAX_EVENTS];
 
+// shared with PRT1_Handler in software_pwm_isr.S
+extern "C" {
+FASTDATA pwm_event_t *pwm_active_schedule = schedule_a;
+FASTDATA pwm_event_t *pwm_build_schedule = schedule_b;
+FASTDATA pwm_event_t *pwm_next_event = schedule_a;
+FASTBSS uint8_t pwm_active_count = 0;
+FASTBSS uint8_t pwm_build_count = 0;
+FASTBSS uint8_t pwm_events_left = 0;
+FASTBSS uint16_t pwm_build_first_reload = 0;
 // Single synchronization flag: 0 = no wait needed, 1 = waiting for cycle completion
-static volatile uint8_t schedule_dirty = 0;
+FASTBSS volatile uint8_t pwm_schedule_dirty = 0;
 
-static const uint8_t channel_masks[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
-
-//==============================================================
-// ISR - Optimized
-//==============================================================
-__attribute__((interrupt))
-void PRT1_Handler(void) {
-    IO(TMR1_CTL); // Clear interrupt flag
-    
-    // Execute the current event
-    const pwm_event_t ev = active_schedule[current_event];
-    PWM_PORT_DR = (PWM_PORT_DR & ev.inv_clr_mask) | ev.set_mask;
-
-    // Schedule timer to get us to the next event or cycle using the ticks from the event we just executed
-    timer_arm_oneshot(ev.ticks);
-
-    // Move to next event
-    current_event++;
-    // Have we reached the end of a full PWM cycle? Then reset to first event
-    if (current_event >= active_schedule_count) {
-        current_event = 0;
-        // Apply new schedule if available by doing a pointer switch
-        if (schedule_dirty) {
-            pwm_event_t *temp = active_schedule;
-            active_schedule = build_schedule;
-            build_schedule = temp;
-            active_schedule_count = build_schedule_count;
-            schedule_dirty = 0;
-        }
-    }
+void PRT1_Handler(void);
 }
 
+static uint8_t pwm_duties[MAX_PWM_CHANNELS] = {0};
+static uint8_t pwm_active_mask = 0;
+
+static const uint8_t channel_masks[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
 //==============================================================
 // Event table builder
 //==============================================================
 static void rebuild_schedule(void) {
     uint8_t count = 0;
     const uint16_t step_ticks = ticks_per_step();
-    
+    const uint8_t min_steps = (uint8_t)PWM_MIN_EVENT_STEPS;
+
     // Always build into a local buffer first
     static pwm_event_t local_schedule[MAX_EVENTS];
-    
+    static uint8_t local_steps[MAX_EVENTS];
+
     if (pwm_active_mask == 0) {
-        build_schedule_count = 0;
-        schedule_dirty = 1;  // Now ISR can see it
+        pwm_build_count = 0;
+        pwm_schedule_dirty = 1;  // Now ISR can see it
         return;
     }
 
@@ -131,13 +153,15 @@ static void rebuild_schedule(void) {
     }
 
     // ---- 3) Event 0: all active channels ON at step 0 ----
-    local_schedule[count].set_mask = pwm_active_mask;
-    local_schedule[count].inv_clr_mask = (uint8_t)~0;
-    local_schedule[count].ticks = 0;
+    local_schedule[count].and_mask = (uint8_t)~0;
+    local_schedule[count].or_mask = pwm_active_mask;
+    local_steps[count] = 0;
     count++;
 
     // ---- 4) Emit events at unique duty steps ----
-    uint8_t prev_step = 0;
+    // Steps are clamped so that no event lies closer than min_steps to the cycle
+    // start or end, and groups closer than min_steps to the previous event are
+    // folded into it. The ISR could not reload TMR1 in time otherwise.
     uint8_t i = 0;
 
     while (i < n) {
@@ -150,28 +174,57 @@ static void rebuild_schedule(void) {
             i++;
         }
 
-        if (clr_mask != 0) {
-            // Set delta ticks for previous event
-            local_schedule[count - 1].ticks = (uint16_t)(duty - prev_step) * step_ticks;
+        if (duty < min_steps) duty = min_steps;
+        if (duty > 255 - min_steps) duty = 255 - min_steps;
 
+        if (count > 1 && (uint8_t)(duty - local_steps[count - 1]) < min_steps) {
+            // too close to the previous clear event, clear together with it
+            local_schedule[count - 1].and_mask &= (uint8_t)~clr_mask;
+        } else {
             // New event: clear these bits
-            local_schedule[count].set_mask = 0;
-            local_schedule[count].inv_clr_mask = (uint8_t)~clr_mask;
-            local_schedule[count].ticks = 0;
+            local_schedule[count].and_mask = (uint8_t)~clr_mask;
+            local_schedule[count].or_mask = 0;
+            local_steps[count] = duty;
             count++;
-
-            prev_step = duty;
         }
     }
 
-    // ---- 5) Final wrap-around ticks ----
-    local_schedule[count - 1].ticks = (uint16_t)(255 - prev_step) * step_ticks;
+    // ---- 5) Reload values, each event carries the interval after the next event ----
+    for (uint8_t e = 0; e < count; e++) {
+        uint8_t next = (e + 1 < count) ? e + 1 : 0;
+        uint8_t after_next = (next + 1 < count) ? next + 1 : 0;
+        uint8_t end_step = after_next ? local_steps[after_next] : 255;
+        local_schedule[e].next_reload = (uint16_t)(end_step - local_steps[next]) * step_ticks;
+    }
 
     // Atomic update: copy to build_schedule and set dirty flag
-    schedule_dirty = 0; // we are temporarily modifying the next outstanding buffer 
-    memcpy(build_schedule, local_schedule, count * sizeof(pwm_event_t));
-    build_schedule_count = count;
-    schedule_dirty = 1;  // ISR can now safely swap this in
+    pwm_schedule_dirty = 0; // we are temporarily modifying the next outstanding buffer
+    memcpy(pwm_build_schedule, local_schedule, count * sizeof(pwm_event_t));
+    pwm_build_count = count;
+    // length of the interval after event 0, loaded by the ISR when it swaps schedules
+    pwm_build_first_reload = local_schedule[count - 1].next_reload;
+    pwm_schedule_dirty = 1;  // ISR can now safely swap this in
+}
+
+// Swap in the freshly built schedule and start TMR1 at event 0.
+// Only called while the timer is stopped.
+static void start_schedule(void) {
+    pwm_event_t *temp = pwm_active_schedule;
+    pwm_active_schedule = pwm_build_schedule;
+    pwm_build_schedule = temp;
+    pwm_active_count = pwm_build_count;
+    pwm_schedule_dirty = 0;
+
+    const pwm_event_t *ev = &pwm_active_schedule[0];
+    port_dr_update(PWM_PORT, (uint8_t)(ev->and_mask & ~ev->or_mask), ev->or_mask);
+    // RST_EN loads the counter with the interval after event 0 when the timer is enabled,
+    // afterwards the reload register is primed with the interval after event 1.
+    timer_set_reload(pwm_build_first_reload);
+    pwm_next_event = &pwm_active_schedule[1];
+    pwm_events_left = pwm_active_count - 1;
+    timer_start_continuous();
+    timer_set_reload(ev->next_reload);
+    timerRunning = true;
 }
 
 //==============================================================
@@ -180,13 +233,13 @@ static void rebuild_schedule(void) {
 void pwm_init(void) {
     timer_stop();
     _set_vector(VECTOR_PRT_1, PRT1_Handler);
-    schedule_dirty = 0;
+    pwm_schedule_dirty = 0;
     __asm__("ei");
 }
 
 void pwm_write(uint8_t ch, uint8_t duty) {
     uint8_t mask = channel_masks[ch];
-    
+
     // Handle 0% duty cycle - take out of PWM control
     if (duty == 0) {
         // Remove from active mask and rebuild schedule WITHOUT this channel
@@ -194,17 +247,18 @@ void pwm_write(uint8_t ch, uint8_t duty) {
         pwm_duties[ch] = 0;
         rebuild_schedule();
         if (timerRunning)
-        while (schedule_dirty) {
+        while (pwm_schedule_dirty) {
             // Wait for current cycle to finish (ISR will clear dirty flag)
         }
+        // an empty schedule makes the ISR stop TMR1 by itself
         if(timerRunning && pwm_active_mask == 0)
             timer_stop();
         // Now safely set pin low (ISR is no longer controlling this channel)
-        PWM_PORT_DR &= ~mask;
+        port_dr_update(PWM_PORT, (uint8_t)~mask, 0);
         return;
     }
-    
-    // Handle 100% duty cycle - take out of PWM control  
+
+    // Handle 100% duty cycle - take out of PWM control
     if (duty == 255) {
         // Remove from active mask and rebuild schedule WITHOUT this channel
         pwm_active_mask &= ~mask;
@@ -212,16 +266,16 @@ void pwm_write(uint8_t ch, uint8_t duty) {
         rebuild_schedule();
         // Wait for ISR to finish current cycle with the new schedule
         if (timerRunning)
-        while (schedule_dirty) {
+        while (pwm_schedule_dirty) {
             // Wait for current cycle to finish (ISR will clear dirty flag)
         }
         if(timerRunning && pwm_active_mask == 0)
             timer_stop();
         // Now safely set pin high (ISR is no longer controlling this channel)
-        PWM_PORT_DR |= mask;
+        port_dr_update(PWM_PORT, (uint8_t)~mask, mask);
         return;
     }
-    
+
     // Normal PWM duty cycle - no need to wait for cycle completion
     pwm_duties[ch] = duty;
     // Add to active mask if not already
@@ -229,9 +283,6 @@ void pwm_write(uint8_t ch, uint8_t duty) {
     rebuild_schedule();
     // start the timer if we need it
     if (!timerRunning) {
-        PWM_PORT_DR |= pwm_active_mask;
-        current_event = 1;
-        timer_arm_oneshot(active_schedule[0].ticks);
-        timerRunning = true;
+        start_schedule();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "vectors.h"
+#include "pins_api.h"
+#include "pin_irq.h"
+
+//==============================================================
+// tone() / noTone() on TMR3
+//==============================================================
+// TMR3 runs in continuous mode with the reload value set to half a period,
+// so the pin is toggled from one small ISR per half-period and the timing
+// never depends on the ISR latency. A new frequency for the pin that is
+// already playing only rewrites the reload register, which the timer picks
+// up at the end of the running half-period.
+
+#define TONE_CTL_BASE (TMR_CTL_MODE_CONT | TMR_CTL_IRQ_EN | TMR_CTL_PRT_EN)
+
+static volatile uint8_t tone_port = 0;          // PORTB, PORTC or PORTD of the tone pin
+static volatile uint8_t tone_dr = 0;            // PB_DR, PC_DR or PD_DR of the tone pin
+static volatile uint8_t tone_mask = 0;          // bit of the tone pin
+static volatile uint32_t tone_toggles = 0;      // half-periods left if a duration was given
+static volatile bool tone_forever = false;
+static volatile uint8_t tone_pending_ctl = 0;   // prescaler change applied at the next edge
+static uint8_t tone_ctl = 0;                    // TMR3_CTL value of the running tone
+static pin_size_t tone_pin = NOT_A_PIN;
+static bool tone_vector_installed = false;
+
+extern "C" void PRT3_Handler(void);
+
+// called with interrupts disabled, the DR bits of attachInterrupt() pins are
+// put back with pin_irq_dr_value()
+static void tone_stop(void) {
+    IO(TMR3_CTL) = 0x00;
+    if (tone_pin != NOT_A_PIN) {
+        IO((int)tone_dr) = pin_irq_dr_value(tone_port, (uint8_t)(IO((int)tone_dr) & ~tone_mask));
+    }
+    tone_pin = NOT_A_PIN;
+    tone_ctl = 0;
+}
+
+__attribute__((interrupt))
+void PRT3_Handler(void) {
+    IO(TMR3_CTL); // Clear interrupt flag
+
+    IO((int)tone_dr) = pin_irq_dr_value(tone_port, (uint8_t)(IO((int)tone_dr) ^ tone_mask));
+
+    if (tone_pending_ctl) {
+        // restart from this edge with the new prescaler and reload value
+        IO(TMR3_CTL) = tone_pending_ctl;
+        tone_pending_ctl = 0;
+    }
+
+    if (!tone_forever && --tone_toggles == 0) {
+        tone_stop();
+    }
+}
+
+// Smallest prescaler for which half a period fits into the 16 bit reload register
+static uint8_t tone_prescaler(unsigned int frequency, uint16_t *reload) {
+    static const uint16_t dividers[4] = {4, 16, 64, 256};
+    static const uint8_t ctl_div[4] = {TMR_CTL_CLKDIV_4, TMR_CTL_CLKDIV_16, TMR_CTL_CLKDIV_64, TMR_CTL_CLKDIV_256};
+    uint32_t ticks = 0;
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        // rounded F_CPU / (divider * 2 * frequency)
+        ticks = ((F_CPU / dividers[i]) + frequency) / (2UL * frequency);
+        if (ticks <= 0xFFFF) break;
+    }
+    if (i == 4) {
+        // lower than the timer can go, play the lowest possible frequency
+        i = 3;
+        ticks = 0xFFFF;
+    }
+    if (ticks == 0) ticks = 1;
+    *reload = (uint16_t)ticks;
+    return ctl_div[i];
+}
+
+void tone(uint8_t _pin, unsigned int frequency, unsigned long duration) {
+    if (frequency == 0) {
+        noTone(_pin);
+        return;
+    }
+    if (GET_PORT(_pin) > PORTD) return;
+
+    uint16_t reload;
+    const uint8_t ctl = TONE_CTL_BASE | tone_prescaler(frequency, &reload);
+    // number of half-periods, 0 if the tone plays until noTone()
+    const uint32_t toggles = duration ? (2UL * frequency * duration + 500UL) / 1000UL : 0;
+
+    if (!tone_vector_installed) {
+        _set_vector(VECTOR_PRT_3, PRT3_Handler);
+        tone_vector_installed = true;
+    }
+
+    __asm("di");
+    tone_toggles = toggles ? toggles : 1;
+    tone_forever = (toggles == 0);
+    IO(TMR3_RR_L) = (uint8_t)(reload & 0xFF);
+    IO(TMR3_RR_H) = (uint8_t)(reload >> 8);
+
+    if (tone_pin == _pin) {
+        // same pin still playing: the new reload value takes effect at the end of the
+        // current half-period, only a different prescaler needs a restart at the next edge
+        if (ctl != tone_ctl) {
+            tone_pending_ctl = ctl | TMR_CTL_RST_EN;
+            tone_ctl = ctl;
+        }
+        __asm("ei");
+        return;
+    }
+
+    // a different pin takes over the timer
+    tone_stop();
+    tone_pin = _pin;
+    tone_port = GET_PORT(_pin);
+    tone_dr = (uint8_t)(PB_DR + (tone_port << 2u));
+    tone_mask = (uint8_t)(1u << GET_PIN(_pin));
+    tone_pending_ctl = 0;
+    tone_ctl = ctl;
+    __asm("ei");
+
+    digitalWrite(_pin, LOW);
+    pinMode(_pin, OUTPUT);
+
+    // Select system clock as input source for TMR3 (bits [7:6] = 00)
+    IO(TMR_ISS) &= ~0xC0;
+    IO(TMR3_CTL) = ctl | TMR_CTL_RST_EN;
+}
+
+void noTone(uint8_t _pin) {
+    __asm("di");
+    if (tone_pin == _pin) {
+        tone_stop();
+    }
+    __asm("ei");
+}
@@ -103,6 +103,16 @@ void uart0_puts(const char *s) {
         uart0_putc(*s++);
 }
 
+/* =========================================================
+ * Transmit len bytes of binary data (polling)
+ * =========================================================
+ */
+void uart0_write(const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len--)
+        uart0_putc((char)*p++);
+}
+
 void uart0_putnum(int val, int radix) {
     char buf[26] = {};  // -1113
     itoa(val, buf, radix);
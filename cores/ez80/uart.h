@@ -1,6 +1,8 @@
 #ifndef __UART_H_
 #define __UART_H_
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -8,6 +10,7 @@ extern "C" {
 void uart0_init(void);
 void uart0_putc(char c);
 void uart0_puts(const char *s);
+void uart0_write(const void *buf, size_t len);
 void uart0_putnum(int val, int radix);
 void uart0_putlnum(long val, int radix);
 
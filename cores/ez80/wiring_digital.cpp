@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <pins_api.h>
+#include <pin_irq.h>
 
 static inline uint8_t get_alt1_port(uint8_t port) {
     return PB_ALT1 + (port * 4);
@@ -94,7 +95,10 @@ void digitalWrite(pin_size_t pinNumber, PinStatus status) {
     /* meaning io_dr = 0x9A + (port * 4) */
     const uint8_t ioport_dr = PB_DR + (uint8_t)(port << 2u);
     //IO((int)ioport_dr) = (IO((int)ioport_dr) & (~pin_mask)) | (uint8_t)status;
-    if(status == LOW) {
+    if(pin_irq_port[port].mask) {
+        /* the port has interrupt pins, whose DR bits do not read back */
+        pin_irq_dr_update(port, (uint8_t)~pin_mask, status == LOW ? 0 : pin_mask);
+    } else if(status == LOW) {
         IO((int)ioport_dr) &= ~pin_mask;
     } else {
         IO((int)ioport_dr) |= pin_mask;
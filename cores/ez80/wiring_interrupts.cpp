@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "ez80f92.h"
+#include "vectors.h"
+#include "pins_api.h"
+#include "pin_irq.h"
+#include "irq.h"
+
+//==============================================================
+// attachInterrupt() for the pins of PORTB, PORTC and PORTD
+//==============================================================
+// Every pin has its own vector and its own trampoline in wiring_interrupts_isr.S,
+// which clears the interrupt and calls the callback of its table entry.
+// digitalPinToInterrupt(pin) is the pin itself.
+//
+// Modes through ALT2, ALT1, DDR and DR of the pin:
+//   RISING   1 1 1, DR = 1   edge triggered, cleared by writing 1 to DR
+//   FALLING  1 1 1, DR = 0
+//   CHANGE   1 0 0, DR = 0   dual edge triggered, cleared like the single edges
+//   LOW      1 1 0, DR = 0   level triggered, fires as long as the level is held
+//   HIGH     1 1 0, DR = 1
+//
+// The DR bits of these pins are kept in pin_irq_port (pin_irq.h), because
+// reading DR gives the pin levels and a plain read-modify-write of the port
+// would overwrite them. Writing DR always writes the bit of a RISING pin as
+// 1, which also clears an edge latched on it that was not served yet.
+
+#define NUM_IRQ_PINS        24
+
+#define PIN_IRQ_CLEAR       (1 << 0)
+#define PIN_IRQ_FALLING     (1 << 1)
+
+// 7 bytes per entry, matches PIN_IRQ_SIZE in wiring_interrupts_isr.S
+typedef struct {
+    voidFuncPtrParam callback;
+    void *param;
+    uint8_t flags;
+} pin_irq_t;
+
+static void pin_irq_nothing(void *) {}
+
+extern "C" {
+FASTBSS pin_irq_t pin_irq_table[NUM_IRQ_PINS];
+FASTBSS pin_irq_port_t pin_irq_port[3];
+
+void pin_irq_PB0(void); void pin_irq_PB1(void); void pin_irq_PB2(void); void pin_irq_PB3(void);
+void pin_irq_PB4(void); void pin_irq_PB5(void); void pin_irq_PB6(void); void pin_irq_PB7(void);
+void pin_irq_PC0(void); void pin_irq_PC1(void); void pin_irq_PC2(void); void pin_irq_PC3(void);
+void pin_irq_PC4(void); void pin_irq_PC5(void); void pin_irq_PC6(void); void pin_irq_PC7(void);
+void pin_irq_PD0(void); void pin_irq_PD1(void); void pin_irq_PD2(void); void pin_irq_PD3(void);
+void pin_irq_PD4(void); void pin_irq_PD5(void); void pin_irq_PD6(void); void pin_irq_PD7(void);
+}
+
+static void (* const pin_irq_trampolines[NUM_IRQ_PINS])(void) = {
+    pin_irq_PB0, pin_irq_PB1, pin_irq_PB2, pin_irq_PB3, pin_irq_PB4, pin_irq_PB5, pin_irq_PB6, pin_irq_PB7,
+    pin_irq_PC0, pin_irq_PC1, pin_irq_PC2, pin_irq_PC3, pin_irq_PC4, pin_irq_PC5, pin_irq_PC6, pin_irq_PC7,
+    pin_irq_PD0, pin_irq_PD1, pin_irq_PD2, pin_irq_PD3, pin_irq_PD4, pin_irq_PD5, pin_irq_PD6, pin_irq_PD7,
+};
+
+static inline void set_bit(int ioport, uint8_t mask, bool value) {
+    if (value) {
+        IO(ioport) |= mask;
+    } else {
+        IO(ioport) &= ~mask;
+    }
+}
+
+void pin_irq_clear(uint8_t pin) {
+    const uint8_t port = GET_PORT(pin);
+    const int ioport_dr = PB_DR + (port << 2u);
+    const uint8_t value = pin_irq_dr_value(port, IO(ioport_dr));
+    IO(ioport_dr) = value | (uint8_t)(1u << GET_PIN(pin));
+    IO(ioport_dr) = value;
+}
+
+void pin_irq_dr_update(uint8_t port, uint8_t keep, uint8_t flip) {
+    const int ioport_dr = PB_DR + (port << 2u);
+    const uint8_t state = irq_save();
+    IO(ioport_dr) = pin_irq_dr_value(port, (uint8_t)((IO(ioport_dr) & keep) ^ flip));
+    irq_restore(state);
+}
+
+void attachInterruptParam(pin_size_t interruptNumber, voidFuncPtrParam callback, PinStatus mode, void* param) {
+    if (interruptNumber >= NUM_IRQ_PINS || callback == nullptr) return;
+
+    bool alt1, ddr, dr;
+    uint8_t flags;
+    switch (mode) {
+        case RISING:  alt1 = true;  ddr = true;  dr = true;  flags = PIN_IRQ_CLEAR; break;
+        case FALLING: alt1 = true;  ddr = true;  dr = false; flags = PIN_IRQ_CLEAR | PIN_IRQ_FALLING; break;
+        case CHANGE:  alt1 = false; ddr = false; dr = false; flags = PIN_IRQ_CLEAR; break;
+        case LOW:     alt1 = true;  ddr = false; dr = false; flags = 0; break;
+        case HIGH:    alt1 = true;  ddr = false; dr = true;  flags = 0; break;
+        default:
+            /* unsupported */
+            return;
+    }
+
+    const uint8_t port = GET_PORT(interruptNumber);
+    const uint8_t pin_mask = (uint8_t)(1u << GET_PIN(interruptNumber));
+    /* DR, DDR, ALT1 and ALT2 are consecutive, PB_DR = 0x9A, PC_DR = 0x9E, PD_DR = 0xA2 */
+    const int ioport_dr = PB_DR + (port << 2u);
+
+    const uint8_t state = irq_save();
+    pin_irq_table[interruptNumber].callback = callback;
+    pin_irq_table[interruptNumber].param = param;
+    pin_irq_table[interruptNumber].flags = flags;
+    _set_vector(VECTOR_PB0 + 2u * interruptNumber, pin_irq_trampolines[interruptNumber]);
+
+    // plain input while the mode bits change, ALT2 last so that no
+    // intermediate combination raises an interrupt
+    IO(ioport_dr + 3) &= ~pin_mask;
+    set_bit(ioport_dr + 1, pin_mask, ddr);
+    set_bit(ioport_dr + 2, pin_mask, alt1);
+    pin_irq_port[port].mask |= pin_mask;
+    if (dr) {
+        pin_irq_port[port].dr |= pin_mask;
+    } else {
+        pin_irq_port[port].dr &= ~pin_mask;
+    }
+    IO(ioport_dr + 3) |= pin_mask;
+    if (flags & PIN_IRQ_CLEAR) {
+        // drop an edge latched while the pin was configured
+        pin_irq_clear(interruptNumber);
+    } else {
+        IO(ioport_dr) = pin_irq_dr_value(port, IO(ioport_dr));
+    }
+    irq_restore(state);
+}
+
+void attachInterrupt(pin_size_t interruptNumber, voidFuncPtr callback, PinStatus mode) {
+    // the trampoline passes param on the stack, a function without
+    // parameters ignores it and the caller removes it again
+    attachInterruptParam(interruptNumber, (voidFuncPtrParam)callback, mode, nullptr);
+}
+
+void detachInterrupt(pin_size_t interruptNumber) {
+    if (interruptNumber >= NUM_IRQ_PINS) return;
+
+    const uint8_t port = GET_PORT(interruptNumber);
+    const uint8_t pin_mask = (uint8_t)(1u << GET_PIN(interruptNumber));
+    const int ioport_dr = PB_DR + (port << 2u);
+
+    const uint8_t state = irq_save();
+    // back to INPUT as after reset
+    IO(ioport_dr + 3) &= ~pin_mask;
+    IO(ioport_dr + 2) &= ~pin_mask;
+    IO(ioport_dr + 1) |= pin_mask;
+    pin_irq_port[port].mask &= ~pin_mask;
+    pin_irq_port[port].dr &= ~pin_mask;
+    pin_irq_table[interruptNumber].callback = pin_irq_nothing;
+    pin_irq_table[interruptNumber].param = nullptr;
+    pin_irq_table[interruptNumber].flags = 0;
+    irq_restore(state);
+}
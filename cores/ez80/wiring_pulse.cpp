@@ -0,0 +1,61 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <pin_irq.h>
+#include "wiring_time.h"
+
+//==============================================================
+// pulseIn() / pulseInLong()
+//==============================================================
+// Polling the pin would make the result depend on the loop timing. Instead the
+// pin interrupt (CHANGE) timestamps every edge with the TMR0 tick count, so the
+// width is exact to one tick (~0.22 us) and the interrupt latency cancels out
+// because it is the same for both edges. The pin level is read once when the
+// interrupt is enabled; after that every edge flips it, so the edge directions
+// are known even for pulses shorter than the interrupt latency.
+//
+// The pin is left as INPUT, an interrupt attached to it before is detached.
+
+#define PULSE_EDGES 3
+
+static volatile uint8_t pulse_edge_count;
+static volatile uint32_t pulse_edge_ticks[PULSE_EDGES];
+
+static void pulse_edge(void *) {
+    const uint8_t n = pulse_edge_count;
+    if (n < PULSE_EDGES) {
+        pulse_edge_ticks[n] = timer_ticks_isr();
+        pulse_edge_count = n + 1;
+    }
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+    if (GET_PORT(pin) > PORTD) return 0;
+    const uint32_t timeout_ticks = micros_to_ticks(timeout);
+
+    pulse_edge_count = 0;
+    attachInterruptParam(pin, pulse_edge, CHANGE, nullptr);
+    __asm("di");
+    // an edge latched before the level is sampled is part of that level, drop it
+    pin_irq_clear(pin);
+    const bool level = digitalRead(pin) == HIGH;
+    const uint32_t start = timer_ticks_isr();
+    pulse_edge_count = 0;
+    __asm("ei");
+
+    // a pulse already in progress is skipped: the first edge ends it
+    const uint8_t first = (level == (state != LOW)) ? 1 : 0;
+    unsigned long width = 0;
+    while (timer_ticks() - start < timeout_ticks) {
+        if (pulse_edge_count > first + 1) {
+            width = ticks_to_micros(pulse_edge_ticks[first + 1] - pulse_edge_ticks[first]);
+            break;
+        }
+    }
+    detachInterrupt(pin);
+    return width;
+}
+
+unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout) {
+    // pulseIn() does not depend on a busy loop, so there is no separate long variant
+    return pulseIn(pin, state, timeout);
+}
@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "pins_api.h"
+#include "pin_irq.h"
+
+//==============================================================
+// shiftOut() / shiftIn()
+//==============================================================
+// The port registers and masks of both pins are computed once per call instead of
+// once per digitalWrite(), and the 8 bits are unrolled so there is no loop counter
+// or variable shift. Timing is as the AVR core: data is set up while the clock is
+// low, shiftIn() samples after the rising clock edge. When a port of the two pins
+// has attachInterrupt() pins, whose DR bits do not read back, the bits go through
+// digitalWrite() instead.
+
+#define SHIFT_OUT_BIT(m)                                                            \
+    if (val & (m)) {                                                                \
+        IO(data_dr) |= data_mask;                                                   \
+    } else {                                                                        \
+        IO(data_dr) &= ~data_mask;                                                  \
+    }                                                                               \
+    IO(clock_dr) |= clock_mask;                                                     \
+    IO(clock_dr) &= ~clock_mask;
+
+#define SHIFT_IN_BIT(m)                                                             \
+    IO(clock_dr) |= clock_mask;                                                     \
+    if (IO(data_dr) & data_mask) {                                                  \
+        val |= (m);                                                                 \
+    }                                                                               \
+    IO(clock_dr) &= ~clock_mask;
+
+void shiftOut(pin_size_t dataPin, pin_size_t clockPin, BitOrder bitOrder, uint8_t val) {
+    if (pin_irq_port[GET_PORT(dataPin)].mask | pin_irq_port[GET_PORT(clockPin)].mask) {
+        for (uint8_t i = 0; i < 8; i++) {
+            const uint8_t m = bitOrder == LSBFIRST ? (uint8_t)(0x01u << i) : (uint8_t)(0x80u >> i);
+            digitalWrite(dataPin, (val & m) ? HIGH : LOW);
+            digitalWrite(clockPin, HIGH);
+            digitalWrite(clockPin, LOW);
+        }
+        return;
+    }
+    const int data_dr = PB_DR + (GET_PORT(dataPin) << 2u);
+    const int clock_dr = PB_DR + (GET_PORT(clockPin) << 2u);
+    const uint8_t data_mask = (uint8_t)(1u << GET_PIN(dataPin));
+    const uint8_t clock_mask = (uint8_t)(1u << GET_PIN(clockPin));
+
+    if (bitOrder == LSBFIRST) {
+        SHIFT_OUT_BIT(0x01) SHIFT_OUT_BIT(0x02) SHIFT_OUT_BIT(0x04) SHIFT_OUT_BIT(0x08)
+        SHIFT_OUT_BIT(0x10) SHIFT_OUT_BIT(0x20) SHIFT_OUT_BIT(0x40) SHIFT_OUT_BIT(0x80)
+    } else {
+        SHIFT_OUT_BIT(0x80) SHIFT_OUT_BIT(0x40) SHIFT_OUT_BIT(0x20) SHIFT_OUT_BIT(0x10)
+        SHIFT_OUT_BIT(0x08) SHIFT_OUT_BIT(0x04) SHIFT_OUT_BIT(0x02) SHIFT_OUT_BIT(0x01)
+    }
+}
+
+uint8_t shiftIn(pin_size_t dataPin, pin_size_t clockPin, BitOrder bitOrder) {
+    // only the clock is written
+    if (pin_irq_port[GET_PORT(clockPin)].mask) {
+        uint8_t val = 0;
+        for (uint8_t i = 0; i < 8; i++) {
+            const uint8_t m = bitOrder == LSBFIRST ? (uint8_t)(0x01u << i) : (uint8_t)(0x80u >> i);
+            digitalWrite(clockPin, HIGH);
+            if (digitalRead(dataPin) == HIGH) val |= m;
+            digitalWrite(clockPin, LOW);
+        }
+        return val;
+    }
+    const int data_dr = PB_DR + (GET_PORT(dataPin) << 2u);
+    const int clock_dr = PB_DR + (GET_PORT(clockPin) << 2u);
+    const uint8_t data_mask = (uint8_t)(1u << GET_PIN(dataPin));
+    const uint8_t clock_mask = (uint8_t)(1u << GET_PIN(clockPin));
+    uint8_t val = 0;
+
+    if (bitOrder == LSBFIRST) {
+        SHIFT_IN_BIT(0x01) SHIFT_IN_BIT(0x02) SHIFT_IN_BIT(0x04) SHIFT_IN_BIT(0x08)
+        SHIFT_IN_BIT(0x10) SHIFT_IN_BIT(0x20) SHIFT_IN_BIT(0x40) SHIFT_IN_BIT(0x80)
+    } else {
+        SHIFT_IN_BIT(0x80) SHIFT_IN_BIT(0x40) SHIFT_IN_BIT(0x20) SHIFT_IN_BIT(0x10)
+        SHIFT_IN_BIT(0x08) SHIFT_IN_BIT(0x04) SHIFT_IN_BIT(0x02) SHIFT_IN_BIT(0x01)
+    }
+    return val;
+}
@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include "vectors.h"
+#include "wiring_time.h"
 
 #define TIMER_FREQ_HZ   1000UL       // 1 kHz (1 ms period)
 #define TIMER_RELOAD_VAL ((uint16_t)((F_CPU / 4) / TIMER_FREQ_HZ))
@@ -9,9 +10,16 @@
 // so ticks * 1000 can be at maximum 0x465000 (fits in 3 byte int)
 #define TICKS_TO_US(ticks) (((unsigned)(ticks) * (1000)) / (F_CPU / 4000))
 
-volatile unsigned int elapsed_ms = 0;  // millisecond counter
+FASTBSS volatile unsigned int elapsed_ms = 0;  // millisecond counter
 extern "C" void PRT0_Handler(void);
 
+// written to ___stack_limit (linker script) by startup.S when the stack is in
+// the internal RAM; stack_check is set by startup.S in that case only. In the
+// external SRAM the stack may grow past ___stack_limit into unused heap.
+#define STACK_CANARY 0x5AA5C3
+extern "C" volatile unsigned int __stack_limit;
+extern "C" { FASTBSS uint8_t stack_check; }
+
 void PRT0_Init(void)
 {
     // 1. Disable timer during setup
@@ -52,7 +60,7 @@ static inline uint16_t get_timer_cnt() {
 // Interrupt Service Routine for PRT0
 //==============================================================
 
-__attribute__((interrupt))
+__attribute__((interrupt)) RAMFUNC
 void PRT0_Handler(void)
 {
     // Reading TMR0_CTL clears the interrupt flag
@@ -61,11 +69,20 @@ void PRT0_Handler(void)
 
     // Increment the millisecond counter
     elapsed_ms++;
+
+    if (stack_check && __stack_limit != STACK_CANARY) stackOverflow();
     // interrupts are automatically reenabled before leaving the function
     // through EI RETI instruction
 }
  
 
+__attribute__((weak))
+void stackOverflow(void)
+{
+    __asm("di");
+    for (;;) { }
+}
+
 void init_millis(void) {
     PRT0_Init();
 }
@@ -89,6 +106,39 @@ unsigned long micros(void) {
     return ret;
 }
 
+//==============================================================
+// Tick timestamps
+//==============================================================
+// Interrupts must be disabled. If TMR0 reached its end of count but PRT0_Handler
+// did not run yet, the count has already been reloaded while elapsed_ms is one
+// millisecond behind. Reading TMR0_CTL takes the pending interrupt away, so the
+// tick is counted here instead of in the handler, and the count is read again
+// so that it belongs to the new millisecond.
+uint32_t timer_ticks_isr(void) {
+    uint16_t curr_timer = get_timer_cnt();
+    if (IO(TMR0_CTL) & TMR_CTL_PRT_IRQ) {
+        elapsed_ms++;
+        curr_timer = get_timer_cnt();
+    }
+    return (uint32_t)elapsed_ms * TIMER_RELOAD_VAL + (uint16_t)(TIMER_RELOAD_VAL - curr_timer);
+}
+
+uint32_t timer_ticks(void) {
+    __asm("di");
+    uint32_t ticks = timer_ticks_isr();
+    __asm("ei");
+    return ticks;
+}
+
+uint32_t ticks_to_micros(uint32_t ticks) {
+    // split at whole milliseconds so that ticks * 1000 does not overflow
+    return (ticks / TIMER_RELOAD_VAL) * 1000UL + ((ticks % TIMER_RELOAD_VAL) * 1000UL) / TIMER_RELOAD_VAL;
+}
+
+uint32_t micros_to_ticks(uint32_t us) {
+    return (us / 1000UL) * TIMER_RELOAD_VAL + ((us % 1000UL) * TIMER_RELOAD_VAL) / 1000UL;
+}
+
 void delay(unsigned long ms) {
     unsigned int start = elapsed_ms;
     while(elapsed_ms - start < (unsigned int)ms) {
@@ -0,0 +1,26 @@
+#ifndef __WIRING_TIME_H_
+#define __WIRING_TIME_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TMR0 counts F_CPU / 4, 4608 ticks per millisecond at 18.432 MHz (~0.22 us per tick) */
+#define TIMER_TICKS_PER_MS ((F_CPU / 4UL) / 1000UL)
+
+/* Running TMR0 tick count for timestamps. Wraps around after 2^32 ticks
+   (~15.5 minutes at 18.432 MHz), use differences of two values. */
+uint32_t timer_ticks(void);
+/* same, for interrupt handlers and other code running with interrupts disabled */
+uint32_t timer_ticks_isr(void);
+
+uint32_t ticks_to_micros(uint32_t ticks);
+uint32_t micros_to_ticks(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
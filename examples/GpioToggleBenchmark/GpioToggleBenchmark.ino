@@ -0,0 +1,96 @@
+/*
+  Time per pin write of digitalWrite() against digitalWriteFast(),
+  digitalToggleFast() and FastPin<>, measured with benchmark.h and printed on
+  UART0 in ns per write.
+
+  Every loop pass does 8 or 16 writes, the time of an empty loop is
+  subtracted.
+  digitalWriteFast() is timed with a constant pin and with one that is only
+  known at run time, which is what digitalWrite() always gets.
+
+  TOGGLE_PIN is driven as an output, a scope on it shows the toggle rate.
+*/
+
+#include <Arduino.h>
+#include <benchmark.h>
+#include <uart.h>
+
+#define TOGGLE_PIN      PB0
+#define LOOPS           2000
+
+// keeps the compiler from folding the pin into a constant
+static volatile pin_size_t runtime_pin = TOGGLE_PIN;
+static unsigned long overhead;
+
+#define EIGHT(op)       do { op; op; op; op; op; op; op; op; } while (0)
+
+static void report(const char *name, unsigned long us, unsigned int per_pass) {
+    us = us > overhead ? us - overhead : 0;
+    uart0_puts(name);
+    uart0_puts(": ");
+    uart0_putlnum((long)(us * 1000UL / ((unsigned long)LOOPS * per_pass)), 10);
+    uart0_puts(" ns per write\r\n");
+}
+
+static unsigned long timeEmpty() {
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        __asm__ volatile ("");
+    }
+    return benchmark_stop();
+}
+
+static void benchDigitalWrite() {
+    const pin_size_t pin = runtime_pin;
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        EIGHT(digitalWrite(pin, HIGH); digitalWrite(pin, LOW));
+    }
+    report("digitalWrite()", benchmark_stop(), 16);
+}
+
+static void benchWriteFastRuntime() {
+    const pin_size_t pin = runtime_pin;
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        EIGHT(digitalWriteFast(pin, HIGH); digitalWriteFast(pin, LOW));
+    }
+    report("digitalWriteFast(), runtime pin", benchmark_stop(), 16);
+}
+
+static void benchWriteFast() {
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        EIGHT(digitalWriteFast(TOGGLE_PIN, HIGH); digitalWriteFast(TOGGLE_PIN, LOW));
+    }
+    report("digitalWriteFast()", benchmark_stop(), 16);
+}
+
+static void benchToggleFast() {
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        EIGHT(digitalToggleFast(TOGGLE_PIN));
+    }
+    report("digitalToggleFast()", benchmark_stop(), 8);
+}
+
+static void benchFastPin() {
+    benchmark_start();
+    for (unsigned int i = 0; i < LOOPS; i++) {
+        EIGHT(FastPin<TOGGLE_PIN>::toggle());
+    }
+    report("FastPin<>::toggle()", benchmark_stop(), 8);
+}
+
+void setup() {
+    pinMode(TOGGLE_PIN, OUTPUT);
+    overhead = timeEmpty();
+    benchDigitalWrite();
+    benchWriteFastRuntime();
+    benchWriteFast();
+    benchToggleFast();
+    benchFastPin();
+}
+
+void loop() {
+}
@@ -0,0 +1,102 @@
+/*
+  Instruction fetch from flash, external SRAM and the internal RAM, measured
+  with benchmark.h and printed on UART0.
+
+  bench_loop (bench_loop.S) is run where it is linked, in flash, then copied to
+  a heap buffer in the external SRAM and to a FASTBSS buffer in the internal
+  RAM, where RAMFUNC code runs from. The same bytes run in all three places.
+
+  checksum() is a C function compiled twice, once plain and once as RAMFUNC,
+  both reading the same FASTBSS buffer.
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <benchmark.h>
+#include <uart.h>
+
+#define PASSES          200             // 256 rounds each
+#define ROUNDS          (PASSES * 256UL)
+#define CHECKSUM_BYTES  1024
+#define CHECKSUM_RUNS   20
+
+extern "C" unsigned int bench_loop(uint8_t passes);
+extern "C" const uint8_t bench_loop_end[];
+
+typedef unsigned int (*bench_fn)(uint8_t passes);
+
+static FASTBSS uint8_t intram_code[64];
+static FASTBSS uint8_t data[CHECKSUM_BYTES];
+
+#define CHECKSUM_BODY \
+    uint16_t sum = 0; \
+    for (size_t i = 0; i < len; i++) { \
+        sum = (uint16_t)((sum << 1 | sum >> 15) + buf[i]); \
+    } \
+    return sum;
+
+static __attribute__((noinline)) uint16_t checksum_flash(const uint8_t *buf, size_t len) {
+    CHECKSUM_BODY
+}
+
+static RAMFUNC uint16_t checksum_intram(const uint8_t *buf, size_t len) {
+    CHECKSUM_BODY
+}
+
+// prints the time and the CPU cycles per round with one decimal
+static void report(const char *name, unsigned long us, unsigned long rounds) {
+    const unsigned long tenths = us * (F_CPU / 1000UL) / 100UL / rounds;
+    uart0_puts(name);
+    uart0_puts(": ");
+    uart0_putlnum((long)us, 10);
+    uart0_puts(" us, ");
+    uart0_putlnum((long)(tenths / 10), 10);
+    uart0_puts(".");
+    uart0_putnum((int)(tenths % 10), 10);
+    uart0_puts(" cycles per round\r\n");
+}
+
+static void benchLoop(const char *name, bench_fn fn) {
+    benchmark_start();
+    fn(PASSES);
+    report(name, benchmark_stop(), ROUNDS);
+}
+
+static void benchChecksum(const char *name, uint16_t (*fn)(const uint8_t *, size_t)) {
+    benchmark_start();
+    for (int i = 0; i < CHECKSUM_RUNS; i++) {
+        fn(data, sizeof(data));
+    }
+    report(name, benchmark_stop(), (unsigned long)CHECKSUM_RUNS * CHECKSUM_BYTES);
+}
+
+void setup() {
+    const uint8_t *code = (const uint8_t *)&bench_loop;
+    const size_t size = (size_t)(bench_loop_end - code);
+    if (size > sizeof(intram_code)) {
+        uart0_puts("bench_loop too large\r\n");
+        return;
+    }
+    uint8_t *extram_code = (uint8_t *)malloc(size);
+    if (!extram_code) {
+        uart0_puts("out of memory\r\n");
+        return;
+    }
+    memcpy(extram_code, code, size);
+    memcpy(intram_code, code, size);
+
+    benchLoop("bench_loop, flash", bench_loop);
+    benchLoop("bench_loop, external SRAM", (bench_fn)(void *)extram_code);
+    benchLoop("bench_loop, internal RAM", (bench_fn)(void *)intram_code);
+    free(extram_code);
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+    benchChecksum("checksum(), flash", checksum_flash);
+    benchChecksum("checksum(), RAMFUNC", checksum_intram);
+}
+
+void loop() {
+}
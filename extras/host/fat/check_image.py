@@ -0,0 +1,123 @@
+"""Checks the consistency of a FAT16 / FAT32 image written by fat.c.
+
+    python3 check_image.py IMAGE [DIR]
+
+- the FAT copies are equal
+- no cluster is in two chains, and no chain runs into a free cluster
+- every file has as many clusters as its size needs
+- no allocated cluster is outside a chain (lost clusters)
+- the FAT32 FSInfo free count, when set, is the number of free clusters
+
+With DIR, every file in DIR (named as the path in the image with '/' replaced
+by '__', e.g. LOGS__F1.BIN) must have the same contents in the image.
+"""
+
+import os
+import struct
+import sys
+
+
+def check(path, expected_dir=None):
+    img = open(path, 'rb').read()
+    u16 = lambda o: struct.unpack_from('<H', img, o)[0]
+    u32 = lambda o: struct.unpack_from('<I', img, o)[0]
+
+    base = 0 if img[0] in (0xEB, 0xE9) else u32(446 + 8) * 512
+    spc = img[base + 13]
+    reserved = u16(base + 14)
+    nfats = img[base + 16]
+    root_entries = u16(base + 17)
+    total = u16(base + 19) or u32(base + 32)
+    fatsz = u16(base + 22) or u32(base + 36)
+    fatoff = base + reserved * 512
+    root_secs = (root_entries * 32 + 511) // 512
+    dataoff = fatoff + nfats * fatsz * 512 + root_secs * 512
+    clusters = (total - reserved - nfats * fatsz - root_secs) // spc
+    fat32 = clusters >= 65525
+    cluster_bytes = spc * 512
+
+    errors = []
+    fats = [img[fatoff + i * fatsz * 512:fatoff + (i + 1) * fatsz * 512] for i in range(nfats)]
+    if any(f != fats[0] for f in fats):
+        errors.append('FAT copies differ')
+
+    def entry(c):
+        if fat32:
+            return struct.unpack_from('<I', fats[0], c * 4)[0] & 0x0FFFFFFF
+        return struct.unpack_from('<H', fats[0], c * 2)[0]
+
+    owner = {}
+
+    def chain(c, name):
+        out = []
+        while 2 <= c <= clusters + 1:
+            if c in owner:
+                errors.append('cluster %d in %s and %s' % (c, name, owner[c]))
+                break
+            owner[c] = name
+            out.append(c)
+            c = entry(c)
+            if c == 0:
+                errors.append('free cluster in the chain of %s' % name)
+                break
+        return out
+
+    def read(ch):
+        return b''.join(img[dataoff + (c - 2) * cluster_bytes:dataoff + (c - 1) * cluster_bytes] for c in ch)
+
+    files = {}
+
+    def walk(data, prefix):
+        for i in range(0, len(data), 32):
+            e = data[i:i + 32]
+            if e[0] == 0:
+                break
+            if e[0] == 0xE5 or e[11] & 0x08:
+                continue
+            name = e[0:8].decode().rstrip()
+            ext = e[8:11].decode().rstrip()
+            if name in ('.', '..'):
+                continue
+            name = prefix + name + ('.' + ext if ext else '')
+            first = struct.unpack_from('<H', e, 26)[0]
+            if fat32:
+                first |= struct.unpack_from('<H', e, 20)[0] << 16
+            size = struct.unpack_from('<I', e, 28)[0]
+            ch = chain(first, name) if first else []
+            if e[11] & 0x10:
+                walk(read(ch), name + '__')
+            else:
+                if len(ch) != (size + cluster_bytes - 1) // cluster_bytes:
+                    errors.append('%s: %d bytes in %d clusters' % (name, size, len(ch)))
+                files[name] = read(ch)[:size]
+
+    if fat32:
+        walk(read(chain(u32(base + 44), '/')), '')
+    else:
+        walk(img[fatoff + nfats * fatsz * 512:dataoff], '')
+
+    allocated = sum(1 for c in range(2, clusters + 2) if entry(c) != 0)
+    if allocated != len(owner):
+        errors.append('%d lost clusters' % (allocated - len(owner)))
+    if fat32:
+        free_count = u32(base + u16(base + 48) * 512 + 488)
+        if free_count != 0xFFFFFFFF and free_count != clusters - allocated:
+            errors.append('FSInfo free count %d, %d clusters are free' % (free_count, clusters - allocated))
+
+    if expected_dir:
+        for name in sorted(os.listdir(expected_dir)):
+            expected = open(os.path.join(expected_dir, name), 'rb').read()
+            if name not in files:
+                errors.append('%s missing' % name)
+            elif files[name] != expected:
+                errors.append('%s differs' % name)
+
+    print('%s: %d files, %d clusters in use%s' % (path, len(files), allocated,
+                                                  ''.join('\n  ' + e for e in errors)))
+    return not errors
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    sys.exit(0 if check(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else None) else 1)
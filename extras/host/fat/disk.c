@@ -0,0 +1,41 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "disk.h"
+
+static int fd = -1;
+long disk_reads, disk_writes, disk_read_sectors, disk_written_sectors;
+
+static int disk_read(blockdev_t *dev, uint32_t lba, void *buf, size_t count)
+{
+    (void)dev;
+    disk_reads++;
+    disk_read_sectors += (long)count;
+    const ssize_t len = (ssize_t)(count * BLOCKDEV_SECTOR_SIZE);
+    return pread(fd, buf, (size_t)len, (off_t)lba * BLOCKDEV_SECTOR_SIZE) == len ? 0 : -1;
+}
+
+static int disk_write(blockdev_t *dev, uint32_t lba, const void *buf, size_t count)
+{
+    (void)dev;
+    disk_writes++;
+    disk_written_sectors += (long)count;
+    const ssize_t len = (ssize_t)(count * BLOCKDEV_SECTOR_SIZE);
+    return pwrite(fd, buf, (size_t)len, (off_t)lba * BLOCKDEV_SECTOR_SIZE) == len ? 0 : -1;
+}
+
+blockdev_t disk = { disk_read, disk_write, NULL, 0, NULL };
+
+int disk_open(const char *path)
+{
+    fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+    disk.sectors = (uint32_t)(lseek(fd, 0, SEEK_END) / BLOCKDEV_SECTOR_SIZE);
+    return 0;
+}
+
+void disk_clear_counts(void)
+{
+    disk_reads = disk_writes = disk_read_sectors = disk_written_sectors = 0;
+}
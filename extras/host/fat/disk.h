@@ -0,0 +1,12 @@
+#pragma once
+
+/* blockdev_t on a disk image file, with counters of the device calls */
+
+#include <stdint.h>
+#include "blockdev.h"
+
+extern blockdev_t disk;
+extern long disk_reads, disk_writes, disk_read_sectors, disk_written_sectors;
+
+int disk_open(const char *path);
+void disk_clear_counts(void);
@@ -0,0 +1,301 @@
+/*
+  Runs clib/fat.c on Linux against a disk image made by mkfs.py.
+
+  First a few fixed cases: directory entries, error codes, and the device
+  calls of a reserved log file and of large sequential transfers. Then a
+  randomized test writes, reads, seeks, truncates, appends to, reserves and
+  removes files and compares every read and every size with an in-memory
+  model. When DIR is given the final contents of the model files are written
+  there for check_image.py to compare with the image.
+
+    cd extras/host/fat
+    gcc -std=gnu11 -O1 -g -Wall -fsanitize=address,undefined -I../../../cores/ez80 \
+        fat_test.c disk.c ../../../cores/ez80/clib/fat.c -o fat_test
+    python3 mkfs.py fat32.img 140000 1 32
+    ./fat_test fat32.img SEED ITERATIONS [DIR]
+
+  run.sh does this for FAT16, FAT32 and a partitioned disk, with the stdio
+  test and the image check.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disk.h"
+#include "fat.h"
+
+#define FILES       6
+#define MAX_SIZE    300000L
+#define MAX_CHUNK   70000
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static unsigned seed;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+//==============================================================
+// Fixed cases
+//==============================================================
+static void testDirectory(void)
+{
+    fat_file_t f;
+    char name[32];
+
+    // more entries than one directory sector, some of them removed again
+    for (int i = 0; i < 40; i++) {
+        sprintf(name, "/LOGS/N%d.TXT", i);
+        CHECK(fat_open(&f, name, FAT_WRITE | FAT_CREATE | FAT_EXCL) == FAT_OK);
+        CHECK(fat_write(&f, name, strlen(name)) == strlen(name));
+        CHECK(fat_close(&f) == FAT_OK);
+    }
+    for (int i = 0; i < 40; i += 3) {
+        sprintf(name, "/logs/n%d.txt", i);
+        CHECK(fat_remove(name) == FAT_OK);
+    }
+    for (int i = 0; i < 40; i++) {
+        sprintf(name, "/LOGS/N%d.TXT", i);
+        const int stat = fat_open(&f, name, FAT_READ);
+        if (i % 3 == 0) {
+            CHECK(stat == FAT_ERR_NOT_FOUND);
+            continue;
+        }
+        char buf[32];
+        CHECK(stat == FAT_OK && fat_read(&f, buf, sizeof(buf)) == strlen(name) &&
+              memcmp(buf, name, strlen(name)) == 0);
+        fat_close(&f);
+    }
+
+    CHECK(fat_open(&f, "/LOGS/N1.TXT", FAT_WRITE | FAT_CREATE | FAT_EXCL) == FAT_ERR_EXISTS);
+    CHECK(fat_open(&f, "/NODIR/X.TXT", FAT_WRITE | FAT_CREATE) == FAT_ERR_NOT_FOUND);
+    CHECK(fat_open(&f, "/TOOLONGNAME.TXT", FAT_WRITE | FAT_CREATE) == FAT_ERR_NAME);
+    CHECK(fat_open(&f, "/LOGS", FAT_READ) == FAT_ERR_DENIED);
+}
+
+// a reserved log file is appended to with one device write per sector and no
+// FAT access, aligned 64 KB transfers take a few calls each
+static void testTransfers(void)
+{
+    fat_file_t f;
+    static char record[100];
+    static uint8_t big[65536];
+
+    memset(record, 'x', sizeof(record) - 1);
+    record[sizeof(record) - 1] = '\n';
+    CHECK(fat_open(&f, "/LOGS/LOG.CSV", FAT_WRITE | FAT_CREATE | FAT_APPEND) == FAT_OK);
+    CHECK(fat_reserve(&f, 1000000) == FAT_OK);
+    disk_clear_counts();
+    for (int i = 0; i < 5000; i++) {
+        CHECK(fat_write(&f, record, sizeof(record)) == sizeof(record));
+    }
+    printf("append 500 KB in 100 byte records: %ld reads, %ld writes (%ld sectors)\n",
+           disk_reads, disk_writes, disk_written_sectors);
+    CHECK(disk_reads == 0);
+    CHECK(disk_writes == disk_written_sectors && disk_written_sectors == 500000 / 512);
+    CHECK(fat_close(&f) == FAT_OK);
+
+    for (size_t i = 0; i < sizeof(big); i++) {
+        big[i] = (uint8_t)(i * 7);
+    }
+    CHECK(fat_open(&f, "/BIG.BIN", FAT_WRITE | FAT_READ | FAT_CREATE | FAT_TRUNC) == FAT_OK);
+    disk_clear_counts();
+    for (int i = 0; i < 32; i++) {
+        CHECK(fat_write(&f, big, sizeof(big)) == sizeof(big));
+    }
+    printf("write 2 MB in 64 KB calls: %ld reads, %ld writes (%ld sectors)\n",
+           disk_reads, disk_writes, disk_written_sectors);
+    CHECK(fat_close(&f) == FAT_OK);
+
+    CHECK(fat_open(&f, "/BIG.BIN", FAT_READ) == FAT_OK);
+    disk_clear_counts();
+    for (int i = 0; i < 32; i++) {
+        CHECK(fat_read(&f, big, sizeof(big)) == sizeof(big));
+        CHECK(big[1] == 7 && big[65535] == (uint8_t)(65535 * 7));
+    }
+    printf("read 2 MB in 64 KB calls: %ld reads (%ld sectors)\n", disk_reads, disk_read_sectors);
+    // every data sector once plus the FAT sectors of the chain (32 with 512
+    // byte clusters on FAT32), at most a few calls per 64 KB
+    CHECK(disk_read_sectors <= 2 * 1024 * 1024 / 512 + 40 && disk_reads <= 32 * 3);
+    CHECK(fat_close(&f) == FAT_OK);
+}
+
+//==============================================================
+// Randomized test against a model
+//==============================================================
+static uint8_t *model[FILES];
+static long model_size[FILES];             // -1: the file does not exist
+static char names[FILES][32];
+
+static int checkRead(fat_file_t *f, int i, long pos, long len)
+{
+    static uint8_t buf[MAX_CHUNK];
+    const size_t got = fat_read(f, buf, (size_t)len);
+    const long expected = pos >= model_size[i] ? 0 : (model_size[i] - pos < len ? model_size[i] - pos : len);
+    if ((long)got != expected || memcmp(buf, model[i] + pos, got) != 0) {
+        printf("%s: read of %ld at %ld returned %zu, expected %ld, error %d\n",
+               names[i], len, pos, got, expected, f->error);
+        return -1;
+    }
+    return 0;
+}
+
+static int checkWrite(fat_file_t *f, int i, long pos, long len)
+{
+    static uint8_t buf[MAX_CHUNK];
+    for (long j = 0; j < len; j++) {
+        buf[j] = (uint8_t)rnd();
+    }
+    const size_t put = fat_write(f, buf, (size_t)len);
+    if ((long)put != len) {
+        printf("%s: write of %ld at %ld returned %zu, error %d\n", names[i], len, pos, put, f->error);
+        return -1;
+    }
+    if (len == 0) return 0;
+    if (pos > model_size[i]) memset(model[i] + model_size[i], 0, (size_t)(pos - model_size[i]));
+    memcpy(model[i] + pos, buf, (size_t)len);
+    if (pos + len > model_size[i]) model_size[i] = pos + len;
+    return 0;
+}
+
+// one open / some transfers / close round on a random file
+static int randomRound(void)
+{
+    fat_file_t f;
+    const int i = (int)(rnd() % FILES);
+    const unsigned op = rnd() % 10;
+    int stat;
+
+    if (op == 0) {
+        stat = fat_remove(names[i]);
+        if ((stat == FAT_OK) != (model_size[i] >= 0)) {
+            printf("%s: remove returned %d\n", names[i], stat);
+            return -1;
+        }
+        model_size[i] = -1;
+        return 0;
+    }
+
+    uint8_t mode = FAT_READ | FAT_WRITE | FAT_CREATE;
+    if (op == 1) mode |= FAT_TRUNC;
+    const bool append = op == 2;
+    if (append) mode |= FAT_APPEND;
+    stat = fat_open(&f, names[i], mode);
+    if (stat != FAT_OK) {
+        printf("%s: open returned %d\n", names[i], stat);
+        return -1;
+    }
+    if (model_size[i] < 0 || op == 1) model_size[i] = 0;
+    if (fat_size(&f) != (uint32_t)model_size[i]) {
+        printf("%s: size %lu on open, expected %ld\n", names[i], (unsigned long)fat_size(&f), model_size[i]);
+        return -1;
+    }
+    if (rnd() % 4 == 0 && (stat = fat_reserve(&f, rnd() % MAX_SIZE)) != FAT_OK) {
+        printf("%s: reserve returned %d\n", names[i], stat);
+        return -1;
+    }
+
+    const unsigned transfers = rnd() % 8 + 1;
+    for (unsigned k = 0; k < transfers; k++) {
+        const long pos = append ? model_size[i] : (long)(rnd() % (unsigned)(model_size[i] + 2000));
+        long len = rnd() % 4 == 0 ? (long)(rnd() % MAX_CHUNK) : (long)(rnd() % 700);
+        if (pos + len > MAX_SIZE) len = MAX_SIZE - pos;
+        if (len < 0) len = 0;
+        if (!append) fat_seek(&f, (uint32_t)pos);
+        if ((rnd() & 1 ? checkWrite(&f, i, pos, len) : checkRead(&f, i, pos, len)) != 0) return -1;
+        if (fat_size(&f) != (uint32_t)model_size[i]) {
+            printf("%s: size %lu, expected %ld\n", names[i], (unsigned long)fat_size(&f), model_size[i]);
+            return -1;
+        }
+    }
+    if ((stat = fat_close(&f)) != FAT_OK) {
+        printf("%s: close returned %d\n", names[i], stat);
+        return -1;
+    }
+    return 0;
+}
+
+// reopens every file read only, compares it with the model and writes the
+// model to dir as <DIR>__<NAME> the way check_image.py names image files
+static void checkFinal(const char *dir)
+{
+    static uint8_t all[MAX_SIZE];
+    fat_file_t f;
+
+    for (int i = 0; i < FILES; i++) {
+        const int stat = fat_open(&f, names[i], FAT_READ);
+        if (model_size[i] < 0) {
+            CHECK(stat == FAT_ERR_NOT_FOUND);
+            continue;
+        }
+        CHECK(stat == FAT_OK);
+        if (stat != FAT_OK) continue;
+        const size_t got = fat_read(&f, all, sizeof(all));
+        CHECK((long)got == model_size[i] && memcmp(all, model[i], got) == 0);
+        fat_close(&f);
+
+        if (!dir) continue;
+        char path[256];
+        size_t n = (size_t)snprintf(path, sizeof(path), "%s/", dir);
+        for (const char *s = names[i] + 1; *s && n < sizeof(path) - 2; s++) {
+            if (*s == '/') {
+                path[n++] = '_';
+                path[n++] = '_';
+            } else {
+                path[n++] = (*s >= 'a' && *s <= 'z') ? (char)(*s - 'a' + 'A') : *s;
+            }
+        }
+        path[n] = 0;
+        FILE *out = fopen(path, "wb");
+        CHECK(out && fwrite(model[i], 1, (size_t)model_size[i], out) == (size_t)model_size[i]);
+        if (out) fclose(out);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4) {
+        printf("usage: %s IMAGE SEED ITERATIONS [DIR]\n", argv[0]);
+        return 2;
+    }
+    if (disk_open(argv[1]) != 0) {
+        printf("cannot open %s\n", argv[1]);
+        return 1;
+    }
+    seed = (unsigned)atoi(argv[2]);
+    const int iterations = atoi(argv[3]);
+    const char *dir = argc > 4 ? argv[4] : NULL;
+
+    int stat = fat_mount(&disk);
+    if (stat != FAT_OK) {
+        printf("mount returned %d\n", stat);
+        return 1;
+    }
+    const uint32_t free_before = fat_free();
+
+    testDirectory();
+    testTransfers();
+
+    for (int i = 0; i < FILES; i++) {
+        model[i] = calloc(MAX_SIZE, 1);
+        model_size[i] = -1;
+        sprintf(names[i], i & 1 ? "/logs/f%d.bin" : "/FILE%d.DAT", i);
+    }
+    for (int it = 0; it < iterations && !failures; it++) {
+        if (randomRound() != 0) failures++;
+    }
+    checkFinal(dir);
+
+    printf("free %lu KB, was %lu KB\n", (unsigned long)fat_free() / 1024, (unsigned long)free_before / 1024);
+    CHECK(fat_unmount() == FAT_OK);
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
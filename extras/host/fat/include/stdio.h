@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+  Host stand-in for the toolchain's stdio.h, so the clib stdio files build on
+  Linux with the same FILE layout: the console streams are the first three
+  entries of _file_streams[]. Only what the clib files and stdio_test.c use.
+*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+typedef struct {
+    unsigned char fhandle;
+    char eof;
+    char err;
+    int unget_char;
+    bool text_mode;
+} FILE;
+
+#define FOPEN_MAX   8
+#define EOF         (-1)
+#define SEEK_SET    0
+#define SEEK_CUR    1
+#define SEEK_END    2
+
+extern FILE _file_streams[FOPEN_MAX];
+#define stdin       (&_file_streams[0])
+#define stdout      (&_file_streams[1])
+#define stderr      (&_file_streams[2])
+
+int getchar(void);
+int putchar(int c);
+FILE *fopen(const char *filename, const char *mode);
+int fclose(FILE *stream);
+size_t fread(void *ptr, size_t size, size_t count, FILE *stream);
+size_t fwrite(const void *ptr, size_t size, size_t count, FILE *stream);
+int fgetc(FILE *stream);
+int fputc(int c, FILE *stream);
+int ungetc(int c, FILE *stream);
+int fseek(FILE *stream, long offset, int origin);
+long ftell(FILE *stream);
+void rewind(FILE *stream);
+int feof(FILE *stream);
+int ferror(FILE *stream);
+void clearerr(FILE *stream);
+int fflush(FILE *stream);
+int remove(const char *filename);
+unsigned int fgetsize(FILE *stream);
+
+int printf(const char *format, ...);
+int sprintf(char *s, const char *format, ...);
@@ -0,0 +1,83 @@
+"""Creates an empty FAT16 or FAT32 image for fat_test and stdio_test.
+
+    python3 mkfs.py IMAGE SECTORS SECTORS_PER_CLUSTER 16|32 [partition]
+
+The root directory holds an empty LOGS directory. With "partition" the volume
+starts at sector 2048 behind an MBR, otherwise the image is a superfloppy.
+"""
+
+import struct
+import sys
+
+
+def mkfs(path, total_sectors, spc, fat32, partition=False):
+    off = 2048 if partition else 0
+    img = bytearray((total_sectors + off) * 512)
+    reserved = 32 if fat32 else 1
+    nfats = 2
+    root_entries = 0 if fat32 else 512
+    root_secs = root_entries * 32 // 512
+
+    fatsz = 1
+    while True:
+        clusters = (total_sectors - reserved - nfats * fatsz - root_secs) // spc
+        need = ((clusters + 2) * (4 if fat32 else 2) + 511) // 512
+        if need <= fatsz:
+            break
+        fatsz = need
+
+    bs = bytearray(512)
+    bs[0:3] = b'\xEB\x58\x90'
+    bs[3:11] = b'MSWIN4.1'
+    struct.pack_into('<HBHBHHBHHHII', bs, 11, 512, spc, reserved, nfats, root_entries,
+                     0 if total_sectors >= 65536 else total_sectors, 0xF8, 0 if fat32 else fatsz,
+                     63, 255, off, total_sectors if total_sectors >= 65536 else 0)
+    if fat32:
+        struct.pack_into('<IHHIHH', bs, 36, fatsz, 0, 0, 2, 1, 6)
+        bs[66] = 0x29
+        bs[82:90] = b'FAT32   '
+    else:
+        bs[38] = 0x29
+        bs[54:62] = b'FAT16   '
+    bs[510:512] = b'\x55\xAA'
+    base = off * 512
+    img[base:base + 512] = bs
+
+    # FAT entries 0 and 1, the FAT32 root directory in cluster 2 and LOGS in 3
+    for i in range(nfats):
+        f = base + (reserved + i * fatsz) * 512
+        if fat32:
+            struct.pack_into('<IIII', img, f, 0x0FFFFFF8, 0x0FFFFFFF, 0x0FFFFFFF, 0x0FFFFFFF)
+        else:
+            struct.pack_into('<HHHH', img, f, 0xFFF8, 0xFFFF, 0, 0xFFFF)
+    if fat32:
+        fsi = bytearray(512)
+        struct.pack_into('<I', fsi, 0, 0x41615252)
+        struct.pack_into('<III', fsi, 484, 0x61417272, clusters - 2, 4)
+        fsi[510:512] = b'\x55\xAA'
+        img[base + 512:base + 1024] = fsi
+
+    dataoff = base + (reserved + nfats * fatsz + root_secs) * 512
+    logs = dataoff + (3 - 2) * spc * 512
+    img[logs:logs + 32] = b'.          ' + bytes([0x10]) + bytes(14) + struct.pack('<H', 3) + bytes(4)
+    img[logs + 32:logs + 64] = b'..         ' + bytes([0x10]) + bytes(20)
+    entry = b'LOGS       ' + bytes([0x10]) + bytes(14) + struct.pack('<H', 3) + bytes(4)
+    root = dataoff if fat32 else base + (reserved + nfats * fatsz) * 512
+    img[root:root + 32] = entry
+
+    if partition:
+        mbr = bytearray(512)
+        mbr[446 + 4] = 0x0C if fat32 else 0x06
+        struct.pack_into('<II', mbr, 446 + 8, off, total_sectors)
+        mbr[510:512] = b'\x55\xAA'
+        img[0:512] = mbr
+
+    with open(path, 'wb') as f:
+        f.write(img)
+    print('%s: %d clusters, FAT of %d sectors' % (path, clusters, fatsz))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 5:
+        sys.exit(__doc__)
+    mkfs(sys.argv[1], int(sys.argv[2]), int(sys.argv[3]), sys.argv[4] == '32', len(sys.argv) > 5)
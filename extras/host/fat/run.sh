@@ -0,0 +1,40 @@
+#!/bin/sh
+# Builds fat_test and stdio_test and runs them on a FAT16 image, a FAT32 image
+# behind an MBR and a FAT32 superfloppy, each image checked by check_image.py
+# afterwards. The images and binaries are created in the current directory.
+#
+#     sh extras/host/fat/run.sh [SEEDS] [ITERATIONS]
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+CORE=$HERE/../../../cores/ez80
+S=$CORE/clib/stdlib
+SEEDS=${1:-3}
+ITERATIONS=${2:-2000}
+CFLAGS="-std=gnu11 -O1 -g -Wall -fsanitize=address,undefined"
+
+gcc $CFLAGS -I"$CORE" "$HERE/fat_test.c" "$HERE/disk.c" "$CORE/clib/fat.c" -o fat_test
+gcc $CFLAGS -fno-builtin -I"$HERE/include" -I"$CORE" "$HERE/stdio_test.c" "$HERE/disk.c" "$CORE/clib/fat.c" \
+    "$S/files.c" "$S/fopen.c" "$S/fclose.c" "$S/fread.c" "$S/fwrite.c" "$S/fseek.c" "$S/ftell.c" \
+    "$S/fgetc.c" "$S/fputc.c" "$S/clearerr.c" "$S/rewind.c" "$S/remove.c" "$S/ungetc.c" \
+    "$S/fgetsize.c" "$S/fflush.c" "$S/feof.c" "$S/ferror.c" -o stdio_test
+
+# name, sectors, sectors per cluster, FAT type, partition
+for volume in "fat16 65000 4 16" "fat32 140000 1 32 partition" "fat32s 140000 2 32"; do
+    set -- $volume
+    name=$1
+    shift
+    seed=1
+    while [ $seed -le "$SEEDS" ]; do
+        echo "== $name, seed $seed"
+        python3 "$HERE/mkfs.py" $name.img "$@" >/dev/null
+        rm -rf expected && mkdir expected
+        ./fat_test $name.img $seed "$ITERATIONS" expected
+        python3 "$HERE/check_image.py" $name.img expected
+        seed=$((seed + 1))
+    done
+    echo "== $name, stdio"
+    python3 "$HERE/mkfs.py" $name.img "$@" >/dev/null
+    ./stdio_test $name.img
+    python3 "$HERE/check_image.py" $name.img
+done
@@ -0,0 +1,170 @@
+/*
+  Runs the clib stdio file functions on Linux on top of clib/fat.c and a disk
+  image made by mkfs.py, with include/stdio.h standing in for the toolchain's
+  stdio.h: text and binary mode, seeking past the end, append, remove, the
+  console streams in the first entries of _file_streams[] and the number of
+  files that can be open.
+
+    cd extras/host/fat
+    S=../../../cores/ez80/clib/stdlib
+    gcc -std=gnu11 -O1 -g -Wall -fno-builtin -fsanitize=address,undefined -Iinclude \
+        -I../../../cores/ez80 stdio_test.c disk.c ../../../cores/ez80/clib/fat.c \
+        $S/files.c $S/fopen.c $S/fclose.c $S/fread.c $S/fwrite.c $S/fseek.c $S/ftell.c \
+        $S/fgetc.c $S/fputc.c $S/clearerr.c $S/rewind.c $S/remove.c $S/ungetc.c \
+        $S/fgetsize.c $S/fflush.c $S/feof.c $S/ferror.c -o stdio_test
+    python3 mkfs.py fat16.img 65000 4 16
+    ./stdio_test fat16.img
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "disk.h"
+#include "fat.h"
+#include "../../../cores/ez80/clib/stdlib/fat_stream.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+// console: nothing to read, output is collected
+static char console[64];
+static size_t console_len;
+
+int getchar(void)
+{
+    return EOF;
+}
+
+int putchar(int c)
+{
+    if (console_len < sizeof(console) - 1) console[console_len++] = (char)c;
+    return c;
+}
+
+static void testText(void)
+{
+    FILE *f = fopen("/logs/text.txt", "w");
+    CHECK(f != NULL);
+    if (!f) return;
+    for (int i = 0; i < 1000; i++) {
+        fputc('a' + i % 26, f);
+        if (i % 50 == 49) fputc('\n', f);
+    }
+    // LF is written as CR LF
+    CHECK(ftell(f) == 1040);
+    CHECK(fclose(f) == 0);
+
+    f = fopen("/LOGS/TEXT.TXT", "rb");
+    CHECK(f != NULL);
+    if (!f) return;
+    char buf[2000];
+    CHECK(fread(buf, 1, sizeof(buf), f) == 1040);
+    CHECK(feof(f));
+    CHECK(buf[50] == '\r' && buf[51] == '\n');
+    CHECK(fseek(f, -3, SEEK_END) == 0);
+    CHECK(ftell(f) == 1037);
+    CHECK(fgetc(f) == 'l');
+    fclose(f);
+
+    f = fopen("/LOGS/TEXT.TXT", "r");
+    CHECK(f != NULL);
+    if (!f) return;
+    int n = 0, lines = 0, c;
+    while ((c = fgetc(f)) != EOF) {
+        n++;
+        if (c == '\n') lines++;
+        CHECK(c != '\r');
+    }
+    CHECK(n == 1020 && lines == 20);
+    fclose(f);
+
+    CHECK(fopen("/LOGS/TEXT.TXT", "wx") == NULL && errno == EEXIST);
+    CHECK(fopen("NOPE.TXT", "r") == NULL && errno == ENOENT);
+}
+
+static void testBinary(void)
+{
+    static unsigned char data[10000];
+    static unsigned char back[20001];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char)i;
+    }
+
+    FILE *f = fopen("A.BIN", "w+b");
+    CHECK(f != NULL);
+    if (!f) return;
+    CHECK(fwrite(data, 100, 100, f) == 100);
+    // the gap up to a write past the end reads as zeros
+    CHECK(fseek(f, 20000, SEEK_SET) == 0);
+    CHECK(fwrite("x", 1, 1, f) == 1);
+    rewind(f);
+    CHECK(fread(back, 1, sizeof(back), f) == sizeof(back));
+    CHECK(memcmp(back, data, sizeof(data)) == 0 && back[15000] == 0 && back[20000] == 'x');
+    CHECK(fgetsize(f) == 20001);
+    CHECK(fflush(NULL) == 0);
+    fclose(f);
+
+    f = fopen("A.BIN", "a");
+    CHECK(f != NULL && fwrite("yz", 1, 2, f) == 2);
+    if (f) fclose(f);
+    f = fopen("A.BIN", "rb");
+    CHECK(f != NULL && fseek(f, 0, SEEK_END) == 0 && ftell(f) == 20003);
+    if (f) fclose(f);
+
+    CHECK(remove("A.BIN") == 0);
+    CHECK(remove("A.BIN") == -1);
+}
+
+// stdin, stdout and stderr keep their entries, fopen() hands out the others
+static void testStreams(void)
+{
+    CHECK(stdin->fhandle == FH_STDIN && stdout->fhandle == FH_STDOUT && stderr->fhandle == FH_STDERR);
+
+    FILE *open[FOPEN_MAX];
+    char name[16];
+    int n = 0;
+    for (; n < FOPEN_MAX; n++) {
+        sprintf(name, "F%d", n);
+        if (!(open[n] = fopen(name, "w"))) break;
+        CHECK(open[n] != stdin && open[n] != stdout && open[n] != stderr);
+        CHECK(open[n]->fhandle != FH_STDIN && open[n]->fhandle != FH_STDOUT && open[n]->fhandle != FH_STDERR);
+    }
+    CHECK(n == FOPEN_MAX - _FILE_FIRST);
+    CHECK(errno == EMFILE);
+    CHECK(stdin->fhandle == FH_STDIN && stdout->fhandle == FH_STDOUT && stderr->fhandle == FH_STDERR);
+
+    // the console streams are not files
+    console_len = 0;
+    CHECK(fputc('A', stdout) == 'A' && fwrite("BC", 1, 2, stderr) == 2);
+    CHECK(console_len == 3 && memcmp(console, "ABC", 3) == 0);
+    CHECK(fgetc(stdin) == EOF);
+    CHECK(fclose(stdout) == EOF && stdout->fhandle == FH_STDOUT);
+    CHECK(fflush(NULL) == 0);
+
+    for (int i = 0; i < n; i++) {
+        CHECK(fclose(open[i]) == 0);
+    }
+    CHECK((open[0] = fopen("F0", "r")) != NULL);
+    if (open[0]) fclose(open[0]);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("usage: %s IMAGE\n", argv[0]);
+        return 2;
+    }
+    if (disk_open(argv[1]) != 0 || fat_mount(&disk) != FAT_OK) {
+        printf("cannot mount %s\n", argv[1]);
+        return 1;
+    }
+    testText();
+    testBinary();
+    testStreams();
+    CHECK(fat_unmount() == FAT_OK);
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+  Model of the allocator clib had before malloc.c (malloc.c.S, free.c.S and
+  stdlib/realloc.S, compiler output): one free list in address order, walked
+  from the start by malloc() for the first block that fits and by free() for
+  the place to insert, merging with both neighbours. A block has a {next, size}
+  header, and a larger block is split with the allocation taken from its end.
+  realloc() keeps the block when it is large enough, otherwise it allocates,
+  copies and frees.
+
+  Sizes are rounded to the host alignment, which the eZ80 does not need.
+*/
+
+#include <string.h>
+#include "first_fit.h"
+
+#define FF_HEAP_SIZE    (512 * 1024)
+
+typedef struct header {
+    struct header *next;
+    size_t size;                /* including the header */
+} header_t;
+
+static _Alignas(16) unsigned char heap[FF_HEAP_SIZE];
+static unsigned char *brk_end = heap;
+static header_t base;
+static unsigned long calls, steps;
+
+static void *ff_sbrk(size_t incr)
+{
+    if (brk_end + incr >= heap + FF_HEAP_SIZE) return NULL;
+    void *p = brk_end;
+    brk_end += incr;
+    return p;
+}
+
+void *ff_malloc(size_t n)
+{
+    const size_t need = (n + sizeof(header_t) + 7) & ~(size_t)7;
+    header_t *prev = &base, *q;
+
+    calls++;
+    for (q = base.next; q; prev = q, q = q->next) {
+        steps++;
+        if (q->size < need) continue;
+        if (q->size >= need + 2 * sizeof(header_t)) {
+            q->size -= need;
+            q = (header_t *)((unsigned char *)q + q->size);
+            q->size = need;
+        } else {
+            prev->next = q->next;
+        }
+        return q + 1;
+    }
+    q = ff_sbrk(need);
+    if (!q) return NULL;
+    q->size = need;
+    return q + 1;
+}
+
+void ff_free(void *ptr)
+{
+    if (!ptr) return;
+    header_t *b = (header_t *)ptr - 1, *prev = &base, *q;
+
+    calls++;
+    for (q = base.next; q && q < b; prev = q, q = q->next) {
+        steps++;
+    }
+    if ((unsigned char *)b + b->size == (unsigned char *)q) {
+        b->size += q->size;
+        b->next = q->next;
+    } else {
+        b->next = q;
+    }
+    if (prev != &base && (unsigned char *)prev + prev->size == (unsigned char *)b) {
+        prev->size += b->size;
+        prev->next = b->next;
+    } else {
+        prev->next = b;
+    }
+}
+
+void *ff_realloc(void *ptr, size_t n)
+{
+    if (!ptr) return ff_malloc(n);
+    const size_t have = ((header_t *)ptr - 1)->size - sizeof(header_t);
+    if (have >= n) return ptr;
+    void *q = ff_malloc(n);
+    if (!q) return NULL;
+    memcpy(q, ptr, have);
+    ff_free(ptr);
+    return q;
+}
+
+void ff_heap_stats(ff_stats_t *stats)
+{
+    stats->size = (size_t)(brk_end - heap);
+    stats->free_blocks = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    for (header_t *q = base.next; q; q = q->next) {
+        stats->free_blocks++;
+        stats->free_bytes += q->size;
+        if (q->size > stats->largest_free) stats->largest_free = q->size;
+    }
+    stats->calls = calls;
+    stats->steps = steps;
+}
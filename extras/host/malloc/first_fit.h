@@ -0,0 +1,20 @@
+#pragma once
+
+/* Model of the allocator clib had before malloc.c, for comparison. */
+
+#include <stddef.h>
+
+void *ff_malloc(size_t n);
+void ff_free(void *ptr);
+void *ff_realloc(void *ptr, size_t n);
+
+typedef struct ff_stats {
+    size_t size;                /* taken from the heap so far */
+    size_t free_blocks;
+    size_t free_bytes;
+    size_t largest_free;
+    unsigned long calls;        /* ff_malloc() and ff_free() calls */
+    unsigned long steps;        /* free list nodes visited by them */
+} ff_stats_t;
+
+void ff_heap_stats(ff_stats_t *stats);
@@ -0,0 +1,9 @@
+/* What the linker script provides on the board: the heap between __heapbot
+   and __heaptop, for clib/sbrk.c. */
+
+#define HOST_HEAP_SIZE  (512 * 1024)
+#define STR_(x)         #x
+#define STR(x)          STR_(x)
+
+_Alignas(16) char __heapbot[HOST_HEAP_SIZE];
+__asm__(".globl __heaptop\n.set __heaptop, __heapbot + " STR(HOST_HEAP_SIZE));
@@ -0,0 +1,222 @@
+/*
+  Fragmentation and speed of clib/malloc.c against first_fit.c, the model of
+  the allocator it replaced. Both run the same workload, each on its own heap,
+  one workload per run since the clib heap cannot be reset:
+
+    ./malloc_bench random SEED LIVE
+        LIVE slots, each freed or allocated at random: 70% of 1..40 bytes,
+        25% of 40..240, 5% of 256..3256, 3 million steps
+    ./malloc_bench concat INTERLEAVE
+        String::concat: 400 realloc() calls growing a buffer by a few bytes,
+        with a short lived and every 4th time a long lived allocation in
+        between every INTERLEAVE calls (0: none), four times over
+
+  For each allocator it prints the time per call, the heap taken against the
+  most bytes live at once, and the free blocks left at the end before
+  everything is freed. For first fit also the free list nodes visited per
+  call, which the new allocator bounds.
+
+  run.sh builds it (see malloc_test.c) and runs a few of each.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mem_stats.h"
+#include "first_fit.h"
+
+void *clib_malloc(size_t n);
+void clib_free(void *ptr);
+void *clib_realloc(void *ptr, size_t n);
+
+typedef struct allocator {
+    const char *name;
+    void *(*malloc)(size_t n);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t n);
+} allocator_t;
+
+static const allocator_t clib = { "malloc.c", clib_malloc, clib_free, clib_realloc };
+static const allocator_t first_fit = { "first fit", ff_malloc, ff_free, ff_realloc };
+
+typedef struct result {
+    double seconds;
+    unsigned long calls;
+    unsigned long failed;
+    size_t peak_live;
+    size_t moves;               /* concat: realloc() returned another block */
+} result_t;
+
+static unsigned seed;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+//==============================================================
+// Workloads
+//==============================================================
+#define MAX_LIVE        2000
+
+typedef struct slot {
+    unsigned char *p;
+    size_t n;
+} slot_t;
+
+static slot_t slots[MAX_LIVE];
+
+static size_t randomSize(void)
+{
+    const unsigned r = rnd() % 100;
+    if (r < 70) return 1 + rnd() % 40;
+    if (r < 95) return 40 + rnd() % 200;
+    return 256 + rnd() % 3000;
+}
+
+// leaves the blocks allocated, report() looks at the heap first
+static void runRandom(const allocator_t *a, unsigned s, int live, result_t *r)
+{
+    size_t bytes = 0;
+    seed = s;
+    memset(slots, 0, sizeof(slots));
+    const clock_t start = clock();
+    for (long it = 0; it < 3000000; it++) {
+        slot_t *slot = &slots[rnd() % (unsigned)live];
+        r->calls++;
+        if (slot->p) {
+            a->free(slot->p);
+            bytes -= slot->n;
+            slot->p = NULL;
+            continue;
+        }
+        slot->n = randomSize();
+        slot->p = a->malloc(slot->n);
+        if (!slot->p) {
+            r->failed++;
+            continue;
+        }
+        slot->p[0] = slot->p[slot->n - 1] = 1;
+        bytes += slot->n;
+        if (bytes > r->peak_live) r->peak_live = bytes;
+    }
+    r->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void freeRandom(const allocator_t *a)
+{
+    for (int i = 0; i < MAX_LIVE; i++) {
+        a->free(slots[i].p);
+    }
+}
+
+static void *kept[400];
+static int n_kept;
+
+static void runConcat(const allocator_t *a, int interleave, result_t *r)
+{
+    const clock_t start = clock();
+    n_kept = 0;
+    for (int s = 0; s < 4; s++) {
+        char *buf = NULL;
+        size_t len = 0;
+        for (int i = 0; i < 400; i++) {
+            const size_t piece = 4 + i % 9;
+            char *q = a->realloc(buf, len + piece + 1);
+            r->calls++;
+            if (!q) {
+                r->failed++;
+                break;
+            }
+            if (buf && q != buf) r->moves++;
+            buf = q;
+            memset(buf + len, 'a', piece);
+            len += piece;
+            buf[len] = 0;
+            if (interleave && i % interleave == 0) {
+                void *temporary = a->malloc(12);
+                if (n_kept < 400 && i % (interleave * 4) == 0) kept[n_kept++] = a->malloc(20);
+                a->free(temporary);
+                r->calls += 2;
+            }
+            if (len + 1 + 20 * (size_t)n_kept > r->peak_live) r->peak_live = len + 1 + 20 * (size_t)n_kept;
+        }
+        a->free(buf);
+    }
+    r->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void freeConcat(const allocator_t *a)
+{
+    for (int i = 0; i < n_kept; i++) {
+        a->free(kept[i]);
+    }
+}
+
+//==============================================================
+// Results
+//==============================================================
+static void report(const allocator_t *a, const result_t *r)
+{
+    size_t size, free_blocks, free_bytes, largest;
+    double steps = -1;
+    if (a == &clib) {
+        heap_stats_t h;
+        heap_stats(&h);
+        size = h.size;
+        free_blocks = h.free_blocks;
+        free_bytes = h.free_bytes;
+        largest = h.largest_free;
+    } else {
+        ff_stats_t h;
+        ff_heap_stats(&h);
+        size = h.size;
+        free_blocks = h.free_blocks;
+        free_bytes = h.free_bytes;
+        largest = h.largest_free;
+        steps = h.calls ? (double)h.steps / h.calls : 0;
+    }
+    printf("%-10s %6.1f ns/call  heap %6zu = %.2f x peak live  free %4zu blocks, %6zu bytes, largest %6zu",
+           a->name, r->seconds * 1e9 / (r->calls ? r->calls : 1), size,
+           (double)size / (r->peak_live ? r->peak_live : 1), free_blocks, free_bytes, largest);
+    if (r->moves) printf("  %zu moves", r->moves);
+    if (r->failed) printf("  %lu failed", r->failed);
+    if (steps >= 0) printf("  %.1f nodes/call", steps);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const allocator_t *allocators[] = { &clib, &first_fit };
+    if (argc >= 4 && strcmp(argv[1], "random") == 0) {
+        const unsigned s = (unsigned)atoi(argv[2]);
+        const int live = atoi(argv[3]);
+        if (live < 1 || live > MAX_LIVE) {
+            printf("LIVE is 1..%d\n", MAX_LIVE);
+            return 2;
+        }
+        printf("random, seed %u, %d slots\n", s, live);
+        for (int i = 0; i < 2; i++) {
+            result_t r = { 0 };
+            runRandom(allocators[i], s, live, &r);
+            report(allocators[i], &r);
+            freeRandom(allocators[i]);
+        }
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "concat") == 0) {
+        const int interleave = atoi(argv[2]);
+        printf("concat, interleave %d\n", interleave);
+        for (int i = 0; i < 2; i++) {
+            result_t r = { 0 };
+            runConcat(allocators[i], interleave, &r);
+            report(allocators[i], &r);
+            freeConcat(allocators[i]);
+        }
+        return 0;
+    }
+    printf("usage: %s random SEED LIVE | concat INTERLEAVE\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,170 @@
+/*
+  Runs clib/malloc.c and clib/sbrk.c on Linux. The functions are renamed to
+  clib_malloc / clib_free / clib_realloc so the host C library keeps its own.
+
+    cd extras/host/malloc
+    gcc -std=gnu11 -O1 -g -Wall -fsanitize=address,undefined -I../../../cores/ez80 \
+        -Dmalloc=clib_malloc -Dfree=clib_free -Drealloc=clib_realloc -Dsbrk=clib_sbrk \
+        ../../../cores/ez80/clib/malloc.c ../../../cores/ez80/clib/sbrk.c host_heap.c \
+        -r -o clib_malloc.o
+    gcc -std=gnu11 -O1 -g -Wall -fsanitize=address,undefined -I../../../cores/ez80 \
+        malloc_test.c clib_malloc.o -o malloc_test
+    ./malloc_test
+
+  run.sh builds this and malloc_bench. The heap is 512 KB and the header word
+  8 bytes instead of 3, so block sizes differ from the board, the structure
+  is the same.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem_stats.h"
+
+void *clib_malloc(size_t n);
+void clib_free(void *ptr);
+void *clib_realloc(void *ptr, size_t n);
+void *clib_sbrk(int incr);
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static unsigned seed = 1;
+
+static unsigned rnd(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+static size_t heap_size(void)
+{
+    heap_stats_t h;
+    heap_stats(&h);
+    return h.size;
+}
+
+// a free last block that is large enough, but behind smaller blocks in its
+// bin, is used without growing the heap (needs a fresh heap, runs first)
+static void testLastBlock(void)
+{
+    void *small[10], *gap[10];
+    void *big = clib_malloc(1000);
+    for (int i = 0; i < 10; i++) {
+        small[i] = clib_malloc(520);
+        gap[i] = clib_malloc(8);                    // keeps the small blocks apart
+    }
+    void *tail = clib_malloc(1000);
+    clib_free(tail);
+    for (int i = 0; i < 10; i++) {
+        clib_free(small[i]);
+    }
+    const size_t before = heap_size();
+    CHECK(clib_malloc(900) == tail);
+    CHECK(heap_size() == before);
+    clib_free(tail);
+    for (int i = 0; i < 10; i++) {
+        clib_free(gap[i]);
+    }
+    clib_free(big);
+}
+
+// realloc() resizes in place into a free neighbour or the top of the heap
+static void testRealloc(void)
+{
+    char *a = clib_malloc(100);
+    char *b = clib_malloc(100);
+    char *c = clib_malloc(100);
+    memset(a, 'a', 100);
+    clib_free(b);
+    CHECK(clib_realloc(a, 180) == a);
+    CHECK(a[0] == 'a' && a[99] == 'a');
+    CHECK(clib_realloc(a, 40) == a);
+
+    // the last block grows at the top, it is larger than any free block
+    heap_stats_t h;
+    heap_stats(&h);
+    const size_t size = h.largest_free + 64;
+    char *top = clib_malloc(size);
+    memset(top, 't', size);
+    const size_t before = heap_size();
+    CHECK(clib_realloc(top, size + 4000) == top);
+    CHECK(top[size - 1] == 't' && heap_size() > before);
+
+    clib_free(a);
+    clib_free(c);
+    clib_free(top);
+    CHECK(clib_malloc((size_t)-1 / 2) == NULL);
+}
+
+// random malloc / free / realloc with a pattern in every block, afterwards
+// the whole heap is one free block again
+static void testStress(void)
+{
+    enum { SLOTS = 300 };
+    static unsigned char *p[SLOTS];
+    static size_t n[SLOTS];
+    static unsigned char tag[SLOTS];
+
+    for (long it = 0; it < 1000000 && !failures; it++) {
+        const int i = (int)(rnd() % SLOTS);
+        for (size_t k = 0; k < n[i]; k++) {
+            if (p[i][k] != (unsigned char)(tag[i] + k)) {
+                printf("iteration %ld: block %d overwritten at %zu\n", it, i, k);
+                failures++;
+                return;
+            }
+        }
+        const unsigned op = rnd() % 3;
+        const size_t size = rnd() % 8 ? rnd() % 64 : rnd() % 2000;
+        if (op == 0) {
+            clib_free(p[i]);
+            p[i] = NULL;
+            n[i] = 0;
+        } else if (op == 1 || !p[i]) {
+            clib_free(p[i]);
+            p[i] = clib_malloc(size);
+            n[i] = p[i] ? size : 0;
+            tag[i] = (unsigned char)rnd();
+            for (size_t k = 0; k < n[i]; k++) {
+                p[i][k] = (unsigned char)(tag[i] + k);
+            }
+        } else {
+            unsigned char *q = clib_realloc(p[i], size);
+            if (!q) continue;
+            for (size_t k = n[i]; k < size; k++) {
+                q[k] = (unsigned char)(tag[i] + k);
+            }
+            p[i] = q;
+            n[i] = size;
+        }
+    }
+
+    heap_stats_t h;
+    heap_stats(&h);
+    printf("stress: heap %zu, used %zu, peak %zu, %zu free blocks of %zu bytes, largest %zu\n",
+           h.size, h.used, h.peak, h.free_blocks, h.free_bytes, h.largest_free);
+    CHECK(h.used <= h.peak && h.peak <= h.size && h.free_bytes <= h.size - h.used);
+
+    for (int i = 0; i < SLOTS; i++) {
+        clib_free(p[i]);
+    }
+    heap_stats(&h);
+    CHECK(h.used == 0);
+    CHECK(h.free_blocks == 1 && h.largest_free == h.free_bytes);
+    const size_t before = h.size;
+    CHECK(clib_malloc(h.largest_free - 64) != NULL);
+    CHECK(heap_size() == before);
+}
+
+int main(void)
+{
+    testLastBlock();
+    testRealloc();
+    testStress();
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
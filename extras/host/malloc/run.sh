@@ -0,0 +1,30 @@
+#!/bin/sh
+# Builds malloc_test (with ASan) and malloc_bench (optimised) from clib/malloc.c
+# and runs them. The binaries are created in the current directory.
+#
+#     sh extras/host/malloc/run.sh
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+CORE=$HERE/../../../cores/ez80
+RENAME="-Dmalloc=clib_malloc -Dfree=clib_free -Drealloc=clib_realloc -Dsbrk=clib_sbrk"
+
+build() {
+    flags=$1
+    out=$2
+    shift 2
+    gcc -std=gnu11 $flags -Wall -I"$CORE" $RENAME "$CORE/clib/malloc.c" "$CORE/clib/sbrk.c" \
+        "$HERE/host_heap.c" -r -o clib_malloc.o
+    gcc -std=gnu11 $flags -Wall -I"$CORE" "$@" clib_malloc.o -o "$out"
+}
+
+build "-O1 -g -fsanitize=address,undefined" malloc_test "$HERE/malloc_test.c"
+./malloc_test
+
+build "-O2" malloc_bench "$HERE/malloc_bench.c" "$HERE/first_fit.c"
+for live in 200 600 2000; do
+    ./malloc_bench random 1 $live
+done
+for interleave in 0 1 5; do
+    ./malloc_bench concat $interleave
+done
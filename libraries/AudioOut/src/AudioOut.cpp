@@ -0,0 +1,250 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "vectors.h"
+#include "pins_api.h"
+#include "pin_irq.h"
+#include "AudioOut.h"
+
+//==============================================================
+// Configuration
+//==============================================================
+// TMR4 runs from the system clock divided by 4
+#define AUDIO_TICKS_PER_SEC (F_CPU / 4UL)
+// CPU cycles from the TMR4 end-of-count until the ISR has rewritten the reload register
+#define AUDIO_ISR_CYCLES    240
+// shortest interval the ISR can service
+#define AUDIO_MIN_TICKS     ((AUDIO_ISR_CYCLES + 3) / 4)
+
+#define AUDIO_CTL (TMR_CTL_MODE_CONT | TMR_CTL_RST_EN | TMR_CTL_CLKDIV_4 | TMR_CTL_IRQ_EN | TMR_CTL_PRT_EN)
+
+//==============================================================
+// State shared with the ISR
+//==============================================================
+static DMAPool<uint8_t> *audio_pool = nullptr;
+static DMABuffer<uint8_t> *audio_current = nullptr;
+static const uint8_t *audio_ptr = nullptr;
+static size_t audio_left = 0;
+static uint8_t audio_last = AUDIO_OUT_SILENCE;
+static volatile uint32_t audio_underruns = 0;
+static volatile bool audio_playing = false;
+
+static uint8_t audio_port = 0;                  // PORTB, PORTC or PORTD of the output pin
+static uint8_t audio_dr = 0;                    // PB_DR, PC_DR or PD_DR of the output pin
+static uint8_t audio_mask = 0;                  // bit of the output pin
+static AudioOutMode audio_mode = AUDIO_OUT_PWM;
+
+// PWM: one period per sample, split into a high and a low interval
+static uint16_t pwm_period = 0;                 // sample period in ticks
+static uint16_t pwm_span = 0;                   // usable part of the period for the duty cycle
+static uint16_t pwm_low_ticks = 0;              // low interval of the sample being played
+static bool pwm_high_phase = false;
+
+// sigma-delta: one bit per interrupt, a new sample every sd_osr bits
+static uint16_t sd_bit_ticks = 0;
+static uint8_t sd_osr = 1;
+static uint8_t sd_osr_left = 0;
+static uint8_t sd_acc = 0;
+static uint8_t sd_sample = AUDIO_OUT_SILENCE;
+
+extern "C" void PRT4_Handler(void);
+
+static inline void timer_set_reload(uint16_t ticks) {
+    IO(TMR4_RR_L) = (uint8_t)(ticks & 0xFF);
+    IO(TMR4_RR_H) = (uint8_t)(ticks >> 8);
+}
+
+// called with interrupts disabled, the DR bits of attachInterrupt() pins are
+// put back with pin_irq_dr_value()
+static inline void audio_pin_high(void) {
+    IO((int)audio_dr) = pin_irq_dr_value(audio_port, (uint8_t)(IO((int)audio_dr) | audio_mask));
+}
+
+static inline void audio_pin_low(void) {
+    IO((int)audio_dr) = pin_irq_dr_value(audio_port, (uint8_t)(IO((int)audio_dr) & ~audio_mask));
+}
+
+// Next sample from the playing buffer. A finished buffer goes back to the free queue
+// and the next written one is taken from the ready queue. Without one the last
+// sample is held, which avoids a click, and an underrun is counted.
+static inline uint8_t audio_next_sample(void) {
+    if (audio_left == 0) {
+        if (audio_current) {
+            audio_current->release();
+        }
+        audio_current = audio_pool->alloc(arduino::DMA_BUFFER_READ);
+        if (!audio_current) {
+            audio_underruns++;
+            return audio_last;
+        }
+        audio_ptr = audio_current->data();
+        audio_left = audio_current->size();
+        if (audio_left == 0) {
+            return audio_last;
+        }
+    }
+    audio_left--;
+    audio_last = *audio_ptr++;
+    return audio_last;
+}
+
+// high interval of a sample, clamped so that both intervals stay serviceable
+static inline uint16_t pwm_high_ticks(uint8_t sample) {
+    return (uint16_t)(AUDIO_MIN_TICKS + (((unsigned int)sample * pwm_span) >> 8));
+}
+
+//==============================================================
+// ISR
+//==============================================================
+__attribute__((interrupt))
+void PRT4_Handler(void) {
+    IO(TMR4_CTL); // Clear interrupt flag
+
+    if (audio_mode == AUDIO_OUT_SIGMA_DELTA) {
+        // first-order sigma-delta: the carry of the accumulator is the output bit
+        uint16_t sum = (uint16_t)sd_acc + sd_sample;
+        sd_acc = (uint8_t)sum;
+        if (sum & 0x100) {
+            audio_pin_high();
+        } else {
+            audio_pin_low();
+        }
+        if (--sd_osr_left == 0) {
+            sd_osr_left = sd_osr;
+            sd_sample = audio_next_sample();
+        }
+        return;
+    }
+
+    // PWM: TMR4 is in continuous mode, the reload register holds the next interval
+    pwm_high_phase = !pwm_high_phase;
+    if (pwm_high_phase) {
+        audio_pin_high();
+        timer_set_reload(pwm_low_ticks);
+    } else {
+        audio_pin_low();
+        uint16_t high = pwm_high_ticks(audio_next_sample());
+        timer_set_reload(high);
+        pwm_low_ticks = pwm_period - high;
+    }
+}
+
+//==============================================================
+// Playback control
+//==============================================================
+static void audio_timer_start(void) {
+    __asm("di");
+    if (audio_mode == AUDIO_OUT_SIGMA_DELTA) {
+        sd_osr_left = sd_osr;
+        sd_sample = audio_next_sample();
+        timer_set_reload(sd_bit_ticks);
+        IO(TMR4_CTL) = AUDIO_CTL;
+    } else {
+        // start with the high interval of the first sample
+        uint16_t high = pwm_high_ticks(audio_next_sample());
+        pwm_low_ticks = pwm_period - high;
+        pwm_high_phase = true;
+        timer_set_reload(high);
+        IO(TMR4_CTL) = AUDIO_CTL;
+        audio_pin_high();
+        timer_set_reload(pwm_low_ticks);
+    }
+    audio_playing = true;
+    __asm("ei");
+}
+
+static void audio_timer_stop(void) {
+    IO(TMR4_CTL) = 0x00;
+    audio_playing = false;
+}
+
+bool AudioOut::begin(pin_size_t pin, uint32_t sample_rate, size_t n_samples, size_t n_buffers,
+                     AudioOutMode mode, uint8_t oversampling) {
+    end();
+    if (GET_PORT(pin) > PORTD) return false;
+    if (sample_rate < AUDIO_OUT_MIN_RATE || sample_rate > AUDIO_OUT_MAX_RATE) return false;
+    if (n_samples == 0 || n_buffers == 0) return false;
+
+    if (mode == AUDIO_OUT_SIGMA_DELTA) {
+        if (oversampling == 0) return false;
+        uint32_t ticks = AUDIO_TICKS_PER_SEC / (sample_rate * oversampling);
+        if (ticks < AUDIO_MIN_TICKS) return false;
+        sd_bit_ticks = (uint16_t)ticks;
+        sd_osr = oversampling;
+        sd_acc = 0;
+    } else {
+        pwm_period = (uint16_t)(AUDIO_TICKS_PER_SEC / sample_rate);
+        if (pwm_period <= 2 * AUDIO_MIN_TICKS) return false;
+        pwm_span = pwm_period - 2 * AUDIO_MIN_TICKS;
+    }
+
+    pool = new DMAPool<uint8_t>(n_samples, 1, n_buffers);
+    if (!pool || !pool->writable()) {
+        delete pool;
+        pool = nullptr;
+        return false;
+    }
+
+    audio_pool = pool;
+    audio_current = nullptr;
+    audio_left = 0;
+    audio_last = AUDIO_OUT_SILENCE;
+    audio_underruns = 0;
+    audio_mode = mode;
+    audio_port = GET_PORT(pin);
+    audio_dr = (uint8_t)(PB_DR + (audio_port << 2u));
+    audio_mask = (uint8_t)(1u << GET_PIN(pin));
+
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+
+    IO(TMR4_CTL) = 0x00;
+    _set_vector(VECTOR_PRT_4, PRT4_Handler);
+    return true;
+}
+
+void AudioOut::end() {
+    if (!pool) return;
+    audio_timer_stop();
+    port_dr_update(audio_port, (uint8_t)~audio_mask, 0);
+    if (audio_current) {
+        audio_current->release();
+        audio_current = nullptr;
+    }
+    delete pool;
+    pool = nullptr;
+    audio_pool = nullptr;
+}
+
+bool AudioOut::available() {
+    return pool && pool->writable();
+}
+
+SampleBuffer AudioOut::dequeue() {
+    while (!pool->writable()) {
+        // wait for the ISR to return a played buffer
+    }
+    return *pool->alloc(arduino::DMA_BUFFER_WRITE);
+}
+
+void AudioOut::write(SampleBuffer buf) {
+    // buffers allocated for writing go to the ready queue
+    buf.release();
+    if (!audio_playing) {
+        audio_timer_start();
+    }
+}
+
+uint32_t AudioOut::underruns() {
+    __asm("di");
+    uint32_t count = audio_underruns;
+    __asm("ei");
+    return count;
+}
+
+void AudioOut::clearUnderruns() {
+    __asm("di");
+    audio_underruns = 0;
+    __asm("ei");
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "api/DMAPool.h"
+
+/*
+  8-bit PCM playback on a GPIO pin of PORTB, PORTC or PORTD.
+
+  The application dequeues a free buffer, fills it with unsigned 8-bit samples
+  and writes it back, while the TMR4 interrupt plays the previously written
+  buffers. Playback starts with the first written buffer. When the interrupt
+  finds no written buffer it holds the last sample and counts an underrun.
+
+      AudioOut audio;
+      audio.begin(PC0, 8000);
+      ...
+      if (audio.available()) {
+          SampleBuffer buf = audio.dequeue();
+          for (size_t i = 0; i < buf.size(); i++) buf[i] = next_sample();
+          audio.write(buf);
+      }
+
+  AUDIO_OUT_PWM needs two interrupts per sample. Its resolution is the sample
+  period in TMR4 ticks minus the interrupt overhead: ~8 bit at 8 kHz, less at
+  higher rates. AUDIO_OUT_SIGMA_DELTA outputs a first-order sigma-delta
+  bitstream at sample_rate * oversampling with one interrupt per bit. The pin
+  then needs an RC low-pass filter.
+*/
+
+enum AudioOutMode {
+    AUDIO_OUT_PWM = 0,
+    AUDIO_OUT_SIGMA_DELTA = 1,
+};
+
+#define AUDIO_OUT_MIN_RATE      4000UL
+#define AUDIO_OUT_MAX_RATE     32000UL
+#define AUDIO_OUT_SILENCE       0x80
+
+typedef DMABuffer<uint8_t> &SampleBuffer;
+
+class AudioOut
+{
+public:
+    AudioOut() : pool(nullptr) {}
+    ~AudioOut() { end(); }
+
+    // only one AudioOut can be active at a time, it owns TMR4
+    bool begin(pin_size_t pin, uint32_t sample_rate, size_t n_samples = 256, size_t n_buffers = 4,
+               AudioOutMode mode = AUDIO_OUT_PWM, uint8_t oversampling = 4);
+    void end();
+
+    // true if a free buffer can be dequeued without blocking
+    bool available();
+    // returns the next free buffer, waits for one if all are queued for playback
+    SampleBuffer dequeue();
+    // queues a filled buffer for playback, starts playback if it is stopped
+    void write(SampleBuffer buf);
+
+    // number of samples the interrupt had to repeat because no buffer was queued
+    uint32_t underruns();
+    void clearUnderruns();
+
+private:
+    DMAPool<uint8_t> *pool;
+};
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <pin_irq.h>
+#include "EdgeCapture.h"
+
+#define EDGE_CAPTURE_MASK (EDGE_CAPTURE_SIZE - 1)
+
+static_assert((EDGE_CAPTURE_SIZE & EDGE_CAPTURE_MASK) == 0, "EDGE_CAPTURE_SIZE must be a power of two");
+
+void EdgeCapture::isr(void *self) {
+    EdgeCapture *cap = (EdgeCapture *)self;
+    const uint32_t ticks = timer_ticks_isr();
+    if (cap->toggle) {
+        cap->level = !cap->level;
+    }
+    const uint8_t h = cap->head;
+    const uint8_t next = (h + 1) & EDGE_CAPTURE_MASK;
+    if (next == cap->tail) {
+        cap->overflows++;
+        return;
+    }
+    cap->buffer[h].ticks = ticks;
+    cap->buffer[h].level = cap->level ? HIGH : LOW;
+    cap->head = next;
+}
+
+bool EdgeCapture::begin(pin_size_t pin, PinStatus mode) {
+    end();
+    if (GET_PORT(pin) > PORTD) return false;
+    if (mode != CHANGE && mode != RISING && mode != FALLING) return false;
+
+    this->pin = pin;
+    toggle = (mode == CHANGE);
+    level = (mode == RISING);
+    head = 0;
+    tail = 0;
+    overflows = 0;
+    attachInterruptParam(pin, isr, mode, this);
+    if (toggle) {
+        __asm("di");
+        // an edge latched before the level is sampled is part of that level, drop it
+        pin_irq_clear(pin);
+        level = digitalRead(pin) == HIGH;
+        head = 0;
+        __asm("ei");
+    }
+    return true;
+}
+
+void EdgeCapture::end() {
+    if (pin == NOT_A_PIN) return;
+    detachInterrupt(pin);
+    pin = NOT_A_PIN;
+}
+
+uint8_t EdgeCapture::available() {
+    return (uint8_t)((head - tail) & EDGE_CAPTURE_MASK);
+}
+
+bool EdgeCapture::read(CapturedEdge &edge) {
+    const uint8_t t = tail;
+    if (t == head) return false;
+    // the interrupt never writes the slot at tail, it is full until tail moves on.
+    // The barrier keeps the compiler from loading it before head was checked.
+    __asm volatile("" ::: "memory");
+    edge = buffer[t];
+    tail = (t + 1) & EDGE_CAPTURE_MASK;
+    return true;
+}
+
+void EdgeCapture::clear() {
+    tail = head;
+}
+
+uint16_t EdgeCapture::overruns() {
+    __asm("di");
+    uint16_t count = overflows;
+    __asm("ei");
+    return count;
+}
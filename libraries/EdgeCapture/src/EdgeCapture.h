@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <wiring_time.h>
+
+/*
+  Background edge timestamps for a GPIO pin of PORTB, PORTC or PORTD.
+
+  The pin interrupt stores the TMR0 tick count (TIMER_TICKS_PER_MS per ms,
+  ~0.22 us at 18.432 MHz) and the new level of every edge in a ring buffer,
+  loop() reads them whenever it has time.
+
+      EdgeCapture echo;
+      echo.begin(PC4);                    // CHANGE
+      ...
+      CapturedEdge rise, fall;
+      if (echo.available() >= 2 && echo.read(rise) && echo.read(fall)) {
+          uint32_t us = EdgeCapture::ticksToMicros(fall.ticks - rise.ticks);
+      }
+
+  In CHANGE mode the level is read once in begin() and flipped on every edge,
+  so it stays correct for pulses shorter than the interrupt latency.
+*/
+
+#define EDGE_CAPTURE_SIZE 32                  // power of two
+
+struct CapturedEdge {
+    uint32_t ticks;
+    PinStatus level;                          // level after the edge
+};
+
+class EdgeCapture
+{
+public:
+    EdgeCapture() : pin(NOT_A_PIN), head(0), tail(0), overflows(0) {}
+    ~EdgeCapture() { end(); }
+
+    // mode is CHANGE, RISING or FALLING. Takes over the pin interrupt of the pin.
+    bool begin(pin_size_t pin, PinStatus mode = CHANGE);
+    void end();
+
+    // number of edges waiting to be read
+    uint8_t available();
+    // oldest edge, false if there is none
+    bool read(CapturedEdge &edge);
+    // drops all waiting edges
+    void clear();
+
+    // edges dropped because the buffer was full
+    uint16_t overruns();
+
+    static uint32_t ticksToMicros(uint32_t ticks) { return ticks_to_micros(ticks); }
+
+private:
+    static void isr(void *self);
+
+    pin_size_t pin;
+    bool toggle;                              // CHANGE: level flips with every edge
+    volatile bool level;
+    volatile uint8_t head;                    // written by the interrupt
+    volatile uint8_t tail;                    // written by read()
+    volatile uint16_t overflows;
+    CapturedEdge buffer[EDGE_CAPTURE_SIZE];
+};
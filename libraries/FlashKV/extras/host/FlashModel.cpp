@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FlashModel.h"
+
+#define STR_(x)         #x
+#define STR(x)          STR_(x)
+
+alignas(FLASH_PAGE_SIZE) uint8_t flash_model[FLASH_MODEL_PAGES * FLASH_PAGE_SIZE];
+__asm__(".globl __flash_image_end\n.set __flash_image_end, flash_model\n"
+        ".globl __flash_end\n.set __flash_end, flash_model + " STR(FLASH_MODEL_PAGES) " * " STR(FLASH_PAGE_SIZE));
+
+jmp_buf flash_reset;
+unsigned long flash_erases[FLASH_MODEL_PAGES];
+static long budget = -1;
+
+void flash_reset_after(long ops)
+{
+    budget = ops;
+}
+
+void flash_model_garbage()
+{
+    for (size_t i = 0; i < sizeof(flash_model); i++) {
+        flash_model[i] = (uint8_t)(i * 13 + 0x5A);
+    }
+}
+
+static void tick()
+{
+    if (budget >= 0 && budget-- == 0) {
+        budget = -1;
+        longjmp(flash_reset, 1);
+    }
+}
+
+static size_t offset(const void *addr, size_t len)
+{
+    size_t off = (const uint8_t *)addr - flash_model;
+    if ((const uint8_t *)addr < flash_model || off + len > sizeof(flash_model)) {
+        printf("flash access outside the model at %p\n", addr);
+        abort();
+    }
+    return off;
+}
+
+extern "C" int flash_erase_page(const void *addr)
+{
+    size_t page = offset(addr, 1) / FLASH_PAGE_SIZE;
+    flash_erases[page]++;
+    for (size_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+        tick();
+        flash_model[page * FLASH_PAGE_SIZE + i] = 0xFF;
+    }
+    return FLASH_OK;
+}
+
+extern "C" int flash_program(const void *dst, const void *src, size_t len)
+{
+    size_t off = offset(dst, len);
+    // src may be in the flash itself
+    uint8_t data[FLASH_PAGE_SIZE];
+    if (len > sizeof(data)) return FLASH_ERR_RANGE;
+    memcpy(data, src, len);
+    for (size_t i = 0; i < len; i++) {
+        tick();
+        flash_model[off + i] &= data[i];
+    }
+    return memcmp(flash_model + off, data, len) ? FLASH_ERR_VERIFY : FLASH_OK;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <flash.h>
+
+/*
+  The internal flash for running FlashKV on the host: flash_erase_page() and
+  flash_program() on a RAM array of FLASH_MODEL_PAGES pages, with the same
+  rules as the chip. Programming only clears bits and a page is erased to
+  0xFF as a whole.
+
+  The last FLASH_MODEL_PAGES pages of the array are what begin() without an
+  address picks, __flash_image_end is its start.
+
+  A reset can be set up to happen after a number of byte operations, one per
+  byte programmed or erased: the model then stops in the middle of the
+  operation and longjmp()s to flash_reset, leaving the bytes done so far.
+*/
+
+#define FLASH_MODEL_PAGES   8
+
+extern "C" uint8_t flash_model[FLASH_MODEL_PAGES * FLASH_PAGE_SIZE];
+extern jmp_buf flash_reset;
+extern unsigned long flash_erases[FLASH_MODEL_PAGES];
+
+// a reset after that many byte operations, -1 for none
+void flash_reset_after(long ops);
+// fills the array with a pattern that is neither erased nor a valid page
+void flash_model_garbage();
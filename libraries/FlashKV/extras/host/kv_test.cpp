@@ -0,0 +1,257 @@
+/*
+  Runs FlashKV on Linux against FlashModel: the API, wear levelling, resets
+  in the middle of a page header and resets at random points of a random
+  sequence of put(), remove() and get(), checked against a std::map.
+
+    cd libraries/FlashKV/extras/host
+    g++ -std=gnu++17 -O2 -I. -I../../src -I../../../../cores/ez80 \
+        kv_test.cpp FlashModel.cpp ../../src/FlashKV.cpp -o kv_test
+    ./kv_test [SEED]
+
+  After a reset the store must hold either the old or the new value of the
+  key that was being written, and everything else unchanged.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include "FlashKV.h"
+#include "FlashModel.h"
+
+#define KEYS            24
+// bytes of a record in the log
+#define RECORD(key, len) (4 + strlen(key) + (len))
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+typedef std::map<std::string, std::string> Model;
+
+static bool matches(FlashKV &kv, const Model &model)
+{
+    if (kv.count() != model.size()) return false;
+    for (const auto &e : model) {
+        size_t len;
+        const void *value = kv.find(e.first.c_str(), &len);
+        if (!value || len != e.second.size() || memcmp(value, e.second.data(), len) != 0) return false;
+    }
+    return true;
+}
+
+static unsigned long erases()
+{
+    unsigned long n = 0;
+    for (unsigned long e : flash_erases) n += e;
+    return n;
+}
+
+static void testApi()
+{
+    flash_model_garbage();
+    FlashKV kv;
+    // the top FLASHKV_PAGES pages, formatted since nothing there is valid
+    CHECK(kv.begin());
+    CHECK(kv.count() == 0 && kv.used() == 0);
+    CHECK(kv.capacity() > 0);
+
+    uint32_t boots = 0;
+    CHECK(!kv.get("boots", boots));
+    CHECK(kv.put("boots", boots + 1));
+    CHECK(kv.get("boots", boots) && boots == 1);
+    CHECK(kv.put("name", "eZ80", 4));
+    char buf[8] = { 0 };
+    CHECK(kv.get("name", buf, sizeof(buf)) == 4 && memcmp(buf, "eZ80", 4) == 0);
+    CHECK(kv.get("name", buf, 2) == 4);
+    size_t len;
+    CHECK(kv.find("name", &len) && len == 4);
+    CHECK(kv.put("empty", nullptr, 0) && kv.contains("empty"));
+    CHECK(kv.count() == 3);
+
+    // limits
+    char value[FLASHKV_MAX_VALUE + 1] = { 0 };
+    CHECK(!kv.put("", value, 1));
+    CHECK(!kv.put("0123456789abcdef", value, 1));
+    CHECK(kv.put("0123456789abcde", value, FLASHKV_MAX_VALUE));
+    CHECK(!kv.put("big", value, FLASHKV_MAX_VALUE + 1));
+    CHECK(kv.remove("0123456789abcde") && !kv.remove("0123456789abcde"));
+
+    // an unchanged value is not written again
+    size_t used = kv.used();
+    const void *rec = kv.find("boots");
+    CHECK(kv.put("boots", boots));
+    CHECK(kv.find("boots") == rec && kv.used() == used);
+
+    // a reboot rebuilds the index
+    kv.end();
+    CHECK(kv.begin());
+    CHECK(kv.count() == 3);
+    CHECK(kv.get("boots", boots) && boots == 1);
+    CHECK(kv.remove("empty") && !kv.contains("empty"));
+    CHECK(kv.clear() && kv.count() == 0);
+}
+
+// a value written over and over wears all pages the same
+static void testWear()
+{
+    FlashKV kv;
+    CHECK(kv.begin(flash_model, 4));
+    CHECK(kv.clear());
+    memset(flash_erases, 0, sizeof(flash_erases));
+    for (uint32_t i = 0; i < 20000; i++) {
+        CHECK(kv.put("counter", i));
+    }
+    unsigned long lo = flash_erases[0], hi = flash_erases[0];
+    for (uint8_t page = 0; page < 4; page++) {
+        lo = flash_erases[page] < lo ? flash_erases[page] : lo;
+        hi = flash_erases[page] > hi ? flash_erases[page] : hi;
+    }
+    CHECK(lo > 0 && hi - lo <= 1);
+    uint32_t counter;
+    kv.end();
+    CHECK(kv.begin(flash_model, 4) && kv.get("counter", counter) && counter == 19999);
+}
+
+// a reset while the log moves onto the next page leaves a header that is
+// partly programmed; the store must not take it for the head, or one with a
+// wrong seq, and must keep working over many more page changes
+static void testTornHeader()
+{
+    static uint8_t before[2 * FLASH_PAGE_SIZE];
+    std::string value(200, 'v');
+    Model model = { { "a", "1" }, { "b", "22" }, { "c", "333" } };
+
+    FlashKV kv;
+    CHECK(kv.begin(flash_model, 2, KEYS));
+    CHECK(kv.clear());
+    for (const auto &e : model) {
+        CHECK(kv.put(e.first.c_str(), e.second.data(), e.second.size()));
+    }
+    // the state just before a put() that moves the log to the other page
+    for (uint8_t i = 0;; i++) {
+        memcpy(before, flash_model, sizeof(before));
+        const unsigned long e = erases();
+        value[0] = (char)i;
+        CHECK(kv.put("v", value.data(), value.size()));
+        if (erases() != e) break;
+    }
+    kv.end();
+
+    // the header is the first thing programmed, 16 bytes cover it
+    static long cut;
+    for (cut = 0; cut < 16; cut++) {
+        memcpy(flash_model, before, sizeof(before));
+        Model now = model;
+        CHECK(kv.begin(flash_model, 2, KEYS));
+        if (kv.find("v")) now["v"] = std::string((const char *)kv.find("v"), value.size());
+        Model next = now;
+        next["v"] = value;
+        if (!setjmp(flash_reset)) {
+            flash_reset_after(cut);
+            kv.put("v", value.data(), value.size());
+            flash_reset_after(-1);
+        }
+        kv.end();
+        CHECK(kv.begin(flash_model, 2, KEYS));
+        CHECK(matches(kv, now) || matches(kv, next));
+
+        // 300 page changes, with a reboot after each
+        now = next;
+        for (unsigned long moves = 0; moves < 300 && !failures;) {
+            const unsigned long e = erases();
+            now["v"][1] = (char)(now["v"][1] + 1);
+            CHECK(kv.put("v", now["v"].data(), value.size()));
+            if (erases() != e) {
+                moves++;
+                kv.end();
+                CHECK(kv.begin(flash_model, 2, KEYS));
+                CHECK(matches(kv, now));
+            }
+        }
+        kv.end();
+    }
+}
+
+// random operations on random keys, a reset at a random byte now and then
+static void testResets(unsigned seed)
+{
+    srand(seed);
+    flash_model_garbage();
+    FlashKV kv;
+    Model model;
+    CHECK(kv.begin(flash_model, 4, KEYS));
+    static unsigned long resets;
+    static int i;
+    for (i = 0; i < 50000 && !failures; i++) {
+        char key[FLASHKV_MAX_NAME + 1];
+        const int k = rand() % 30;
+        snprintf(key, sizeof(key), k % 3 ? "key%d" : "key%d_long_name", k);
+        const int op = rand() % 10;
+        std::string value;
+        const int len = rand() % 4 == 0 ? rand() % (FLASHKV_MAX_VALUE + 1) : rand() % 12;
+        for (int j = 0; j < len; j++) {
+            value += (char)(rand() % 4 ? 'a' + rand() % 26 : 0xFF);
+        }
+
+        Model next = model;
+        if (op < 2) {
+            next.erase(key);
+        } else if (op < 8) {
+            next[key] = value;
+        }
+        if (setjmp(flash_reset)) {
+            resets++;
+            kv.end();
+            CHECK(kv.begin(flash_model, 4, KEYS));
+            if (matches(kv, next)) {
+                model = next;
+            } else {
+                CHECK(matches(kv, model));
+            }
+            continue;
+        }
+        // mostly inside the record, now and then in a page change
+        if (rand() % 20 == 0) flash_reset_after(rand() % (rand() % 4 ? 300 : 5000));
+
+        if (op < 2) {
+            CHECK(kv.remove(key) == (model.count(key) > 0));
+            model = next;
+        } else if (op < 8) {
+            if (kv.put(key, value.data(), value.size())) {
+                model = next;
+            } else {
+                // only when the store is full
+                const size_t old = model.count(key) ? RECORD(key, model[key].size()) : 0;
+                CHECK((!model.count(key) && model.size() == KEYS) ||
+                      kv.used() - old + RECORD(key, value.size()) > kv.capacity());
+            }
+        } else {
+            char buf[FLASHKV_MAX_VALUE];
+            const int n = kv.get(key, buf, sizeof(buf));
+            CHECK(model.count(key) ? n == (int)model[key].size() && memcmp(buf, model[key].data(), n) == 0 : n == -1);
+        }
+        flash_reset_after(-1);
+
+        if (rand() % 500 == 0) {
+            kv.end();
+            CHECK(kv.begin(flash_model, 4, KEYS));
+        }
+        if (i % 1000 == 0) CHECK(matches(kv, model));
+    }
+    CHECK(matches(kv, model));
+    printf("seed %u: %lu resets, %lu erases\n", seed, resets, erases());
+}
+
+int main(int argc, char **argv)
+{
+    testApi();
+    testWear();
+    testTornHeader();
+    testResets(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,423 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FlashKV.h"
+
+/*
+  Page layout: 12 byte header { uint32 magic, uint32 seq, uint32 ~seq }, then
+  records
+    name_len (1..FLASHKV_MAX_NAME, 0xFF = end of page)
+    crc8 over all other bytes of the record
+    uint16 size, little endian (0xFFFF = key removed, no value)
+    name, value
+  The header of a page is written when the log moves onto it, seq counts up,
+  so the page with the highest seq is the head. seq and its complement are
+  programmed before the magic, so a header cut short by a reset, or left over
+  from an interrupted erase, has no magic or a seq that does not match.
+*/
+
+#define KV_MAGIC        0x32564B46UL        // "FKV2"
+#define KV_HEADER       12
+#define KV_REC_HEADER   4
+#define KV_TOMBSTONE    0xFFFF
+#define KV_REC_MAX      (KV_REC_HEADER + FLASHKV_MAX_NAME + FLASHKV_MAX_VALUE)
+#define KV_PAGE_DATA    (FLASH_PAGE_SIZE - KV_HEADER)
+
+static uint8_t crc8(uint8_t crc, const uint8_t *p, size_t len)
+{
+    while (len--) {
+        crc ^= *p++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static size_t rec_value_len(const uint8_t *rec)
+{
+    size_t size = rec[2] | (rec[3] << 8);
+    return size == KV_TOMBSTONE ? 0 : size;
+}
+
+static size_t rec_len(const uint8_t *rec)
+{
+    return KV_REC_HEADER + rec[0] + rec_value_len(rec);
+}
+
+static uint8_t rec_crc(const uint8_t *hdr, const void *name, const void *value, size_t vlen)
+{
+    uint8_t crc = crc8(0, hdr, 1);
+    crc = crc8(crc, hdr + 2, 2);
+    crc = crc8(crc, (const uint8_t *)name, hdr[0]);
+    return crc8(crc, (const uint8_t *)value, vlen);
+}
+
+// length of a complete record at p, 0 at the end of the page or a torn record
+static size_t rec_check(const uint8_t *p, size_t room)
+{
+    if (room < KV_REC_HEADER) return 0;
+    uint8_t nl = p[0];
+    if (nl == 0 || nl > FLASHKV_MAX_NAME) return 0;
+    size_t size = p[2] | (p[3] << 8);
+    size_t vlen = size == KV_TOMBSTONE ? 0 : size;
+    if (vlen > FLASHKV_MAX_VALUE || KV_REC_HEADER + nl + vlen > room) return 0;
+    if (rec_crc(p, p + KV_REC_HEADER, p + KV_REC_HEADER + nl, vlen) != p[1]) return 0;
+    return KV_REC_HEADER + nl + vlen;
+}
+
+static size_t hash(const char *key, size_t nl)
+{
+    size_t h = 0;
+    while (nl--) h = h * 31 + (uint8_t)*key++;
+    return h;
+}
+
+FlashKV::FlashKV() : base(nullptr), table(nullptr), mask(0), seq(0), head_pos(0), live(0),
+                     n_keys(0), max_keys(0), n_pages(0), head(0) {
+}
+
+//==============================================================
+// Index
+//==============================================================
+
+// slot of key, or the free slot where it would go
+bool FlashKV::lookup(const char *key, size_t nl, size_t *slot)
+{
+    size_t i = hash(key, nl) & mask;
+    while (table[i]) {
+        const uint8_t *rec = table[i];
+        if (rec[0] == nl && memcmp(rec + KV_REC_HEADER, key, nl) == 0) {
+            *slot = i;
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    *slot = i;
+    return false;
+}
+
+// backward shift, keeps every probe sequence unbroken
+void FlashKV::unlink(size_t slot)
+{
+    size_t i = slot;
+    size_t j = slot;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!table[j]) break;
+        size_t k = hash((const char *)table[j] + KV_REC_HEADER, table[j][0]) & mask;
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i] = nullptr;
+}
+
+// adds a record found by scan() to the index
+bool FlashKV::apply(const uint8_t *rec)
+{
+    size_t slot;
+    bool found = lookup((const char *)rec + KV_REC_HEADER, rec[0], &slot);
+    if (found) live -= rec_len(table[slot]);
+
+    if ((rec[2] | (rec[3] << 8)) == KV_TOMBSTONE) {
+        if (found) {
+            unlink(slot);
+            n_keys--;
+        }
+        return true;
+    }
+    if (!found) {
+        if (n_keys == max_keys) return false;
+        n_keys++;
+    }
+    table[slot] = rec;
+    live += rec_len(rec);
+    return true;
+}
+
+//==============================================================
+// Pages
+//==============================================================
+
+bool FlashKV::page_erased(uint8_t page, size_t from)
+{
+    const uint8_t *p = page_addr(page);
+    for (size_t i = from; i < FLASH_PAGE_SIZE; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool write_header(const uint8_t *page, uint32_t seq)
+{
+    uint32_t check[2] = { seq, ~seq };
+    uint32_t magic = KV_MAGIC;
+    return flash_program(page + 4, check, sizeof(check)) == FLASH_OK &&
+           flash_program(page, &magic, sizeof(magic)) == FLASH_OK;
+}
+
+static bool header_valid(const uint8_t *page, uint32_t *seq)
+{
+    uint32_t hdr[3];
+    memcpy(hdr, page, KV_HEADER);
+    *seq = hdr[1];
+    return hdr[0] == KV_MAGIC && hdr[2] == ~hdr[1];
+}
+
+bool FlashKV::format()
+{
+    for (uint8_t i = 0; i < n_pages; i++) {
+        if (!page_erased(i) && flash_erase_page(page_addr(i)) != FLASH_OK) return false;
+    }
+    for (size_t i = 0; i <= mask; i++) table[i] = nullptr;
+    n_keys = 0;
+    live = 0;
+    head = 0;
+    seq = 1;
+    head_pos = KV_HEADER;
+    return write_header(page_addr(0), seq);
+}
+
+// indexes the records of a page; the head page also sets head_pos
+bool FlashKV::scan(uint8_t page, bool is_head)
+{
+    const uint8_t *p = page_addr(page);
+    size_t pos = KV_HEADER;
+    size_t n;
+    while ((n = rec_check(p + pos, FLASH_PAGE_SIZE - pos)) != 0) {
+        if (!apply(p + pos)) return false;
+        pos += n;
+    }
+    if (is_head) {
+        // a torn record or body without header: continue on the next page
+        head_pos = page_erased(page, pos) ? pos : FLASH_PAGE_SIZE;
+    }
+    return true;
+}
+
+bool FlashKV::begin(uint8_t pages, uint16_t keys)
+{
+    uintptr_t first = ((uintptr_t)__flash_image_end + FLASH_PAGE_SIZE - 1) & ~(uintptr_t)(FLASH_PAGE_SIZE - 1);
+    uintptr_t start = (uintptr_t)__flash_end - (size_t)pages * FLASH_PAGE_SIZE;
+    if (start < first || start > (uintptr_t)__flash_end) return false;
+    return begin((const void *)start, pages, keys);
+}
+
+bool FlashKV::begin(const void *addr, uint8_t pages, uint16_t keys)
+{
+    end();
+    if (pages < 2 || keys == 0 || ((uintptr_t)addr & (FLASH_PAGE_SIZE - 1))) return false;
+
+    size_t slots = 4;
+    while (slots < 2 * (size_t)keys) slots <<= 1;
+    table = (const uint8_t **)calloc(slots, sizeof(*table));
+    if (!table) return false;
+    mask = slots - 1;
+    base = (const uint8_t *)addr;
+    n_pages = pages;
+    max_keys = keys;
+
+    // drop pages that are neither valid nor cleanly erased
+    uint8_t valid = 0;
+    for (uint8_t i = 0; i < n_pages; i++) {
+        uint32_t s;
+        if (header_valid(page_addr(i), &s)) {
+            valid++;
+        } else if (!page_erased(i) && flash_erase_page(page_addr(i)) != FLASH_OK) {
+            end();
+            return false;
+        }
+    }
+    if (!valid) {
+        if (format()) return true;
+        end();
+        return false;
+    }
+
+    // replay the pages oldest first
+    uint32_t last = 0;
+    for (uint8_t n = 0; n < valid; n++) {
+        uint8_t next = 0;
+        uint32_t next_seq = 0xFFFFFFFFUL;
+        for (uint8_t i = 0; i < n_pages; i++) {
+            uint32_t s;
+            if (header_valid(page_addr(i), &s) && s > last && s < next_seq) {
+                next = i;
+                next_seq = s;
+            }
+        }
+        last = next_seq;
+        if (!scan(next, n == valid - 1)) {
+            end();
+            return false;
+        }
+        head = next;
+        seq = next_seq;
+    }
+
+    // finish a garbage collection cut short by a reset or a failed write
+    uint8_t after = (head + 1) % n_pages;
+    if (page_erased(after)) return true;
+    if (head_pos < FLASH_PAGE_SIZE && collect(after) && flash_erase_page(page_addr(after)) == FLASH_OK) return true;
+    // the head only holds copies of records on the page after it, start over without it
+    uint8_t failed = head;
+    end();
+    if (flash_erase_page((const uint8_t *)addr + (size_t)failed * FLASH_PAGE_SIZE) != FLASH_OK) return false;
+    return begin(addr, pages, keys);
+}
+
+void FlashKV::end()
+{
+    free(table);
+    table = nullptr;
+    base = nullptr;
+    n_keys = 0;
+    live = 0;
+}
+
+bool FlashKV::clear()
+{
+    return base && format();
+}
+
+size_t FlashKV::capacity()
+{
+    // leaves room for the worst case tail of every page, so advance() always makes progress
+    return base ? (size_t)(n_pages - 1) * (KV_PAGE_DATA - KV_REC_MAX) : 0;
+}
+
+//==============================================================
+// Log
+//==============================================================
+
+bool FlashKV::append(const uint8_t *hdr, const void *name, const void *value, size_t vlen, const uint8_t **rec)
+{
+    size_t len = KV_REC_HEADER + hdr[0] + vlen;
+    if (head_pos + len > FLASH_PAGE_SIZE) return false;
+
+    const uint8_t *dst = page_addr(head) + head_pos;
+    head_pos = FLASH_PAGE_SIZE;             // unusable unless all writes succeed
+    if (flash_program(dst + KV_REC_HEADER, name, hdr[0]) != FLASH_OK) return false;
+    if (vlen && flash_program(dst + KV_REC_HEADER + hdr[0], value, vlen) != FLASH_OK) return false;
+    if (flash_program(dst, hdr, KV_REC_HEADER) != FLASH_OK) return false;
+    head_pos = (dst - page_addr(head)) + len;
+    *rec = dst;
+    return true;
+}
+
+// copies the live records of page to the head
+bool FlashKV::collect(uint8_t page)
+{
+    const uint8_t *p = page_addr(page);
+    size_t pos = KV_HEADER;
+    size_t n;
+    while ((n = rec_check(p + pos, FLASH_PAGE_SIZE - pos)) != 0) {
+        const uint8_t *rec = p + pos;
+        size_t slot;
+        if (lookup((const char *)rec + KV_REC_HEADER, rec[0], &slot) && table[slot] == rec) {
+            const uint8_t *copy;
+            if (!append(rec, rec + KV_REC_HEADER, rec + KV_REC_HEADER + rec[0], rec_value_len(rec), &copy)) return false;
+            table[slot] = copy;
+        }
+        pos += n;
+    }
+    return true;
+}
+
+// moves the head to the next page and frees the page after it
+bool FlashKV::advance()
+{
+    uint8_t next = (head + 1) % n_pages;
+    uint32_t s;
+    // live data when an earlier advance() failed, begin() sorts that out
+    if (header_valid(page_addr(next), &s)) return false;
+    if (!page_erased(next) && flash_erase_page(page_addr(next)) != FLASH_OK) return false;
+    if (!write_header(page_addr(next), seq + 1)) return false;
+    head = next;
+    seq++;
+    head_pos = KV_HEADER;
+
+    uint8_t after = (next + 1) % n_pages;
+    if (page_erased(after)) return true;
+    if (collect(after) && flash_erase_page(page_addr(after)) == FLASH_OK) return true;
+    // no user records on a head page before the page after it is erased
+    head_pos = FLASH_PAGE_SIZE;
+    return false;
+}
+
+bool FlashKV::write(const char *key, const void *value, size_t len, bool tombstone)
+{
+    if (!base || !key) return false;
+    size_t nl = strlen(key);
+    if (nl == 0 || nl > FLASHKV_MAX_NAME || len > FLASHKV_MAX_VALUE) return false;
+
+    size_t slot;
+    bool found = lookup(key, nl, &slot);
+    size_t old = found ? rec_len(table[slot]) : 0;
+    if (tombstone) {
+        if (!found) return false;
+        len = 0;
+    } else {
+        if (found && rec_value_len(table[slot]) == len &&
+            (len == 0 || memcmp(table[slot] + KV_REC_HEADER + nl, value, len) == 0)) return true;
+        if (!found && n_keys == max_keys) return false;
+        if (live - old + KV_REC_HEADER + nl + len > capacity()) return false;
+    }
+
+    uint16_t size = tombstone ? KV_TOMBSTONE : len;
+    uint8_t hdr[KV_REC_HEADER] = { (uint8_t)nl, 0, (uint8_t)size, (uint8_t)(size >> 8) };
+    hdr[1] = rec_crc(hdr, key, value, len);
+
+    const uint8_t *rec;
+    for (uint8_t tries = 0; !append(hdr, key, value, len, &rec); tries++) {
+        // advance() may move the record in table[slot], but not the slot
+        if (tries >= 2 * n_pages || !advance()) return false;
+    }
+
+    live -= old;
+    if (tombstone) {
+        unlink(slot);
+        n_keys--;
+    } else {
+        if (!found) n_keys++;
+        table[slot] = rec;
+        live += rec_len(rec);
+    }
+    return true;
+}
+
+//==============================================================
+// API
+//==============================================================
+
+bool FlashKV::put(const char *key, const void *value, size_t len)
+{
+    return write(key, value, len, false);
+}
+
+bool FlashKV::remove(const char *key)
+{
+    return write(key, nullptr, 0, true);
+}
+
+const void *FlashKV::find(const char *key, size_t *len)
+{
+    if (!base || !key) return nullptr;
+    size_t nl = strlen(key);
+    size_t slot;
+    if (nl == 0 || nl > FLASHKV_MAX_NAME || !lookup(key, nl, &slot)) return nullptr;
+    if (len) *len = rec_value_len(table[slot]);
+    return table[slot] + KV_REC_HEADER + nl;
+}
+
+int FlashKV::get(const char *key, void *buf, size_t len)
+{
+    size_t size;
+    const void *value = find(key, &size);
+    if (!value) return -1;
+    memcpy(buf, value, len < size ? len : size);
+    return size;
+}
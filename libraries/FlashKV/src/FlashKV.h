@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <flash.h>
+
+/*
+  Key-value store in the internal flash, e.g. for settings and calibration.
+
+  The store is a log over a few flash pages: every put() or remove() appends a
+  record at the head, so a value that is changed often is spread over all pages
+  instead of wearing out one. When the head page is full the log moves on to
+  the next page, and the live records of the oldest page are copied over before
+  that page is erased. One page is always kept erased for this.
+
+  An index in RAM (a hash table of record addresses, rebuilt by begin()) makes
+  lookups O(1); find() returns the value in place since the flash is memory
+  mapped. A record is programmed body first and its header last, and a record
+  or page that was cut short by a reset is dropped at the next begin(), so the
+  store keeps either the old or the new value.
+
+      FlashKV kv;
+      kv.begin();                       // top 4 pages of the flash
+      uint32_t boots = 0;
+      kv.get("boots", boots);
+      kv.put("boots", boots + 1);
+
+  Keys are strings of 1..FLASHKV_MAX_NAME characters, values are up to
+  FLASHKV_MAX_VALUE bytes.
+
+  extras/host runs the store on Linux against a model of the flash, with
+  resets at every point of a page change and at random points of a write.
+*/
+
+#define FLASHKV_PAGES       4
+#define FLASHKV_KEYS        32
+#define FLASHKV_MAX_NAME    15
+#define FLASHKV_MAX_VALUE   256
+
+class FlashKV
+{
+public:
+    FlashKV();
+    ~FlashKV() { end(); }
+
+    // uses the last pages of the flash, which must not overlap the program
+    bool begin(uint8_t pages = FLASHKV_PAGES, uint16_t max_keys = FLASHKV_KEYS);
+    // base must be FLASH_PAGE_SIZE aligned, at least 2 pages
+    bool begin(const void *base, uint8_t pages, uint16_t max_keys = FLASHKV_KEYS);
+    void end();
+
+    bool put(const char *key, const void *value, size_t len);
+    template <typename T> bool put(const char *key, const T &value) { return put(key, &value, sizeof(T)); }
+    // copies up to len bytes of the value, returns its size or -1 if the key does not exist
+    int get(const char *key, void *buf, size_t len);
+    // true only if the stored size matches
+    template <typename T> bool get(const char *key, T &value) { return get(key, &value, sizeof(T)) == (int)sizeof(T); }
+    // the value in flash, valid until the next put() or remove(); NULL if the key does not exist
+    const void *find(const char *key, size_t *len = nullptr);
+    bool contains(const char *key) { return find(key) != nullptr; }
+    bool remove(const char *key);
+    // erases all pages
+    bool clear();
+
+    uint16_t count() { return n_keys; }
+    // bytes of live records, and the most that can be stored
+    size_t used() { return live; }
+    size_t capacity();
+
+private:
+    const uint8_t *page_addr(uint8_t page) { return base + (size_t)page * FLASH_PAGE_SIZE; }
+    bool page_erased(uint8_t page, size_t from = 0);
+    bool format();
+    bool scan(uint8_t page, bool head);
+    bool apply(const uint8_t *rec);
+    bool advance();
+    bool collect(uint8_t page);
+    bool append(const uint8_t *hdr, const void *name, const void *value, size_t vlen, const uint8_t **rec);
+    bool write(const char *key, const void *value, size_t len, bool tombstone);
+
+    bool lookup(const char *key, size_t nl, size_t *slot);
+    void unlink(size_t slot);
+
+    const uint8_t *base;
+    const uint8_t **table;      // record per key, open addressing
+    size_t mask;
+    uint32_t seq;               // sequence number of the head page
+    size_t head_pos;
+    size_t live;
+    uint16_t n_keys;
+    uint16_t max_keys;
+    uint8_t n_pages;
+    uint8_t head;
+};
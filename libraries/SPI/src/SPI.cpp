@@ -0,0 +1,246 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "vectors.h"
+#include "irq.h"
+#include "SPI.h"
+
+EZ80SPI SPI;
+
+#define SPI_BRG_MIN     2               // smallest divider in master mode
+#define SPI_CTL_BASE    (SPI_CTL_SPI_EN | SPI_CTL_MASTER_EN)
+
+#define SPI_WAIT()      while (!(IO(SPI_SR) & SPI_SR_SPIF)) {}
+
+static inline uint8_t reverse_bits(uint8_t b) {
+    b = (uint8_t)((b >> 4) | (b << 4));
+    b = (uint8_t)(((b & 0xCC) >> 2) | ((b & 0x33) << 2));
+    b = (uint8_t)(((b & 0xAA) >> 1) | ((b & 0x55) << 1));
+    return b;
+}
+
+//==============================================================
+// Asynchronous transfer, state shared with the ISR
+//==============================================================
+static const uint8_t *spi_tx = nullptr;
+static uint8_t *spi_rx = nullptr;
+static size_t spi_left = 0;                     // bytes still to be sent after the running one
+static bool spi_async_lsb = false;
+static volatile bool spi_busy = false;
+static SPICallback spi_callback = nullptr;
+static void *spi_callback_param = nullptr;
+static uint8_t spi_ctl = SPI_CTL_BASE;          // SPI_CTL without IRQ_EN
+
+extern "C" void SPI_Handler(void);
+
+static inline uint8_t spi_next_tx(void) {
+    uint8_t b = 0xFF;
+    if (spi_tx) {
+        b = *spi_tx++;
+        if (spi_async_lsb) b = reverse_bits(b);
+    }
+    return b;
+}
+
+__attribute__((interrupt))
+void SPI_Handler(void) {
+    IO(SPI_SR); // Clear interrupt flag
+    if (spi_left) {
+        spi_left--;
+        // start the next byte first, SPI_RBR keeps the previous one until it is done
+        IO(SPI_TSR) = spi_next_tx();
+        const uint8_t rx = IO(SPI_RBR);
+        if (spi_rx) *spi_rx++ = spi_async_lsb ? reverse_bits(rx) : rx;
+        return;
+    }
+    const uint8_t rx = IO(SPI_RBR);
+    if (spi_rx) *spi_rx = spi_async_lsb ? reverse_bits(rx) : rx;
+    IO(SPI_CTL) = spi_ctl;
+    spi_busy = false;
+    if (spi_callback) spi_callback(spi_callback_param);
+}
+
+//==============================================================
+// EZ80SPI
+//==============================================================
+EZ80SPI::EZ80SPI() : current(arduino::DEFAULT_SPI_SETTINGS), interrupt_pins(0), lsb_first(false), irq_disabled(false) {
+}
+
+void EZ80SPI::begin() {
+    // SS as chip select output, high. /SS is only sampled in alternate function mode.
+    digitalWrite(PIN_SPI_SS, HIGH);
+    pinMode(PIN_SPI_SS, OUTPUT);
+
+    // SCK, MISO, MOSI to alternate function: ALT2 = 1, ALT1 = 0, DDR = 1
+    const uint8_t mask = (uint8_t)((1u << GET_PIN(PIN_SPI_SCK)) | (1u << GET_PIN(PIN_SPI_MISO)) | (1u << GET_PIN(PIN_SPI_MOSI)));
+    IO(PB_DDR) |= mask;
+    IO(PB_ALT1) &= ~mask;
+    IO(PB_ALT2) |= mask;
+
+    _set_vector(VECTOR_SPI, SPI_Handler);
+    apply(arduino::DEFAULT_SPI_SETTINGS);
+}
+
+void EZ80SPI::end() {
+    while (spi_busy) {}
+    IO(SPI_CTL) = 0x00;
+    pinMode(PIN_SPI_SCK, INPUT);
+    pinMode(PIN_SPI_MISO, INPUT);
+    pinMode(PIN_SPI_MOSI, INPUT);
+}
+
+void EZ80SPI::apply(const arduino::SPISettings &settings) {
+    uint32_t clock = settings.getClockFreq();
+    if (clock == 0) clock = 1;
+    // fastest clock that does not exceed the requested one: BRG = ceil(F_CPU / (2 * clock))
+    uint32_t brg = (F_CPU + 2UL * clock - 1UL) / (2UL * clock);
+    if (brg < SPI_BRG_MIN) brg = SPI_BRG_MIN;
+    if (brg > 0xFFFF) brg = 0xFFFF;
+
+    uint8_t ctl = SPI_CTL_BASE;
+    switch (settings.getDataMode()) {
+        case arduino::SPI_MODE0: break;
+        case arduino::SPI_MODE1: ctl |= SPI_CTL_CPHA; break;
+        case arduino::SPI_MODE2: ctl |= SPI_CTL_CPOL; break;
+        default:                 ctl |= SPI_CTL_CPOL | SPI_CTL_CPHA; break;
+    }
+
+    IO(SPI_CTL) = 0x00;
+    IO(SPI_BRG_L) = (uint8_t)(brg & 0xFF);
+    IO(SPI_BRG_H) = (uint8_t)(brg >> 8);
+    IO(SPI_CTL) = ctl;
+    spi_ctl = ctl;
+    lsb_first = (settings.getBitOrder() == LSBFIRST);
+    current = settings;
+}
+
+void EZ80SPI::beginTransaction(arduino::SPISettings settings) {
+    for (;;) {
+        // a running transferAsync() needs the SPI interrupt to finish
+        while (spi_busy) {}
+        if (!interrupt_pins) break;
+        __asm("di");
+        if (!spi_busy) {
+            irq_disabled = true;
+            break;
+        }
+        // its callback started the next one
+        __asm("ei");
+    }
+    if (settings != current) {
+        apply(settings);
+    }
+}
+
+void EZ80SPI::endTransaction(void) {
+    if (irq_disabled) {
+        irq_disabled = false;
+        __asm("ei");
+    }
+}
+
+void EZ80SPI::usingInterrupt(int interruptNumber) {
+    if (interruptNumber >= 0 && interruptNumber < 32) {
+        interrupt_pins |= (1UL << interruptNumber);
+    }
+}
+
+void EZ80SPI::notUsingInterrupt(int interruptNumber) {
+    if (interruptNumber >= 0 && interruptNumber < 32) {
+        interrupt_pins &= ~(1UL << interruptNumber);
+    }
+}
+
+uint8_t EZ80SPI::transfer(uint8_t data) {
+    if (lsb_first) data = reverse_bits(data);
+    IO(SPI_TSR) = data;
+    SPI_WAIT();
+    data = IO(SPI_RBR);
+    return lsb_first ? reverse_bits(data) : data;
+}
+
+uint16_t EZ80SPI::transfer16(uint16_t data) {
+    uint8_t hi = (uint8_t)(data >> 8);
+    uint8_t lo = (uint8_t)data;
+    if (lsb_first) {
+        lo = transfer(lo);
+        hi = transfer(hi);
+    } else {
+        hi = transfer(hi);
+        lo = transfer(lo);
+    }
+    return (uint16_t)((hi << 8) | lo);
+}
+
+void EZ80SPI::transfer(void *buf, size_t count) {
+    transfer(buf, buf, count);
+}
+
+// The next byte is written as soon as SPIF is set and the previous byte is
+// picked up from SPI_RBR while the new one is shifting, so the bus only idles
+// for the poll and the write.
+void EZ80SPI::transfer(const void *txbuf, void *rxbuf, size_t count) {
+    if (count == 0) return;
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    uint8_t *rx = (uint8_t *)rxbuf;
+
+    if (lsb_first) {
+        while (count--) {
+            const uint8_t b = transfer(tx ? *tx++ : (uint8_t)0xFF);
+            if (rx) *rx++ = b;
+        }
+        return;
+    }
+
+    IO(SPI_TSR) = tx ? *tx++ : 0xFF;
+    if (tx && rx) {
+        // tx stays one byte ahead of rx, so in place (tx == rx) works as well
+        while (--count) {
+            const uint8_t next = *tx++;
+            SPI_WAIT();
+            IO(SPI_TSR) = next;
+            *rx++ = IO(SPI_RBR);
+        }
+    } else if (tx) {
+        while (--count) {
+            const uint8_t next = *tx++;
+            SPI_WAIT();
+            IO(SPI_TSR) = next;
+        }
+    } else {
+        while (--count) {
+            SPI_WAIT();
+            IO(SPI_TSR) = 0xFF;
+            if (rx) *rx++ = IO(SPI_RBR);
+        }
+    }
+    SPI_WAIT();
+    const uint8_t last = IO(SPI_RBR);
+    if (rx) *rx = last;
+}
+
+bool EZ80SPI::transferAsync(const void *txbuf, void *rxbuf, size_t count, SPICallback callback, void *param) {
+    // with interrupts held off by the transaction the ISR could never run
+    if (spi_busy || irq_disabled) return false;
+    if (count == 0) {
+        if (callback) callback(param);
+        return true;
+    }
+    const uint8_t state = irq_save();
+    spi_tx = (const uint8_t *)txbuf;
+    spi_rx = (uint8_t *)rxbuf;
+    spi_left = count - 1;
+    spi_async_lsb = lsb_first;
+    spi_callback = callback;
+    spi_callback_param = param;
+    spi_busy = true;
+    IO(SPI_CTL) = spi_ctl | SPI_CTL_IRQ_EN;
+    IO(SPI_TSR) = spi_next_tx();
+    irq_restore(state);
+    return true;
+}
+
+bool EZ80SPI::busy() {
+    return spi_busy;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "api/HardwareSPI.h"
+
+/*
+  SPI master on the eZ80F92 SPI block: SCK PB3, MISO PB6, MOSI PB7.
+
+  SS (PB2) is a plain GPIO output that the sketch drives as chip select; in
+  master mode the hardware /SS input must not go low, so PB2 is not left to the
+  SPI block. The clock is F_CPU / (2 * BRG) with BRG >= 2, i.e. 4.608 MHz at most
+  at 18.432 MHz; beginTransaction() picks the fastest clock that does not exceed
+  the requested one. The hardware shifts MSB first only, LSBFIRST is done by
+  reversing the bits in software.
+
+  transferAsync() runs a block transfer from the SPI interrupt and calls the
+  callback from the interrupt when the last byte is in.
+*/
+
+typedef void (*SPICallback)(void *param);
+
+class EZ80SPI : public arduino::HardwareSPI
+{
+public:
+    EZ80SPI();
+
+    void begin();
+    void end();
+
+    void beginTransaction(arduino::SPISettings settings);
+    void endTransaction(void);
+
+    uint8_t transfer(uint8_t data);
+    uint16_t transfer16(uint16_t data);
+    // in place, the received bytes replace the sent ones
+    void transfer(void *buf, size_t count);
+    // txbuf == nullptr sends 0xFF, rxbuf == nullptr drops the received bytes
+    void transfer(const void *txbuf, void *rxbuf, size_t count);
+
+    // Starts a block transfer in the background and returns immediately. The
+    // buffers must stay valid until the callback ran or busy() returns false.
+    // Returns false if a transfer is still running, or inside a transaction
+    // that disabled interrupts for usingInterrupt().
+    bool transferAsync(const void *txbuf, void *rxbuf, size_t count, SPICallback callback = nullptr, void *param = nullptr);
+    bool busy();
+
+    // pin interrupts that use SPI: interrupts are disabled during transactions
+    void usingInterrupt(int interruptNumber);
+    void notUsingInterrupt(int interruptNumber);
+
+    // SPI peripheral (slave) mode is not supported
+    void attachInterrupt() {}
+    void detachInterrupt() {}
+
+private:
+    void apply(const arduino::SPISettings &settings);
+
+    arduino::SPISettings current;
+    uint32_t interrupt_pins;
+    bool lsb_first;
+    bool irq_disabled;
+};
+
+extern EZ80SPI SPI;
@@ -0,0 +1,80 @@
+/*
+  Sequential write and read throughput of an SD card, measured with
+  benchmark.h and printed on UART0 in KB/s.
+
+  One sector per call is the data logger case and depends on the write-back
+  cache keeping the CMD25 stream open; CHUNK sectors per call go straight
+  between card and buffer.
+
+  The sectors from BENCH_LBA on are overwritten.
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <SdCard.h>
+#include <benchmark.h>
+#include <uart.h>
+
+#define SD_CS           PB2
+#define BENCH_LBA       65536UL         // 32 MB in, clear of the partition table and FAT
+#define BENCH_SECTORS   512             // 256 KB per test
+#define CHUNK           16
+
+SdCard card;
+static uint8_t buf[CHUNK * 512];
+
+static void report(const char *name, unsigned long us, bool ok) {
+    uart0_puts(name);
+    if (!ok) {
+        uart0_puts(": error ");
+        uart0_putnum(card.errorCode(), 10);
+        uart0_puts("\r\n");
+        return;
+    }
+    uart0_puts(": ");
+    uart0_putlnum((long)(BENCH_SECTORS / 2 * 1000000UL / (us ? us : 1)), 10);
+    uart0_puts(" KB/s\r\n");
+}
+
+static void benchWrite(const char *name, size_t per_call) {
+    bool ok = true;
+    benchmark_start();
+    for (uint32_t s = 0; s < BENCH_SECTORS && ok; s += per_call) {
+        ok = card.writeBlocks(BENCH_LBA + s, buf, per_call);
+    }
+    ok = card.sync() && ok;
+    report(name, benchmark_stop(), ok);
+}
+
+static void benchRead(const char *name, size_t per_call) {
+    bool ok = true;
+    benchmark_start();
+    for (uint32_t s = 0; s < BENCH_SECTORS && ok; s += per_call) {
+        ok = card.readBlocks(BENCH_LBA + s, buf, per_call);
+    }
+    report(name, benchmark_stop(), ok);
+}
+
+void setup() {
+    if (!card.begin(SPI, SD_CS)) {
+        uart0_puts("no card, error ");
+        uart0_putnum(card.errorCode(), 10);
+        uart0_puts("\r\n");
+        return;
+    }
+    if (card.sectors() < BENCH_LBA + BENCH_SECTORS) {
+        uart0_puts("card too small\r\n");
+        return;
+    }
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)i;
+    }
+    benchWrite("write, 1 sector per call", 1);
+    benchWrite("write, 16 sectors per call", CHUNK);
+    benchRead("read, 1 sector per call", 1);
+    benchRead("read, 16 sectors per call", CHUNK);
+    card.end();
+}
+
+void loop() {
+}
@@ -0,0 +1,26 @@
+#include <time.h>
+#include "Arduino.h"
+
+PinStatus host_pins[256];
+
+void yield(void) {
+}
+
+void pinMode(pin_size_t pinNumber, PinMode pinMode) {
+    (void)pinNumber;
+    (void)pinMode;
+}
+
+void digitalWrite(pin_size_t pinNumber, PinStatus status) {
+    host_pins[pinNumber] = status;
+}
+
+PinStatus digitalRead(pin_size_t pinNumber) {
+    return host_pins[pinNumber];
+}
+
+unsigned long millis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)(now.tv_sec * 1000L + now.tv_nsec / 1000000L);
+}
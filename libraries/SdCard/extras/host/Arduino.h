@@ -0,0 +1,16 @@
+#pragma once
+
+/*
+  Host stand-in for the core's Arduino.h, just enough to build SdCard.cpp on
+  Linux against SdCardModel. The pin levels are kept in host_pins[] so the
+  model can see chip select.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api/Common.h"
+#include "api/HardwareSPI.h"
+
+#define NOT_A_PIN 255
+
+extern PinStatus host_pins[256];
@@ -0,0 +1,279 @@
+#include <string.h>
+#include "SdCardModel.h"
+
+#define SECTOR              512
+
+#define R1_IDLE             0x01
+#define R1_ILLEGAL          0x04
+#define R1_ADDRESS          0x20
+
+#define TOKEN_SINGLE        0xFE
+#define TOKEN_MULTI         0xFC
+#define TOKEN_STOP          0xFD
+#define DATA_ACCEPTED       0xE5
+
+SdCardModel::SdCardModel(const char *image, pin_size_t cs)
+    : clocked(0), clock(0), cs_pin(cs), n_sectors(0), frame_len(0), rx(RX_COMMAND), multi(false),
+      idle(true), app(false), init_polls(0), reading(false), read_lba(0), write_lba(0), block_len(0) {
+    file = fopen(image, "r+b");
+    if (!file) return;
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    // CSD 2.0 counts in units of 512 KiB
+    n_sectors = (uint32_t)(size / (512L * 1024L)) * 1024u;
+    if (!n_sectors) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+SdCardModel::~SdCardModel() {
+    if (file) fclose(file);
+}
+
+void SdCardModel::clearLog() {
+    commands.clear();
+    reads.clear();
+    writes.clear();
+    errors.clear();
+}
+
+size_t SdCardModel::count(uint8_t cmd) const {
+    size_t n = 0;
+    for (const Command &c : commands) {
+        if (c.cmd == cmd) n++;
+    }
+    return n;
+}
+
+void SdCardModel::error(const char *what) {
+    errors.push_back(what);
+}
+
+//==============================================================
+// Bus
+//==============================================================
+uint8_t SdCardModel::transfer(uint8_t data) {
+    if (host_pins[cs_pin] != LOW) {
+        return 0xFF;
+    }
+    clocked++;
+    if (out.empty() && reading) {
+        queueSector(read_lba++);
+    }
+    uint8_t miso = 0xFF;
+    if (!out.empty()) {
+        miso = out.front();
+        out.pop_front();
+    }
+    receive(data);
+    return miso;
+}
+
+uint16_t SdCardModel::transfer16(uint16_t data) {
+    const uint8_t hi = transfer((uint8_t)(data >> 8));
+    return (uint16_t)((hi << 8) | transfer((uint8_t)data));
+}
+
+void SdCardModel::transfer(void *buf, size_t count) {
+    uint8_t *p = (uint8_t *)buf;
+    for (size_t i = 0; i < count; i++) {
+        p[i] = transfer(p[i]);
+    }
+}
+
+void SdCardModel::response(uint8_t r1) {
+    out.push_back(0xFF);                    // N_CR
+    out.push_back(r1);
+}
+
+void SdCardModel::busy(uint8_t bytes) {
+    while (bytes--) out.push_back(0x00);
+}
+
+void SdCardModel::queueSector(uint32_t lba) {
+    if (lba >= n_sectors) {
+        error("read past the end of the card");
+        reading = false;
+        return;
+    }
+    uint8_t data[SECTOR];
+    fseek(file, (long)lba * SECTOR, SEEK_SET);
+    if (fread(data, 1, SECTOR, file) != SECTOR) {
+        error("image read failed");
+    }
+    reads.push_back(lba);
+    out.push_back(0xFF);                    // access time
+    out.push_back(0xFF);
+    out.push_back(TOKEN_SINGLE);
+    out.insert(out.end(), data, data + SECTOR);
+    out.push_back(0x00);                    // CRC, not checked in SPI mode
+    out.push_back(0x00);
+}
+
+//==============================================================
+// Card
+//==============================================================
+void SdCardModel::receive(uint8_t data) {
+    switch (rx) {
+    case RX_COMMAND:
+        if (frame_len == 0 && (data & 0xC0) != 0x40) return;
+        frame[frame_len++] = data;
+        if (frame_len == sizeof(frame)) {
+            frame_len = 0;
+            execute();
+        }
+        break;
+
+    case RX_TOKEN:
+        if (data == 0xFF) return;
+        if (data == (multi ? TOKEN_MULTI : TOKEN_SINGLE)) {
+            rx = RX_DATA;
+            block_len = 0;
+        } else if (multi && data == TOKEN_STOP) {
+            out.push_back(0xFF);
+            busy(4);
+            rx = RX_COMMAND;
+        } else {
+            error("unexpected byte while waiting for a data token");
+            rx = RX_COMMAND;
+        }
+        break;
+
+    case RX_DATA:
+        block[block_len++] = data;
+        if (block_len == sizeof(block)) {
+            if (write_lba >= n_sectors) {
+                error("write past the end of the card");
+            } else {
+                fseek(file, (long)write_lba * SECTOR, SEEK_SET);
+                if (fwrite(block, 1, SECTOR, file) != SECTOR) {
+                    error("image write failed");
+                }
+                writes.push_back(write_lba);
+            }
+            write_lba++;
+            out.push_back(DATA_ACCEPTED);
+            busy(4);
+            rx = multi ? RX_TOKEN : RX_COMMAND;
+        }
+        break;
+    }
+}
+
+void SdCardModel::execute() {
+    const uint8_t cmd = frame[0] & 0x3F;
+    const uint32_t arg = ((uint32_t)frame[1] << 24) | ((uint32_t)frame[2] << 16) |
+                         ((uint32_t)frame[3] << 8) | frame[4];
+    const bool acmd = app;
+    app = false;
+    commands.push_back({ cmd, arg });
+
+    if (reading) {
+        if (cmd != 12) {
+            error("command other than CMD12 during a read stream");
+        }
+        // a sector cut off before its CRC was not read
+        if (out.size() > 2) reads.pop_back();
+        out.clear();
+        reading = false;
+    }
+    if ((cmd == 0 && frame[5] != 0x95) || (cmd == 8 && frame[5] != 0x87)) {
+        error("bad CRC on CMD0 or CMD8");
+    }
+    const uint8_t state = idle ? R1_IDLE : 0;
+    if (idle && cmd != 0 && cmd != 8 && cmd != 55 && cmd != 58 && !(acmd && cmd == 41)) {
+        error("command before the card is initialised");
+    }
+
+    switch (cmd) {
+    case 0:
+        idle = true;
+        init_polls = 0;
+        response(R1_IDLE);
+        break;
+    case 8: {
+        response(state);
+        const uint8_t r7[4] = { 0x00, 0x00, (uint8_t)(arg >> 8), (uint8_t)arg };
+        out.insert(out.end(), r7, r7 + 4);
+        break;
+    }
+    case 9: {
+        // CSD 2.0, C_SIZE in bytes 7..9
+        uint8_t csd[16] = { 0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00 };
+        const uint32_t c_size = n_sectors / 1024 - 1;
+        csd[7] = (uint8_t)((c_size >> 16) & 0x3F);
+        csd[8] = (uint8_t)(c_size >> 8);
+        csd[9] = (uint8_t)c_size;
+        csd[10] = 0x7F;
+        csd[11] = 0x80;
+        csd[12] = 0x0A;
+        csd[13] = 0x40;
+        csd[15] = 0x01;
+        response(state);
+        out.push_back(0xFF);
+        out.push_back(TOKEN_SINGLE);
+        out.insert(out.end(), csd, csd + sizeof(csd));
+        out.push_back(0x00);
+        out.push_back(0x00);
+        break;
+    }
+    case 12:
+        // stuff byte, R1, then busy until the stream has stopped
+        out.push_back(0xFF);
+        out.push_back(0x00);
+        busy(2);
+        break;
+    case 16:
+        response(arg == SECTOR ? state : (uint8_t)(state | R1_ILLEGAL));
+        break;
+    case 17:
+    case 18:
+        if (arg >= n_sectors) {
+            response(R1_ADDRESS);
+            break;
+        }
+        response(0);
+        if (cmd == 17) {
+            queueSector(arg);
+        } else {
+            reading = true;
+            read_lba = arg;
+        }
+        break;
+    case 24:
+    case 25:
+        if (arg >= n_sectors) {
+            response(R1_ADDRESS);
+            break;
+        }
+        response(0);
+        rx = RX_TOKEN;
+        multi = cmd == 25;
+        write_lba = arg;
+        break;
+    case 41:
+        if (!acmd) {
+            response(state | R1_ILLEGAL);
+            break;
+        }
+        // leaves the idle state on the third poll
+        if (++init_polls >= 3) idle = false;
+        response(idle ? R1_IDLE : 0);
+        break;
+    case 55:
+        app = true;
+        response(state);
+        break;
+    case 58: {
+        response(state);
+        // powered up, CCS set: SDHC with block addressing
+        const uint8_t ocr[4] = { (uint8_t)(idle ? 0x40 : 0xC0), 0xFF, 0x80, 0x00 };
+        out.insert(out.end(), ocr, ocr + 4);
+        break;
+    }
+    default:
+        response(state | R1_ILLEGAL);
+        break;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+/*
+  SDHC card in SPI mode on top of an image file, seen through the
+  HardwareSPI interface, for running the SdCard driver on the host.
+
+  transfer() clocks one byte each way like the real bus: the byte returned was
+  decided before the byte sent is looked at. The card answers
+  CMD0/8/9/12/16/17/18/24/25/55/58 and ACMD41, streams sectors for CMD18
+  until CMD12 and takes data tokens for CMD25 until the stop token. It only
+  listens while host_pins[cs] is LOW.
+
+  Everything the driver did is logged for the tests: the commands, the
+  sectors read and written in card order, and protocol errors such as a
+  command in the middle of a read stream.
+*/
+
+class SdCardModel : public arduino::HardwareSPI
+{
+public:
+    struct Command {
+        uint8_t cmd;
+        uint32_t arg;
+    };
+
+    // the image must hold at least 512 KiB, the card size is rounded down to that
+    SdCardModel(const char *image, pin_size_t cs);
+    ~SdCardModel();
+
+    bool isOpen() const { return file != nullptr; }
+    uint32_t sectors() const { return n_sectors; }
+
+    uint8_t transfer(uint8_t data) override;
+    uint16_t transfer16(uint16_t data) override;
+    void transfer(void *buf, size_t count) override;
+
+    void usingInterrupt(int interruptNumber) override { (void)interruptNumber; }
+    void notUsingInterrupt(int interruptNumber) override { (void)interruptNumber; }
+    void beginTransaction(arduino::SPISettings settings) override { clock = settings.getClockFreq(); }
+    void endTransaction(void) override { }
+    void attachInterrupt() override { }
+    void detachInterrupt() override { }
+    void begin() override { }
+    void end() override { }
+
+    // drops the logs, the byte count is kept
+    void clearLog();
+    // number of logged commands with index cmd
+    size_t count(uint8_t cmd) const;
+
+    std::vector<Command> commands;
+    std::vector<uint32_t> reads;            // sectors sent, CMD17 and CMD18
+    std::vector<uint32_t> writes;           // sectors programmed, CMD24 and CMD25
+    std::vector<std::string> errors;
+    uint64_t clocked;                       // bytes on the bus with the card selected
+    uint32_t clock;                         // of the last beginTransaction()
+
+private:
+    enum { RX_COMMAND, RX_TOKEN, RX_DATA };
+
+    void receive(uint8_t data);
+    void execute();
+    void response(uint8_t r1);
+    void busy(uint8_t bytes);
+    void queueSector(uint32_t lba);
+    void error(const char *what);
+
+    FILE *file;
+    pin_size_t cs_pin;
+    uint32_t n_sectors;
+
+    std::deque<uint8_t> out;                // MISO bytes still to send
+    uint8_t frame[6];
+    uint8_t frame_len;
+    uint8_t rx;
+    bool multi;                             // RX_TOKEN / RX_DATA belong to CMD25
+    bool idle;
+    bool app;                               // CMD55 came before
+    uint8_t init_polls;
+    bool reading;                           // CMD18 stream is running
+    uint32_t read_lba;
+    uint32_t write_lba;
+    uint8_t block[512 + 2];
+    size_t block_len;
+};
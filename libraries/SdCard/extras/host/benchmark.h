@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+  Host stand-in for cores/ez80/benchmark.h: the same two functions on the
+  monotonic clock instead of TMR0 and elapsed_ms.
+*/
+
+#include <time.h>
+
+static struct timespec saved_start;
+
+static inline void benchmark_start() {
+    clock_gettime(CLOCK_MONOTONIC, &saved_start);
+}
+
+/* returns elapsed time since benchmark_start() in microseconds */
+static inline unsigned long benchmark_stop() {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (unsigned long)((end.tv_sec - saved_start.tv_sec) * 1000000L +
+                           (end.tv_nsec - saved_start.tv_nsec) / 1000L);
+}
@@ -0,0 +1,239 @@
+/*
+  Runs the SdCard driver on Linux against SdCardModel: checks the CMD18 and
+  CMD25 streams and the order in which the cache writes sectors back, then
+  measures throughput with the benchmark.h functions.
+
+    cd libraries/SdCard/extras/host
+    g++ -std=gnu++17 -O2 -I. -I../../src -I../../../../cores/ez80 \
+        sdcard_test.cpp SdCardModel.cpp Arduino.cpp ../../src/SdCard.cpp -o sdcard_test
+    ./sdcard_test
+
+  The card image, sdcard.img (8 MiB) in the current directory, is created and
+  filled with a pattern.
+  The bus figures assume the clock SdCard asked for; the host time is only the
+  driver and the model.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Arduino.h"
+#include "benchmark.h"
+#include "SdCard.h"
+#include "SdCardModel.h"
+
+#define SECTOR          512
+#define IMAGE_SECTORS   16384u
+#define CS_PIN          10
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static std::vector<uint8_t> reference;
+
+static void fill(uint8_t *buf, uint32_t lba, size_t count, uint8_t seed) {
+    for (size_t i = 0; i < count * SECTOR; i++) {
+        buf[i] = (uint8_t)((lba + i / SECTOR) * 7 + i * 13 + seed);
+    }
+}
+
+static bool write(SdCard &card, uint32_t lba, size_t count, uint8_t seed) {
+    std::vector<uint8_t> buf(count * SECTOR);
+    fill(buf.data(), lba, count, seed);
+    memcpy(&reference[(size_t)lba * SECTOR], buf.data(), buf.size());
+    return card.writeBlocks(lba, buf.data(), count);
+}
+
+static bool read(SdCard &card, uint32_t lba, size_t count) {
+    std::vector<uint8_t> buf(count * SECTOR);
+    return card.readBlocks(lba, buf.data(), count) &&
+           memcmp(buf.data(), &reference[(size_t)lba * SECTOR], buf.size()) == 0;
+}
+
+static std::vector<uint32_t> range(uint32_t first, uint32_t n) {
+    std::vector<uint32_t> v;
+    for (uint32_t i = 0; i < n; i++) v.push_back(first + i);
+    return v;
+}
+
+static bool createImage(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    reference.resize((size_t)IMAGE_SECTORS * SECTOR);
+    for (size_t i = 0; i < reference.size(); i++) {
+        reference[i] = (uint8_t)(i * 31 + (i >> 9));
+    }
+    const bool ok = fwrite(reference.data(), 1, reference.size(), f) == reference.size();
+    fclose(f);
+    return ok;
+}
+
+static bool imageMatches(const char *path) {
+    std::vector<uint8_t> image(reference.size());
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    const bool ok = fread(image.data(), 1, image.size(), f) == image.size();
+    fclose(f);
+    return ok && image == reference;
+}
+
+static void testInit(SdCard &card, SdCardModel &model) {
+    CHECK(card.begin(model, CS_PIN));
+    CHECK(card.sectors() == IMAGE_SECTORS);
+    CHECK(card.isHighCapacity());
+    CHECK(model.count(0) >= 1 && model.count(8) == 1 && model.count(41) >= 1);
+    CHECK(model.count(58) == 1 && model.count(9) == 1);
+    CHECK(host_pins[CS_PIN] == HIGH);
+}
+
+// dirty sectors reach the card in LBA order, whatever order they were written in
+static void testWriteBackOrder(SdCard &card, SdCardModel &model) {
+    model.clearLog();
+    CHECK(write(card, 50, 1, 1) && write(card, 10, 1, 1) && write(card, 30, 1, 1) && write(card, 20, 1, 1));
+    CHECK(model.writes.empty());
+    CHECK(card.sync());
+    CHECK(model.writes == std::vector<uint32_t>({ 10, 20, 30, 50 }));
+    CHECK(model.count(25) == 4);
+
+    // neighbours share one CMD25
+    model.clearLog();
+    CHECK(write(card, 103, 1, 2) && write(card, 101, 1, 2) && write(card, 102, 1, 2) && write(card, 100, 1, 2));
+    CHECK(card.sync());
+    CHECK(model.writes == range(100, 4));
+    CHECK(model.count(25) == 1);
+}
+
+// a full cache is written back when its oldest line is dirty, and the stream
+// stays open for the next sector
+static void testEviction(SdCard &card, SdCardModel &model) {
+    model.clearLog();
+    for (uint32_t lba = 200; lba < 200 + SD_CACHE_SECTORS; lba++) {
+        CHECK(write(card, lba, 1, 3));
+    }
+    CHECK(model.writes.empty());
+    CHECK(write(card, 200 + SD_CACHE_SECTORS, 1, 3));
+    CHECK(model.writes == range(200, SD_CACHE_SECTORS));
+    CHECK(card.sync());
+    CHECK(model.writes == range(200, SD_CACHE_SECTORS + 1));
+    CHECK(model.count(25) == 1);
+
+    // logger: one sector per call still ends up in a single CMD25
+    model.clearLog();
+    for (uint32_t lba = 1000; lba < 1064; lba++) {
+        CHECK(write(card, lba, 1, 4));
+    }
+    CHECK(card.sync());
+    CHECK(model.writes == range(1000, 64));
+    CHECK(model.count(25) == 1);
+}
+
+static void testStreams(SdCard &card, SdCardModel &model) {
+    // large writes bypass the cache and continue one CMD25 across calls
+    model.clearLog();
+    CHECK(write(card, 2000, 32, 5) && write(card, 2032, 32, 5));
+    CHECK(model.writes == range(2000, 64));
+    CHECK(model.count(25) == 1);
+
+    // the read ends the write stream with the stop token, then one CMD18
+    model.clearLog();
+    CHECK(read(card, 2000, 32) && read(card, 2032, 32));
+    CHECK(model.count(18) == 1 && model.count(25) == 0);
+    CHECK(model.reads == range(2000, 64));
+
+    // single sector reads are served by read-ahead from the same CMD18, every
+    // sector is sent once
+    model.clearLog();
+    for (uint32_t lba = 3000; lba < 3032; lba++) {
+        CHECK(read(card, lba, 1));
+    }
+    CHECK(model.count(18) == 1);
+    CHECK(model.reads.size() >= 32 && model.reads.size() <= 32 + SD_READAHEAD);
+    CHECK(model.reads == range(3000, (uint32_t)model.reads.size()));
+
+    // a write ends the read stream with CMD12
+    model.clearLog();
+    CHECK(write(card, 5000, 32, 6));
+    CHECK(model.count(12) == 1 && model.count(25) == 1);
+    CHECK(card.sync());
+}
+
+// cached data wins over the card, and a large read writes back dirty sectors
+// in its range before it streams
+static void testCoherence(SdCard &card, SdCardModel &model) {
+    model.clearLog();
+    CHECK(read(card, 4000, 1));
+    CHECK(write(card, 4000, 1, 7));
+    CHECK(read(card, 4000, 1));
+    CHECK(model.writes.empty());
+    CHECK(read(card, 3996, 16));
+    CHECK(model.writes == std::vector<uint32_t>({ 4000 }));
+    CHECK(model.count(18) == 2);
+
+    // a large write replaces cached copies
+    CHECK(write(card, 4004, 1, 8));
+    CHECK(write(card, 4000, 16, 9));
+    CHECK(read(card, 4004, 1));
+    CHECK(card.sync());
+}
+
+typedef bool (*Transfer)(SdCard &card, uint32_t lba, size_t count);
+
+static void measure(const char *name, SdCard &card, SdCardModel &model, Transfer op, uint32_t lba,
+                    size_t per_call, size_t calls) {
+    const uint64_t clocked = model.clocked;
+    bool ok = true;
+    benchmark_start();
+    for (size_t i = 0; i < calls && ok; i++) {
+        ok = op(card, lba + (uint32_t)(i * per_call), per_call);
+    }
+    ok = card.sync() && ok;
+    const unsigned long us = benchmark_stop();
+    CHECK(ok);
+    const double payload = (double)(per_call * calls * SECTOR);
+    const double bus = (double)(model.clocked - clocked);
+    printf("%-28s %8.0f KB/s host, %5.3f bus bytes per byte, %6.0f KB/s at %lu Hz\n", name,
+           payload / 1024.0 / (us ? us / 1e6 : 1e-6), bus / payload,
+           payload / 1024.0 / (bus * 8.0 / model.clock), (unsigned long)model.clock);
+}
+
+static bool writeOp(SdCard &card, uint32_t lba, size_t count) { return write(card, lba, count, 10); }
+static bool readOp(SdCard &card, uint32_t lba, size_t count) { return read(card, lba, count); }
+
+// Common.h declares main() without arguments
+int main() {
+    const char *path = "sdcard.img";
+    if (!createImage(path)) {
+        printf("cannot create %s\n", path);
+        return 1;
+    }
+    SdCardModel model(path, CS_PIN);
+    if (!model.isOpen()) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+
+    SdCard card;
+    testInit(card, model);
+    testWriteBackOrder(card, model);
+    testEviction(card, model);
+    testStreams(card, model);
+    testCoherence(card, model);
+
+    measure("write, 1 sector per call", card, model, writeOp, 8192, 1, 2048);
+    measure("write, 32 sectors per call", card, model, writeOp, 10240, 32, 64);
+    measure("read, 1 sector per call", card, model, readOp, 8192, 1, 2048);
+    measure("read, 32 sectors per call", card, model, readOp, 10240, 32, 64);
+
+    card.end();
+    for (const std::string &e : model.errors) {
+        printf("card: %s\n", e.c_str());
+        failures++;
+    }
+    CHECK(imageMatches(path));
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,484 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SdCard.h"
+
+#define SD_SECTOR           BLOCKDEV_SECTOR_SIZE
+#define SD_INIT_CLOCK       400000UL
+
+#define SD_CMD_TIMEOUT      300             // ms, card busy before a command
+#define SD_INIT_TIMEOUT     1000            // ms, ACMD41 / CMD1
+#define SD_READ_TIMEOUT     200             // ms, until the data token
+#define SD_WRITE_TIMEOUT    600             // ms, programming a block
+
+#define SD_TOKEN_SINGLE     0xFE            // CMD17 / CMD18 / CMD24 data token
+#define SD_TOKEN_MULTI      0xFC            // CMD25 data token
+#define SD_TOKEN_STOP       0xFD            // ends CMD25
+
+#define SD_R1_IDLE          0x01
+#define SD_R1_ILLEGAL       0x04
+
+enum { LINE_INVALID = 0, LINE_CLEAN, LINE_DIRTY };
+
+//==============================================================
+// blockdev_t glue
+//==============================================================
+static int sd_bd_read(blockdev_t *dev, uint32_t lba, void *buf, size_t count) {
+    return ((SdCard *)dev->ctx)->readBlocks(lba, buf, count) ? 0 : -1;
+}
+
+static int sd_bd_write(blockdev_t *dev, uint32_t lba, const void *buf, size_t count) {
+    return ((SdCard *)dev->ctx)->writeBlocks(lba, buf, count) ? 0 : -1;
+}
+
+static int sd_bd_sync(blockdev_t *dev) {
+    return ((SdCard *)dev->ctx)->sync() ? 0 : -1;
+}
+
+SdCard::SdCard() : spi(nullptr), cs_pin(NOT_A_PIN), block_addressing(false), error(SD_ERR_NONE),
+                   stream(STREAM_NONE), stream_lba(0), last_read(0xFFFFFFFFUL),
+                   lines(nullptr), cache_mem(nullptr), n_lines(0), readahead(0), use_clock(0) {
+    dev.read = sd_bd_read;
+    dev.write = sd_bd_write;
+    dev.sync = sd_bd_sync;
+    dev.sectors = 0;
+    dev.ctx = this;
+}
+
+//==============================================================
+// SPI level
+//==============================================================
+void SdCard::select() {
+    spi->beginTransaction(settings);
+    digitalWrite(cs_pin, LOW);
+}
+
+void SdCard::deselect() {
+    digitalWrite(cs_pin, HIGH);
+    // one more byte so the card releases MISO
+    spi->transfer(0xFF);
+    spi->endTransaction();
+}
+
+// HardwareSPI only has an in-place block transfer, so outgoing data goes
+// through a small copy to keep the caller's buffer intact
+void SdCard::sendBytes(const uint8_t *buf, size_t len) {
+    uint8_t chunk[32];
+    while (len) {
+        const size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        memcpy(chunk, buf, n);
+        spi->transfer(chunk, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+bool SdCard::waitReady(uint16_t timeout_ms) {
+    const unsigned long start = millis();
+    while (spi->transfer(0xFF) != 0xFF) {
+        if (millis() - start > timeout_ms) {
+            error = SD_ERR_TIMEOUT;
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t SdCard::command(uint8_t cmd, uint32_t arg) {
+    // CMD12 interrupts a read stream, the card is sending data and never looks ready
+    if (cmd != 0 && cmd != 12) {
+        waitReady(SD_CMD_TIMEOUT);
+    }
+    uint8_t frame[6];
+    frame[0] = (uint8_t)(0x40 | cmd);
+    frame[1] = (uint8_t)(arg >> 24);
+    frame[2] = (uint8_t)(arg >> 16);
+    frame[3] = (uint8_t)(arg >> 8);
+    frame[4] = (uint8_t)arg;
+    // CRC is only checked for CMD0 and CMD8 in SPI mode
+    frame[5] = cmd == 0 ? 0x95 : (cmd == 8 ? 0x87 : 0x01);
+    spi->transfer(frame, sizeof(frame));
+    if (cmd == 12) {
+        spi->transfer(0xFF);                // stuff byte
+    }
+    uint8_t r1 = 0xFF;
+    for (uint8_t i = 0; i < 10; i++) {
+        r1 = spi->transfer(0xFF);
+        if (!(r1 & 0x80)) break;
+    }
+    return r1;
+}
+
+uint8_t SdCard::appCommand(uint8_t cmd, uint32_t arg) {
+    const uint8_t r1 = command(55, 0);
+    if (r1 > SD_R1_IDLE) return r1;
+    return command(cmd, arg);
+}
+
+bool SdCard::readData(uint8_t *buf, size_t len) {
+    const unsigned long start = millis();
+    uint8_t token;
+    while ((token = spi->transfer(0xFF)) == 0xFF) {
+        if (millis() - start > SD_READ_TIMEOUT) {
+            error = SD_ERR_TIMEOUT;
+            return false;
+        }
+    }
+    if (token != SD_TOKEN_SINGLE) {
+        error = SD_ERR_READ;
+        return false;
+    }
+    memset(buf, 0xFF, len);
+    spi->transfer(buf, len);
+    spi->transfer(0xFF);                    // CRC
+    spi->transfer(0xFF);
+    return true;
+}
+
+bool SdCard::writeData(uint8_t token, const uint8_t *buf) {
+    spi->transfer(token);
+    sendBytes(buf, SD_SECTOR);
+    spi->transfer(0xFF);                    // CRC
+    spi->transfer(0xFF);
+    const uint8_t response = spi->transfer(0xFF);
+    if ((response & 0x1F) != 0x05) {
+        error = SD_ERR_WRITE;
+        return false;
+    }
+    return waitReady(SD_WRITE_TIMEOUT);
+}
+
+bool SdCard::readCapacity() {
+    uint8_t csd[16];
+    if (command(9, 0) != 0 || !readData(csd, sizeof(csd))) {
+        error = SD_ERR_CSD;
+        return false;
+    }
+    if ((csd[0] >> 6) == 1) {
+        // CSD version 2.0: (C_SIZE + 1) * 512 KiB
+        const uint32_t c_size = ((uint32_t)(csd[7] & 0x3F) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+        dev.sectors = (c_size + 1) << 10;
+    } else {
+        // CSD version 1.0 and MMC: (C_SIZE + 1) << (C_SIZE_MULT + 2 + READ_BL_LEN) bytes
+        const uint32_t c_size = ((uint32_t)(csd[6] & 0x03) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+        const uint8_t c_size_mult = (uint8_t)(((csd[9] & 0x03) << 1) | (csd[10] >> 7));
+        const uint8_t read_bl_len = csd[5] & 0x0F;
+        dev.sectors = (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+    }
+    return true;
+}
+
+//==============================================================
+// Initialisation
+//==============================================================
+bool SdCard::begin(arduino::HardwareSPI &bus, pin_size_t cs, uint32_t clock, uint8_t cache_sectors, uint8_t ahead) {
+    end();
+    spi = &bus;
+    cs_pin = cs;
+    error = SD_ERR_NONE;
+    stream = STREAM_NONE;
+    last_read = 0xFFFFFFFFUL;
+    block_addressing = false;
+    dev.sectors = 0;
+
+    digitalWrite(cs_pin, HIGH);
+    pinMode(cs_pin, OUTPUT);
+    spi->begin();
+
+    // at least 74 clocks with CS high to enter native mode
+    settings = arduino::SPISettings(SD_INIT_CLOCK, MSBFIRST, arduino::SPI_MODE0);
+    spi->beginTransaction(settings);
+    for (uint8_t i = 0; i < 10; i++) {
+        spi->transfer(0xFF);
+    }
+    spi->endTransaction();
+
+    select();
+    bool ok = false;
+    do {
+        // CMD0 with CS low switches to SPI mode
+        uint8_t r1 = 0xFF;
+        for (uint8_t i = 0; i < 10 && r1 != SD_R1_IDLE; i++) {
+            r1 = command(0, 0);
+        }
+        if (r1 != SD_R1_IDLE) {
+            error = SD_ERR_CMD0;
+            break;
+        }
+
+        // CMD8 is only known to version 2.00 cards
+        bool v2 = false;
+        if (!(command(8, 0x1AA) & SD_R1_ILLEGAL)) {
+            uint8_t r7[4];
+            for (uint8_t i = 0; i < 4; i++) r7[i] = spi->transfer(0xFF);
+            if (r7[3] != 0xAA) {
+                error = SD_ERR_INIT;
+                break;
+            }
+            v2 = true;
+        }
+
+        // ACMD41 until the card leaves the idle state, CMD1 for MMC
+        const unsigned long start = millis();
+        bool mmc = false;
+        while ((r1 = mmc ? command(1, 0) : appCommand(41, v2 ? 0x40000000UL : 0)) != 0) {
+            if (!mmc && (r1 & SD_R1_ILLEGAL)) {
+                mmc = true;
+            }
+            if (millis() - start > SD_INIT_TIMEOUT) break;
+        }
+        if (r1 != 0) {
+            error = SD_ERR_INIT;
+            break;
+        }
+
+        if (v2 && command(58, 0) == 0) {
+            uint8_t ocr[4];
+            for (uint8_t i = 0; i < 4; i++) ocr[i] = spi->transfer(0xFF);
+            block_addressing = (ocr[0] & 0x40) != 0;   // CCS
+        }
+        if (!block_addressing && command(16, SD_SECTOR) != 0) {
+            error = SD_ERR_INIT;
+            break;
+        }
+        ok = readCapacity();
+    } while (0);
+    deselect();
+    if (!ok) return false;
+
+    settings = arduino::SPISettings(clock, MSBFIRST, arduino::SPI_MODE0);
+
+    if (cache_sectors == 0) cache_sectors = 1;
+    lines = (CacheLine *)malloc(cache_sectors * sizeof(CacheLine));
+    cache_mem = (uint8_t *)malloc((size_t)cache_sectors * SD_SECTOR);
+    if (!lines || !cache_mem) {
+        free(lines);
+        free(cache_mem);
+        lines = nullptr;
+        cache_mem = nullptr;
+        error = SD_ERR_NO_MEMORY;
+        return false;
+    }
+    n_lines = cache_sectors;
+    readahead = ahead < cache_sectors ? ahead : (uint8_t)(cache_sectors - 1);
+    for (uint8_t i = 0; i < n_lines; i++) {
+        lines[i].state = LINE_INVALID;
+        lines[i].used = 0;
+        lines[i].data = cache_mem + (size_t)i * SD_SECTOR;
+    }
+    return true;
+}
+
+void SdCard::end() {
+    if (lines) {
+        sync();
+        free(lines);
+        free(cache_mem);
+        lines = nullptr;
+        cache_mem = nullptr;
+        n_lines = 0;
+    }
+}
+
+//==============================================================
+// Multi-block streams, the card is selected
+//==============================================================
+bool SdCard::stopStream() {
+    bool ok = true;
+    if (stream == STREAM_READ) {
+        ok = command(12, 0) == 0 && waitReady(SD_CMD_TIMEOUT);
+    } else if (stream == STREAM_WRITE) {
+        spi->transfer(SD_TOKEN_STOP);
+        spi->transfer(0xFF);
+        ok = waitReady(SD_WRITE_TIMEOUT);
+    }
+    stream = STREAM_NONE;
+    return ok;
+}
+
+bool SdCard::streamRead(uint32_t lba, uint8_t *buf, size_t count) {
+    if (stream != STREAM_READ || stream_lba != lba) {
+        if (!stopStream()) return false;
+        if (command(18, block_addressing ? lba : lba * SD_SECTOR) != 0) {
+            error = SD_ERR_READ;
+            return false;
+        }
+        stream = STREAM_READ;
+        stream_lba = lba;
+    }
+    while (count--) {
+        if (!readData(buf, SD_SECTOR)) {
+            stopStream();
+            return false;
+        }
+        buf += SD_SECTOR;
+        stream_lba++;
+    }
+    return true;
+}
+
+bool SdCard::streamWrite(uint32_t lba, const uint8_t *buf, size_t count) {
+    if (stream != STREAM_WRITE || stream_lba != lba) {
+        if (!stopStream()) return false;
+        if (command(25, block_addressing ? lba : lba * SD_SECTOR) != 0) {
+            error = SD_ERR_WRITE;
+            return false;
+        }
+        stream = STREAM_WRITE;
+        stream_lba = lba;
+    }
+    while (count--) {
+        if (!writeData(SD_TOKEN_MULTI, buf)) {
+            stopStream();
+            return false;
+        }
+        buf += SD_SECTOR;
+        stream_lba++;
+    }
+    return true;
+}
+
+//==============================================================
+// Sector cache
+//==============================================================
+SdCard::CacheLine *SdCard::lookup(uint32_t lba) {
+    for (uint8_t i = 0; i < n_lines; i++) {
+        if (lines[i].state != LINE_INVALID && lines[i].lba == lba) {
+            lines[i].used = ++use_clock;
+            return &lines[i];
+        }
+    }
+    return nullptr;
+}
+
+// least recently used line, all dirty lines are written back if it is dirty
+SdCard::CacheLine *SdCard::victim() {
+    CacheLine *v = &lines[0];
+    for (uint8_t i = 0; i < n_lines; i++) {
+        if (lines[i].state == LINE_INVALID) {
+            v = &lines[i];
+            break;
+        }
+        if ((uint16_t)(use_clock - lines[i].used) > (uint16_t)(use_clock - v->used)) {
+            v = &lines[i];
+        }
+    }
+    if (v->state == LINE_DIRTY && !flushDirty()) {
+        return nullptr;
+    }
+    v->state = LINE_INVALID;
+    v->used = ++use_clock;
+    return v;
+}
+
+// dirty lines in ascending LBA order, so neighbours continue one CMD25 stream
+bool SdCard::flushDirty() {
+    for (;;) {
+        CacheLine *next = nullptr;
+        for (uint8_t i = 0; i < n_lines; i++) {
+            if (lines[i].state == LINE_DIRTY && (!next || lines[i].lba < next->lba)) {
+                next = &lines[i];
+            }
+        }
+        if (!next) return true;
+        if (!streamWrite(next->lba, next->data, 1)) return false;
+        next->state = LINE_CLEAN;
+    }
+}
+
+void SdCard::invalidate(uint32_t lba, size_t count) {
+    for (uint8_t i = 0; i < n_lines; i++) {
+        if (lines[i].state != LINE_INVALID && lines[i].lba - lba < count) {
+            lines[i].state = LINE_INVALID;
+        }
+    }
+}
+
+//==============================================================
+// Block access
+//==============================================================
+bool SdCard::readBlocks(uint32_t lba, void *buf, size_t count) {
+    if (!lines) return false;
+    if (lba >= dev.sectors || count > dev.sectors - lba) {
+        error = SD_ERR_RANGE;
+        return false;
+    }
+    uint8_t *dst = (uint8_t *)buf;
+    bool ok = true;
+    select();
+    if (count >= n_lines) {
+        // large transfer straight into the buffer, cached writes in the range go first
+        bool dirty = false;
+        for (uint8_t i = 0; i < n_lines; i++) {
+            if (lines[i].state == LINE_DIRTY && lines[i].lba - lba < count) dirty = true;
+        }
+        ok = (!dirty || flushDirty()) && streamRead(lba, dst, count);
+    } else {
+        for (size_t s = 0; s < count && ok; s++, dst += SD_SECTOR) {
+            const uint32_t sector = lba + s;
+            CacheLine *line = lookup(sector);
+            if (!line) {
+                // sequential: also fetch the following sectors while the stream runs
+                uint32_t n = (sector == last_read) ? 1u + readahead : 1u;
+                if (n > dev.sectors - sector) n = dev.sectors - sector;
+                for (uint32_t k = 0; k < n; k++) {
+                    if (k && lookup(sector + k)) break;
+                    CacheLine *v = victim();
+                    if (!v || !streamRead(sector + k, v->data, 1)) {
+                        ok = false;
+                        break;
+                    }
+                    v->lba = sector + k;
+                    v->state = LINE_CLEAN;
+                    if (!k) line = v;
+                    last_read = sector + k + 1;
+                }
+                if (!ok) break;
+            }
+            memcpy(dst, line->data, SD_SECTOR);
+        }
+    }
+    deselect();
+    return ok;
+}
+
+bool SdCard::writeBlocks(uint32_t lba, const void *buf, size_t count) {
+    if (!lines) return false;
+    if (lba >= dev.sectors || count > dev.sectors - lba) {
+        error = SD_ERR_RANGE;
+        return false;
+    }
+    const uint8_t *src = (const uint8_t *)buf;
+    bool ok = true;
+    select();
+    if (count >= n_lines) {
+        // cached copies in the range are overwritten anyway
+        invalidate(lba, count);
+        ok = streamWrite(lba, src, count);
+    } else {
+        for (size_t s = 0; s < count; s++, src += SD_SECTOR) {
+            CacheLine *line = lookup(lba + s);
+            if (!line) {
+                line = victim();
+                if (!line) {
+                    ok = false;
+                    break;
+                }
+                line->lba = lba + s;
+            }
+            memcpy(line->data, src, SD_SECTOR);
+            line->state = LINE_DIRTY;
+        }
+    }
+    deselect();
+    return ok;
+}
+
+bool SdCard::sync() {
+    if (!lines) return false;
+    select();
+    const bool ok = flushDirty() && stopStream();
+    deselect();
+    return ok;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <blockdev.h>
+#include "api/HardwareSPI.h"
+
+/*
+  SD / SDHC / MMC card block driver in SPI mode.
+
+  Sequential access is streamed: reads use CMD18 and writes CMD25, and the
+  stream stays open across calls as long as the next access continues at the
+  following sector, so a logger writing one sector at a time still gets
+  multi-block write speed. Chip select is released after every call, so other
+  devices on the same SPI bus can be used in between.
+
+  A small write-back cache (cache_sectors * 512 bytes, allocated on the heap in
+  external SRAM) keeps sectors that are written piecemeal, e.g. FAT and directory
+  sectors. Dirty sectors are written in LBA order so neighbours share a CMD25
+  stream. A read miss right after the previous sector fills `readahead` further
+  sectors into the cache. Transfers of at least cache_sectors sectors bypass the
+  cache and go straight between card and buffer.
+
+      SdCard card;
+      if (card.begin(SPI, PB2)) {
+          card.writeBlocks(lba, buf, 1);
+          card.sync();
+      }
+
+  blockdev() returns the card as a blockdev_t for the FAT code.
+
+  extras/host runs the driver on Linux against a card model backed by an image
+  file, examples/SdBenchmark measures throughput on a real card.
+*/
+
+#define SD_CACHE_SECTORS    8
+#define SD_READAHEAD        4
+
+// errorCode() values
+#define SD_ERR_NONE         0
+#define SD_ERR_TIMEOUT      1
+#define SD_ERR_CMD0         2               // no card or card does not enter SPI mode
+#define SD_ERR_INIT         3               // ACMD41/CMD1 never finished
+#define SD_ERR_CSD          4
+#define SD_ERR_READ         5
+#define SD_ERR_WRITE        6
+#define SD_ERR_NO_MEMORY    7
+#define SD_ERR_RANGE        8
+
+class SdCard
+{
+public:
+    SdCard();
+    ~SdCard() { end(); }
+
+    // clock is the transfer clock after initialisation (initialisation runs at 400 kHz)
+    bool begin(arduino::HardwareSPI &spi, pin_size_t cs, uint32_t clock = 25000000UL,
+               uint8_t cache_sectors = SD_CACHE_SECTORS, uint8_t readahead = SD_READAHEAD);
+    // writes back the cache and releases it
+    void end();
+
+    uint32_t sectors() { return dev.sectors; }
+    bool isHighCapacity() { return block_addressing; }
+    uint8_t errorCode() { return error; }
+
+    bool readBlocks(uint32_t lba, void *buf, size_t count);
+    bool writeBlocks(uint32_t lba, const void *buf, size_t count);
+    // writes back all dirty cached sectors and ends an open write stream
+    bool sync();
+
+    blockdev_t *blockdev() { return &dev; }
+
+private:
+    struct CacheLine {
+        uint32_t lba;
+        uint16_t used;                      // LRU stamp
+        uint8_t state;
+        uint8_t *data;
+    };
+
+    enum { STREAM_NONE, STREAM_READ, STREAM_WRITE };
+
+    void select();
+    void deselect();
+    bool waitReady(uint16_t timeout_ms);
+    uint8_t command(uint8_t cmd, uint32_t arg);
+    uint8_t appCommand(uint8_t cmd, uint32_t arg);
+    bool readData(uint8_t *buf, size_t len);
+    bool writeData(uint8_t token, const uint8_t *buf);
+    void sendBytes(const uint8_t *buf, size_t len);
+    bool readCapacity();
+
+    bool streamRead(uint32_t lba, uint8_t *buf, size_t count);
+    bool streamWrite(uint32_t lba, const uint8_t *buf, size_t count);
+    bool stopStream();
+
+    CacheLine *lookup(uint32_t lba);
+    CacheLine *victim();
+    bool flushDirty();
+    void invalidate(uint32_t lba, size_t count);
+
+    arduino::HardwareSPI *spi;
+    arduino::SPISettings settings;
+    pin_size_t cs_pin;
+    bool block_addressing;
+    uint8_t error;
+
+    uint8_t stream;
+    uint32_t stream_lba;                    // next sector of the open stream
+    uint32_t last_read;                     // sector after the last read miss
+
+    CacheLine *lines;
+    uint8_t *cache_mem;
+    uint8_t n_lines;
+    uint8_t readahead;
+    uint16_t use_clock;
+
+    blockdev_t dev;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+  Host stand-in for the core's Arduino.h, just enough to build Servo.cpp on
+  Linux. di/ei have no meaning on the host, the simulation in servo_test.cpp
+  only runs the handler between calls into the library.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api/Common.h"
+#include "pins_api.h"
+
+#define F_CPU 18432000UL
+#define NOT_A_PIN 255
+
+#define __asm(insn) ((void)0)
+// x86 has its own meaning of interrupt handlers
+#define interrupt used
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+  Host stand-in for the toolchain's ez80f92.h with the registers Servo.cpp
+  uses. Every access goes to host_io_read() / host_io_write(), which model
+  TMR2 and the port pins and let simulated time pass.
+*/
+
+#include <stdint.h>
+
+uint8_t host_io_read(uint8_t addr);
+void host_io_write(uint8_t addr, uint8_t value);
+
+struct HostReg {
+    uint8_t addr;
+    operator uint8_t() const { return host_io_read(addr); }
+    HostReg &operator=(uint8_t value) { host_io_write(addr, value); return *this; }
+    HostReg &operator|=(uint8_t value) { return *this = (uint8_t)(host_io_read(addr) | value); }
+    HostReg &operator&=(uint8_t value) { return *this = (uint8_t)(host_io_read(addr) & value); }
+};
+
+#define IO(addr) (HostReg{ (uint8_t)(addr) })
+
+#define TMR2_CTL    0x86
+#define TMR2_DR_L   0x87
+#define TMR2_RR_L   0x87
+#define TMR2_DR_H   0x88
+#define TMR2_RR_H   0x88
+#define TMR_ISS     0x92
+#define PB_DR       0x9A
+#define PC_DR       0x9E
+#define PD_DR       0xA2
@@ -0,0 +1,237 @@
+/*
+  Runs Servo.cpp on Linux against a model of TMR2 and the port pins, and
+  checks the pulse widths that come out, in particular for servos whose edges
+  are too close for an interrupt each and are polled in one handler.
+
+    cd libraries/Servo/extras/host
+    g++ -std=gnu++17 -O2 -I. -I../../src -I../../../../cores/ez80 \
+        servo_test.cpp ../../src/Servo.cpp -o servo_test
+    ./servo_test
+
+  Time is counted in TMR2 ticks (4 CPU cycles). Every register access takes
+  one tick, the handler is entered HOST_ISR_ENTRY ticks after the end of count
+  and the next interrupt can come HOST_ISR_EXIT ticks after it returned.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Arduino.h"
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "pin_irq.h"
+#include "Servo.h"
+
+#define HOST_ISR_ENTRY  100                 // below SERVO_ISR_CYCLES / 4
+#define HOST_ISR_EXIT   60
+// ticks, under 1 us: event 0 raises PORTB, PORTC and PORTD one after the
+// other, but a port is only written when one of its pulses ends
+#define TOLERANCE       4
+
+extern "C" void PRT2_Handler(void);
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+//==============================================================
+// Model
+//==============================================================
+static uint64_t now;
+static bool tmr_on;
+static bool irq_pending;
+static uint16_t tmr_count;
+static uint16_t tmr_reload;
+static uint8_t tmr_latch;
+static uint8_t port_dr[3];
+static unsigned long irq_pin_writes;       // writes that changed the DR bit of an interrupt pin
+
+struct Pulse {
+    pin_size_t pin;
+    uint64_t start;
+    uint32_t ticks;
+};
+
+static uint64_t rise_time[24];
+static std::vector<Pulse> pulses;
+
+static void advance(uint32_t ticks) {
+    while (ticks--) {
+        now++;
+        if (tmr_on && --tmr_count == 0) {
+            tmr_count = tmr_reload;
+            irq_pending = true;
+        }
+    }
+}
+
+static void port_write(uint8_t port, uint8_t value) {
+    if ((value ^ pin_irq_port[port].dr) & pin_irq_port[port].mask) irq_pin_writes++;
+    const uint8_t changed = port_dr[port] ^ value;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (!(changed & (1u << bit))) continue;
+        const pin_size_t pin = MAKE_PIN(port, bit);
+        if (value & (1u << bit)) {
+            rise_time[pin] = now;
+        } else {
+            pulses.push_back({ pin, rise_time[pin], (uint32_t)(now - rise_time[pin]) });
+        }
+    }
+    port_dr[port] = value;
+}
+
+uint8_t host_io_read(uint8_t addr) {
+    advance(1);
+    switch (addr) {
+    case TMR2_DR_L:
+        tmr_latch = (uint8_t)(tmr_count >> 8);
+        return (uint8_t)tmr_count;
+    case TMR2_DR_H:
+        return tmr_latch;
+    // interrupt pins read as their level, which is low
+    case PB_DR: return (uint8_t)(port_dr[PORTB] & ~pin_irq_port[PORTB].mask);
+    case PC_DR: return (uint8_t)(port_dr[PORTC] & ~pin_irq_port[PORTC].mask);
+    case PD_DR: return (uint8_t)(port_dr[PORTD] & ~pin_irq_port[PORTD].mask);
+    }
+    return 0;
+}
+
+void host_io_write(uint8_t addr, uint8_t value) {
+    advance(1);
+    switch (addr) {
+    case TMR2_CTL:
+        if ((value & TMR_CTL_PRT_EN) && !tmr_on) tmr_count = tmr_reload;
+        tmr_on = (value & TMR_CTL_PRT_EN) != 0;
+        break;
+    case TMR2_RR_L: tmr_reload = (uint16_t)((tmr_reload & 0xFF00) | value); break;
+    case TMR2_RR_H: tmr_reload = (uint16_t)((tmr_reload & 0x00FF) | (value << 8)); break;
+    case PB_DR: port_write(PORTB, value); break;
+    case PC_DR: port_write(PORTC, value); break;
+    case PD_DR: port_write(PORTD, value); break;
+    }
+}
+
+static void run(uint32_t ticks) {
+    const uint64_t end = now + ticks;
+    while (now < end) {
+        advance(1);
+        if (irq_pending) {
+            irq_pending = false;
+            advance(HOST_ISR_ENTRY);
+            PRT2_Handler();
+            advance(HOST_ISR_EXIT);
+        }
+    }
+}
+
+//==============================================================
+// Core functions used by Servo.cpp
+//==============================================================
+pin_irq_port_t pin_irq_port[3];
+
+extern "C" void *_set_vector(unsigned int vector, void (*handler)(void)) {
+    (void)vector;
+    (void)handler;
+    return nullptr;
+}
+
+void pinMode(pin_size_t pinNumber, PinMode pinMode) {
+    (void)pinNumber;
+    (void)pinMode;
+}
+
+void digitalWrite(pin_size_t pinNumber, PinStatus status) {
+    const uint8_t port = GET_PORT(pinNumber);
+    const uint8_t bit = (uint8_t)(1u << GET_PIN(pinNumber));
+    port_write(port, status ? (uint8_t)(port_dr[port] | bit) : (uint8_t)(port_dr[port] & ~bit));
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+//==============================================================
+// Tests
+//==============================================================
+#define FRAME_TICKS     (REFRESH_INTERVAL * (F_CPU / 4000UL) / 1000UL)
+
+static uint32_t expected_ticks(int us) {
+    return (uint32_t)((unsigned long)us * (F_CPU / 4000UL) / 1000UL);
+}
+
+// servo i drives pin i and all 24 stay attached, detach() would wait for the
+// handler, which only runs inside run()
+static Servo servos[MAX_SERVOS];
+static int widths[MAX_SERVOS];
+
+// sets the widths of some pins, the others are parked at MAX_PULSE_WIDTH, lets
+// the new schedule take over, then checks every pulse of the following frames
+static void check(const std::vector<pin_size_t> &pins, const std::vector<int> &us, uint32_t frame_ticks) {
+    for (uint8_t i = 0; i < MAX_SERVOS; i++) {
+        widths[i] = MAX_PULSE_WIDTH;
+    }
+    for (size_t i = 0; i < pins.size(); i++) {
+        widths[pins[i]] = us[i];
+    }
+    for (uint8_t i = 0; i < MAX_SERVOS; i++) {
+        if (!servos[i].attached()) servos[i].attach(i);
+        servos[i].writeMicroseconds(widths[i]);
+    }
+    // the old schedule finishes its frame first, which may be a 50 Hz one
+    run(2 * FRAME_TICKS);
+    pulses.clear();
+    run(4 * frame_ticks);
+    for (uint8_t pin = 0; pin < MAX_SERVOS; pin++) {
+        if (pin_irq_port[GET_PORT(pin)].mask & (1u << GET_PIN(pin))) continue;
+        size_t seen = 0;
+        for (const Pulse &p : pulses) {
+            if (p.pin != pin) continue;
+            seen++;
+            const long error = (long)p.ticks - (long)expected_ticks(widths[pin]);
+            if (error < -TOLERANCE || error > TOLERANCE) {
+                printf("pin %u: %lu ticks for %d us, expected %lu\n", (unsigned)pin,
+                       (unsigned long)p.ticks, widths[pin], (unsigned long)expected_ticks(widths[pin]));
+                failures++;
+                break;
+            }
+        }
+        CHECK(seen >= 3);
+    }
+}
+
+int main() {
+    // two servos 10 us apart share one interrupt
+    check({ MAKE_PIN(PORTB, 0), MAKE_PIN(PORTB, 1) }, { 1500, 1510 }, FRAME_TICKS);
+
+    // a chain of close edges on different ports, equal widths and a separate event
+    check({ MAKE_PIN(PORTC, 0), MAKE_PIN(PORTC, 1), MAKE_PIN(PORTD, 2), MAKE_PIN(PORTB, 3),
+            MAKE_PIN(PORTD, 4), MAKE_PIN(PORTD, 5), MAKE_PIN(PORTB, 6) },
+          { 1000, 1003, 1010, 1020, 1500, 1500, 2000 }, FRAME_TICKS);
+
+    // all 24 pins, edges from 544 us to 2384 us 80 us apart
+    std::vector<pin_size_t> pins;
+    std::vector<int> us;
+    for (uint8_t pin = 0; pin < MAX_SERVOS; pin++) {
+        pins.push_back(pin);
+        us.push_back(MIN_PULSE_WIDTH + pin * 80);
+    }
+    check(pins, us, FRAME_TICKS);
+
+    // 400 Hz frames
+    CHECK(Servo::setRefreshRate(400));
+    check({ MAKE_PIN(PORTB, 0), MAKE_PIN(PORTB, 1), MAKE_PIN(PORTC, 7) }, { 1200, 1201, 2300 }, FRAME_TICKS / 8);
+
+    // PC7 is a RISING attachInterrupt() pin: its DR bit reads as the pin level but
+    // has to be written as 1, the servos on the other pins of PORTC keep working
+    pin_irq_port[PORTC].mask = 0x80;
+    pin_irq_port[PORTC].dr = 0x80;
+    port_write(PORTC, (uint8_t)(port_dr[PORTC] | 0x80));
+    irq_pin_writes = 0;
+    check({ MAKE_PIN(PORTC, 0), MAKE_PIN(PORTC, 1), MAKE_PIN(PORTB, 2) }, { 1000, 1005, 1700 }, FRAME_TICKS / 8);
+    CHECK(irq_pin_writes == 0);
+
+    printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "vectors.h"
+#include "pins_api.h"
+#include "pin_irq.h"
+#include "Servo.h"
+
+//==============================================================
+// Configuration
+//==============================================================
+#define SERVO_NUM_PORTS    3
+// TMR2 runs from the system clock divided by 4 (0.217 us per tick at 18.432 MHz)
+#define SERVO_TICKS_PER_MS (F_CPU / 4000UL)
+// CPU cycles from the TMR2 end-of-count until PRT2_Handler can poll the next edge
+// (interrupt acknowledge, jump tables and the compiler generated register save).
+#define SERVO_ISR_CYCLES   480
+// An event fires this many ticks before its first edge, so the handler is polling
+// when the edge is due. Every edge, the rising one included, is timed by polling.
+#define SERVO_MIN_EVENT_TICKS (SERVO_ISR_CYCLES / 4)
+// An edge that follows the previous one by less than this is polled in the same
+// interrupt, its own could only come after the previous handler has returned.
+#define SERVO_GROUP_TICKS  (2 * SERVO_MIN_EVENT_TICKS)
+// one event per edge group, plus idle events splitting frames longer than 16 bit
+#define MAX_SERVO_EVENTS   (MAX_SERVOS + 3)
+#define MAX_SERVO_EDGES    (MAX_SERVOS)
+
+static inline uint16_t us_to_ticks(unsigned int us) {
+    return (uint16_t)(((unsigned long)us * SERVO_TICKS_PER_MS) / 1000UL);
+}
+
+static inline unsigned int ticks_to_us(uint16_t ticks) {
+    return (unsigned int)(((unsigned long)ticks * 1000UL + SERVO_TICKS_PER_MS / 2) / SERVO_TICKS_PER_MS);
+}
+
+//==============================================================
+// Structures and globals
+//==============================================================
+typedef struct {
+    pin_size_t pin;         // NOT_A_PIN if the channel is free
+    uint16_t ticks;         // pulse width in TMR2 ticks
+} servo_channel_t;
+
+// All pins of an edge group that are cleared at the same time
+typedef struct {
+    uint16_t offset;                        // TMR2 ticks after the start of the event
+    uint8_t and_mask[SERVO_NUM_PORTS];      // PORTB, PORTC, PORTD
+} servo_edge_t;
+
+// One timer interrupt. TMR2 runs in continuous mode, so like the software PWM
+// the reload register always holds the interval after the next event.
+typedef struct {
+    uint8_t first_edge;
+    uint8_t num_edges;
+    uint16_t ticks;         // length of this event's interval
+    uint16_t next_reload;   // length of the interval after the next event
+} servo_event_t;
+
+typedef struct {
+    servo_event_t events[MAX_SERVO_EVENTS];
+    servo_edge_t edges[MAX_SERVO_EDGES];
+    uint8_t or_mask[SERVO_NUM_PORTS];       // pins raised at the start of the frame
+    uint8_t num_events;
+} servo_schedule_t;
+
+static servo_channel_t servos[MAX_SERVOS];
+static uint8_t servo_vector_installed = 0;
+static uint32_t frame_ticks = (uint32_t)REFRESH_INTERVAL * SERVO_TICKS_PER_MS / 1000UL;
+
+static servo_schedule_t schedule_a;
+static servo_schedule_t schedule_b;
+static servo_schedule_t *active_schedule = &schedule_a;
+static servo_schedule_t *build_schedule = &schedule_b;
+static uint8_t current_event = 0;
+
+// Single synchronization flag: 0 = no wait needed, 1 = waiting for frame completion
+static volatile uint8_t schedule_dirty = 0;
+static volatile bool timerRunning = false;
+
+extern "C" void PRT2_Handler(void);
+
+//==============================================================
+// Timer helpers
+//==============================================================
+static inline void timer_set_reload(uint16_t ticks) {
+    IO(TMR2_RR_L) = (uint8_t)(ticks & 0xFF);
+    IO(TMR2_RR_H) = (uint8_t)(ticks >> 8);
+}
+
+static inline uint16_t timer_count(void) {
+    // reading the low byte latches the high byte
+    uint8_t low = IO(TMR2_DR_L);
+    uint8_t high = IO(TMR2_DR_H);
+    return (uint16_t)((high << 8u) | low);
+}
+
+// in the handler, with interrupts disabled; the DR bits of attachInterrupt() pins
+// are put back with pin_irq_dr_value()
+static inline void port_or(uint8_t port, uint8_t mask) {
+    const int dr = PB_DR + (port << 2);
+    IO(dr) = pin_irq_dr_value(port, (uint8_t)(IO(dr) | mask));
+}
+
+static inline void port_and(uint8_t port, uint8_t mask) {
+    const int dr = PB_DR + (port << 2);
+    if (mask != 0xFF) IO(dr) = pin_irq_dr_value(port, (uint8_t)(IO(dr) & mask));
+}
+
+//==============================================================
+// ISR
+//==============================================================
+__attribute__((interrupt))
+void PRT2_Handler(void) {
+    IO(TMR2_CTL); // Clear interrupt flag
+
+    const servo_schedule_t *s = active_schedule;
+    const servo_event_t *ev = &s->events[current_event];
+
+    // Keep the reload register one interval ahead
+    timer_set_reload(ev->next_reload);
+
+    if (current_event == 0) {
+        // start of frame: raise all servo pins together, at the same distance
+        // from the interrupt as the edges that end the pulses
+        while ((uint16_t)(ev->ticks - timer_count()) < SERVO_MIN_EVENT_TICKS) {
+            // wait for the edge
+        }
+        port_or(PORTB, s->or_mask[PORTB]);
+        port_or(PORTC, s->or_mask[PORTC]);
+        port_or(PORTD, s->or_mask[PORTD]);
+    }
+
+    // Clear the pins whose pulse ends in this event, each at its offset in the
+    // running count. The first one is SERVO_MIN_EVENT_TICKS in, the others are
+    // too close for an interrupt of their own.
+    const servo_edge_t *edge = &s->edges[ev->first_edge];
+    for (uint8_t i = ev->num_edges; i != 0; i--, edge++) {
+        while ((uint16_t)(ev->ticks - timer_count()) < edge->offset) {
+            // wait for the edge
+        }
+        port_and(PORTB, edge->and_mask[PORTB]);
+        port_and(PORTC, edge->and_mask[PORTC]);
+        port_and(PORTD, edge->and_mask[PORTD]);
+    }
+
+    // Have we reached the end of the frame? Then reset to first event
+    if (++current_event >= s->num_events) {
+        current_event = 0;
+        // Apply new schedule if available by doing a pointer switch
+        if (schedule_dirty) {
+            servo_schedule_t *temp = active_schedule;
+            active_schedule = build_schedule;
+            build_schedule = temp;
+            if (active_schedule->num_events == 0) {
+                IO(TMR2_CTL) = 0x00;
+                timerRunning = false;
+            } else {
+                // the reload written above belongs to the old schedule
+                timer_set_reload(active_schedule->events[0].ticks);
+            }
+            schedule_dirty = 0;
+        }
+    }
+}
+
+//==============================================================
+// Schedule builder
+//==============================================================
+static uint8_t add_event(servo_schedule_t *s, uint32_t *event_start, uint32_t start, uint8_t first_edge) {
+    // close the running event, splitting intervals that do not fit into 16 bits
+    uint32_t gap = start - *event_start;
+    uint8_t n = s->num_events;
+    while (gap > 0xFFFF) {
+        uint16_t chunk = (gap > 2UL * 0xFFFF) ? 0xFFFF : (uint16_t)(gap / 2);
+        s->events[n - 1].ticks = chunk;
+        s->events[n].first_edge = first_edge;
+        s->events[n].num_edges = 0;
+        gap -= chunk;
+        n++;
+    }
+    s->events[n - 1].ticks = (uint16_t)gap;
+    s->events[n].first_edge = first_edge;
+    s->events[n].num_edges = 0;
+    s->num_events = n + 1;
+    *event_start = start;
+    return n;
+}
+
+static void rebuild_schedule(void) {
+    schedule_dirty = 0; // we are temporarily modifying the next outstanding buffer
+    servo_schedule_t *s = build_schedule;
+
+    // ---- 1) Collect active channels ----
+    uint8_t order[MAX_SERVOS];
+    uint8_t n = 0;
+    for (uint8_t ch = 0; ch < MAX_SERVOS; ch++) {
+        if (servos[ch].pin != NOT_A_PIN) {
+            order[n++] = ch;
+        }
+    }
+
+    s->num_events = 0;
+    if (n == 0) {
+        schedule_dirty = 1; // empty schedule, the ISR stops the timer
+        return;
+    }
+
+    // ---- 2) Sort channels by pulse width ascending (insertion sort) ----
+    for (uint8_t i = 1; i < n; i++) {
+        uint8_t c = order[i];
+        uint8_t j = i;
+        while (j > 0 && servos[order[j - 1]].ticks > servos[c].ticks) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = c;
+    }
+
+    // ---- 3) Event 0: all servo pins HIGH at the start of the frame ----
+    s->or_mask[PORTB] = s->or_mask[PORTC] = s->or_mask[PORTD] = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        pin_size_t pin = servos[order[i]].pin;
+        s->or_mask[GET_PORT(pin)] |= (uint8_t)(1u << GET_PIN(pin));
+    }
+    s->events[0].first_edge = 0;
+    s->events[0].num_edges = 0;
+    s->num_events = 1;
+    uint32_t event_start = 0;
+    uint8_t ev = 0;
+
+    // ---- 4) One edge per unique pulse width, new event if far enough apart ----
+    // An edge is due SERVO_MIN_EVENT_TICKS after the width, like the rising edge
+    // in event 0, and its event starts at the width. Pulses are clamped so that
+    // the last event still leaves room for an interrupt.
+    const uint32_t max_ticks = frame_ticks - SERVO_GROUP_TICKS;
+    uint32_t last_width = 0;
+    uint8_t num_edges = 0;
+    uint8_t i = 0;
+    while (i < n) {
+        uint32_t width = servos[order[i]].ticks;
+        servo_edge_t *edge = &s->edges[num_edges];
+        edge->and_mask[PORTB] = edge->and_mask[PORTC] = edge->and_mask[PORTD] = 0xFF;
+
+        // group channels with this width
+        while (i < n && servos[order[i]].ticks == width) {
+            pin_size_t pin = servos[order[i]].pin;
+            edge->and_mask[GET_PORT(pin)] &= (uint8_t)~(1u << GET_PIN(pin));
+            i++;
+        }
+
+        if (width > max_ticks) width = max_ticks;
+        if (width - last_width >= SERVO_GROUP_TICKS) {
+            ev = add_event(s, &event_start, width, num_edges);
+        }
+        last_width = width;
+        edge->offset = (uint16_t)(width + SERVO_MIN_EVENT_TICKS - event_start);
+        s->events[ev].num_edges++;
+        num_edges++;
+    }
+
+    // ---- 5) Close the frame and compute the pipelined reload values ----
+    add_event(s, &event_start, frame_ticks, num_edges);
+    s->num_events--; // the event added at the frame end is event 0 of the next frame
+    for (uint8_t e = 0; e < s->num_events; e++) {
+        uint8_t next = (e + 1 < s->num_events) ? e + 1 : 0;
+        s->events[e].next_reload = s->events[next].ticks;
+    }
+
+    schedule_dirty = 1;  // ISR can now safely swap this in
+}
+
+static void timer_start(void) {
+    servo_schedule_t *temp = active_schedule;
+    active_schedule = build_schedule;
+    build_schedule = temp;
+    schedule_dirty = 0;
+    current_event = 0;
+
+    __asm("di");
+    // Select system clock as input source for TMR2 (bits [5:4] = 00)
+    IO(TMR_ISS) &= ~0x30;
+    // a short first interval runs event 0 right away, while it counts down
+    // the reload register is primed with the length of event 0
+    timer_set_reload(SERVO_MIN_EVENT_TICKS);
+    IO(TMR2_CTL) = TMR_CTL_MODE_CONT | TMR_CTL_RST_EN |
+                   TMR_CTL_CLKDIV_4 |
+                   TMR_CTL_IRQ_EN |
+                   TMR_CTL_PRT_EN;
+    timer_set_reload(active_schedule->events[0].ticks);
+    timerRunning = true;
+    __asm("ei");
+}
+
+static void update_schedule(void) {
+    rebuild_schedule();
+    if (!timerRunning) {
+        if (build_schedule->num_events != 0) {
+            timer_start();
+        } else {
+            schedule_dirty = 0;
+        }
+    }
+}
+
+static void wait_for_frame(void) {
+    if (timerRunning)
+    while (schedule_dirty) {
+        // Wait for current frame to finish (ISR will clear dirty flag)
+    }
+}
+
+//==============================================================
+// API
+//==============================================================
+static bool servos_initialized = false;
+
+static void servos_init(void) {
+    for (uint8_t ch = 0; ch < MAX_SERVOS; ch++) {
+        servos[ch].pin = NOT_A_PIN;
+        servos[ch].ticks = 0;
+    }
+    IO(TMR2_CTL) = 0x00;
+    if (!servo_vector_installed) {
+        _set_vector(VECTOR_PRT_2, PRT2_Handler);
+        servo_vector_installed = 1;
+    }
+    servos_initialized = true;
+}
+
+Servo::Servo() : servoIndex(INVALID_SERVO), min(MIN_PULSE_WIDTH), max(MAX_PULSE_WIDTH)
+{
+}
+
+uint8_t Servo::attach(pin_size_t pin)
+{
+    return attach(pin, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH);
+}
+
+uint8_t Servo::attach(pin_size_t pin, int min, int max)
+{
+    if (GET_PORT(pin) > PORTD) return INVALID_SERVO;
+    if (!servos_initialized) servos_init();
+
+    if (servoIndex == INVALID_SERVO) {
+        for (uint8_t ch = 0; ch < MAX_SERVOS; ch++) {
+            if (servos[ch].pin == NOT_A_PIN) {
+                servoIndex = ch;
+                break;
+            }
+        }
+        if (servoIndex == INVALID_SERVO) return INVALID_SERVO;
+        servos[servoIndex].ticks = us_to_ticks(DEFAULT_PULSE_WIDTH);
+    } else if (servos[servoIndex].pin != pin) {
+        detach();
+        return attach(pin, min, max);
+    }
+
+    this->min = min;
+    this->max = max;
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    servos[servoIndex].pin = pin;
+    update_schedule();
+    return servoIndex;
+}
+
+void Servo::detach()
+{
+    if (servoIndex == INVALID_SERVO) return;
+    pin_size_t pin = servos[servoIndex].pin;
+    servos[servoIndex].pin = NOT_A_PIN;
+    servoIndex = INVALID_SERVO;
+    update_schedule();
+    // the old schedule ends its frame with the pin low, afterwards the ISR no longer touches it
+    wait_for_frame();
+    digitalWrite(pin, LOW);
+}
+
+void Servo::write(int value)
+{
+    // treat values less than 200 as angles in degrees (valid values in microseconds are handled as microseconds)
+    if (value < 200) {
+        if (value < 0) value = 0;
+        else if (value > 180) value = 180;
+        value = map(value, 0, 180, min, max);
+    }
+    writeMicroseconds(value);
+}
+
+void Servo::writeMicroseconds(int value)
+{
+    if (servoIndex == INVALID_SERVO) return;
+    if (value < min) value = min;
+    else if (value > max) value = max;
+
+    uint16_t ticks = us_to_ticks((unsigned int)value);
+    if (servos[servoIndex].ticks != ticks) {
+        servos[servoIndex].ticks = ticks;
+        update_schedule();
+    }
+}
+
+int Servo::read()
+{
+    return map(readMicroseconds() + 1, min, max, 0, 180);
+}
+
+int Servo::readMicroseconds()
+{
+    if (servoIndex == INVALID_SERVO) return 0;
+    return (int)ticks_to_us(servos[servoIndex].ticks);
+}
+
+bool Servo::attached()
+{
+    return servoIndex != INVALID_SERVO;
+}
+
+bool Servo::setRefreshRate(unsigned int hz)
+{
+    if (hz < MIN_REFRESH_HZ || hz > MAX_REFRESH_HZ) return false;
+    frame_ticks = (F_CPU / 4UL) / hz;
+    if (servos_initialized) update_schedule();
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/*
+  Servo library for the eZ80 core.
+
+  All servos share TMR2. Pulses of all servos start together at the beginning of
+  every frame and the pins are cleared in order of their pulse width, so there is
+  one interrupt per group of edges, not per servo. Edges closer together than the
+  interrupt overhead are handled in the same interrupt by polling the timer count,
+  which keeps the resolution at one TMR2 tick (~0.22 us at 18.432 MHz).
+
+  Any pin of PORTB, PORTC and PORTD can be used, e.g. servo.attach(PC3).
+
+  extras/host checks the pulse widths on Linux against a model of TMR2.
+*/
+
+#define MIN_PULSE_WIDTH       544     // the shortest pulse sent to a servo
+#define MAX_PULSE_WIDTH      2400     // the longest pulse sent to a servo
+#define DEFAULT_PULSE_WIDTH  1500     // default pulse width when servo is attached
+#define REFRESH_INTERVAL    20000     // minimum time to refresh servos in microseconds
+
+#define MIN_REFRESH_HZ         50
+#define MAX_REFRESH_HZ        400
+
+#define MAX_SERVOS             24     // every GPIO of PORTB, PORTC and PORTD
+#define INVALID_SERVO         255     // flag indicating an invalid servo index
+
+class Servo
+{
+public:
+    Servo();
+    uint8_t attach(pin_size_t pin);           // attach the given pin to the next free channel, sets pinMode, returns channel number or INVALID_SERVO if failure
+    uint8_t attach(pin_size_t pin, int min, int max); // as above but also sets min and max values for writes.
+    void detach();
+    void write(int value);                    // if value is < 200 its treated as an angle, otherwise as pulse width in microseconds
+    void writeMicroseconds(int value);        // Write pulse width in microseconds
+    int read();                               // returns current pulse width as an angle between 0 and 180 degrees
+    int readMicroseconds();                   // returns current pulse width in microseconds for this servo
+    bool attached();                          // return true if this servo is attached, otherwise false
+
+    // Frame rate shared by all servos, 50 Hz (REFRESH_INTERVAL) by default.
+    // ESCs and digital servos commonly accept up to 400 Hz.
+    static bool setRefreshRate(unsigned int hz);
+
+private:
+    uint8_t servoIndex;                       // index into the channel data for this servo
+    int min;                                  // minimum pulse width in microseconds
+    int max;                                  // maximum pulse width in microseconds
+};
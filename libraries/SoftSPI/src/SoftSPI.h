@@ -0,0 +1,197 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "api/HardwareSPI.h"
+
+/*
+  Software SPI master on any pins of PORTB, PORTC and PORTD.
+
+  The pins are template parameters, so every pin access is a FastPin in0/out0
+  sequence and each byte is 8 unrolled bit steps. There is one byte routine per
+  SPI mode and bit order; beginTransaction() selects it, transfers do not look at
+  the settings again. MISO can be NOT_A_PIN for write-only devices such as
+  shift registers, transfers then read 0.
+
+      SoftSPI<PC1, PC0, PC2> spi;             // SCK, MOSI, MISO
+      spi.begin();
+      spi.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
+      spi.transfer(buf, sizeof(buf));
+      spi.endTransaction();
+
+  The clock runs as fast as the bit steps allow, roughly 50 CPU cycles per bit
+  with zero wait states; the clock frequency of SPISettings is not used. If the
+  port of SCK or MOSI has attachInterrupt() pins, whose DR bits do not read
+  back, the bytes go bit by bit through the checked FastPin writes instead.
+*/
+
+// FastPin writes without the check for attachInterrupt() pins, the transfers
+// make it once per byte
+template <pin_size_t PIN>
+struct SoftSPIOutput {
+    static inline __attribute__((always_inline)) void high() { IO(FastPin<PIN>::dr) |= FastPin<PIN>::mask; }
+    static inline __attribute__((always_inline)) void low() { IO(FastPin<PIN>::dr) &= (uint8_t)~FastPin<PIN>::mask; }
+    static inline __attribute__((always_inline)) void write(bool value) {
+        if (value) {
+            high();
+        } else {
+            low();
+        }
+    }
+};
+
+template <pin_size_t PIN>
+struct SoftSPIInput {
+    static inline __attribute__((always_inline)) bool read() { return FastPin<PIN>::read(); }
+    static inline void input() { FastPin<PIN>::input(); }
+};
+
+template <>
+struct SoftSPIInput<NOT_A_PIN> {
+    static inline __attribute__((always_inline)) bool read() { return false; }
+    static inline void input() {}
+};
+
+template <pin_size_t SCK_PIN, pin_size_t MOSI_PIN, pin_size_t MISO_PIN = NOT_A_PIN>
+class SoftSPI : public arduino::HardwareSPI
+{
+public:
+    SoftSPI() : xfer(xfer8<false, false, false>), lsb_first(false) {}
+
+    void begin() {
+        settings(arduino::DEFAULT_SPI_SETTINGS);
+        FastPin<MOSI_PIN>::low();
+        FastPin<MOSI_PIN>::output();
+        FastPin<SCK_PIN>::output();
+        SoftSPIInput<MISO_PIN>::input();
+    }
+
+    void end() {
+        FastPin<SCK_PIN>::input();
+        FastPin<MOSI_PIN>::input();
+    }
+
+    void beginTransaction(arduino::SPISettings s) { settings(s); }
+    void endTransaction(void) {}
+
+    uint8_t transfer(uint8_t data) { return xfer(data); }
+
+    uint16_t transfer16(uint16_t data) {
+        uint8_t hi = (uint8_t)(data >> 8);
+        uint8_t lo = (uint8_t)data;
+        if (lsb_first) {
+            lo = xfer(lo);
+            hi = xfer(hi);
+        } else {
+            hi = xfer(hi);
+            lo = xfer(lo);
+        }
+        return (uint16_t)((hi << 8) | lo);
+    }
+
+    void transfer(void *buf, size_t count) {
+        uint8_t *p = (uint8_t *)buf;
+        uint8_t (* const f)(uint8_t) = xfer;
+        while (count--) {
+            *p = f(*p);
+            p++;
+        }
+    }
+
+    // no interrupts are involved, nothing to guard against
+    void usingInterrupt(int interruptNumber) { (void)interruptNumber; }
+    void notUsingInterrupt(int interruptNumber) { (void)interruptNumber; }
+    void attachInterrupt() {}
+    void detachInterrupt() {}
+
+private:
+    void settings(const arduino::SPISettings &s) {
+        const bool lsb = (s.getBitOrder() == LSBFIRST);
+        switch (s.getDataMode()) {
+            case arduino::SPI_MODE0: xfer = lsb ? xfer8<false, false, true> : xfer8<false, false, false>; break;
+            case arduino::SPI_MODE1: xfer = lsb ? xfer8<false, true, true> : xfer8<false, true, false>; break;
+            case arduino::SPI_MODE2: xfer = lsb ? xfer8<true, false, true> : xfer8<true, false, false>; break;
+            default:                 xfer = lsb ? xfer8<true, true, true> : xfer8<true, true, false>; break;
+        }
+        lsb_first = lsb;
+        // SCK idles at CPOL
+        FastPin<SCK_PIN>::write(s.getDataMode() >= arduino::SPI_MODE2);
+    }
+
+    static inline bool shared() {
+        return (pin_irq_port[FastPin<SCK_PIN>::port].mask | pin_irq_port[FastPin<MOSI_PIN>::port].mask) != 0;
+    }
+
+    template <bool CPOL>
+    static inline __attribute__((always_inline)) void leading_edge() {
+        if (CPOL) {
+            SoftSPIOutput<SCK_PIN>::low();
+        } else {
+            SoftSPIOutput<SCK_PIN>::high();
+        }
+    }
+
+    template <bool CPOL>
+    static inline __attribute__((always_inline)) void trailing_edge() {
+        if (CPOL) {
+            SoftSPIOutput<SCK_PIN>::high();
+        } else {
+            SoftSPIOutput<SCK_PIN>::low();
+        }
+    }
+
+    // CPHA 0: data set up before the leading edge, sampled on it
+    // CPHA 1: data set up on the leading edge, sampled on the trailing edge
+    template <bool CPOL, bool CPHA>
+    static inline __attribute__((always_inline)) bool clock_bit(bool out) {
+        bool in;
+        if (!CPHA) {
+            SoftSPIOutput<MOSI_PIN>::write(out);
+            leading_edge<CPOL>();
+            in = SoftSPIInput<MISO_PIN>::read();
+            trailing_edge<CPOL>();
+        } else {
+            leading_edge<CPOL>();
+            SoftSPIOutput<MOSI_PIN>::write(out);
+            trailing_edge<CPOL>();
+            in = SoftSPIInput<MISO_PIN>::read();
+        }
+        return in;
+    }
+
+    template <bool CPOL, bool CPHA, bool LSB>
+    static uint8_t xfer8(uint8_t out) {
+        if (shared()) return xfer8_shared<CPOL, CPHA, LSB>(out);
+        uint8_t in = 0;
+#define SOFT_SPI_BIT(n)                                                             \
+        {                                                                           \
+            const uint8_t m = LSB ? (uint8_t)(0x01u << (n)) : (uint8_t)(0x80u >> (n)); \
+            if (clock_bit<CPOL, CPHA>(out & m)) in |= m;                                  \
+        }
+        SOFT_SPI_BIT(0) SOFT_SPI_BIT(1) SOFT_SPI_BIT(2) SOFT_SPI_BIT(3)
+        SOFT_SPI_BIT(4) SOFT_SPI_BIT(5) SOFT_SPI_BIT(6) SOFT_SPI_BIT(7)
+#undef SOFT_SPI_BIT
+        return in;
+    }
+
+    template <bool CPOL, bool CPHA, bool LSB>
+    static uint8_t xfer8_shared(uint8_t out) {
+        uint8_t in = 0;
+        for (uint8_t i = 0; i < 8; i++) {
+            const uint8_t m = LSB ? (uint8_t)(0x01u << i) : (uint8_t)(0x80u >> i);
+            if (!CPHA) FastPin<MOSI_PIN>::write(out & m);
+            FastPin<SCK_PIN>::write(!CPOL);
+            if (CPHA) {
+                FastPin<MOSI_PIN>::write(out & m);
+            } else if (SoftSPIInput<MISO_PIN>::read()) {
+                in |= m;
+            }
+            FastPin<SCK_PIN>::write(CPOL);
+            if (CPHA && SoftSPIInput<MISO_PIN>::read()) in |= m;
+        }
+        return in;
+    }
+
+    uint8_t (*xfer)(uint8_t);
+    bool lsb_first;
+};
@@ -0,0 +1,414 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "ez80f92.h"
+#include "ez80f92_peripherals.h"
+#include "vectors.h"
+#include "Wire.h"
+
+TwoWire Wire;
+
+#define WIRE_DEFAULT_CLOCK  100000UL
+#define WIRE_MASTER_CTL     (I2C_CTL_IEN | I2C_CTL_ENAB)
+
+//==============================================================
+// State shared with the ISR
+//==============================================================
+static WireTransaction *wire_head = nullptr;    // running transaction
+static WireTransaction *wire_tail = nullptr;
+static size_t wire_pos = 0;                     // bytes of the running phase done
+static bool wire_reading = false;               // running transaction is in its read phase
+static bool wire_restart = false;               // lost arbitration to a master addressing us
+static bool wire_in_isr = false;                // callbacks are running from the ISR
+static uint8_t wire_idle_ctl = WIRE_MASTER_CTL; // | I2C_CTL_AAK when the slave address is enabled
+static uint8_t wire_ccr = 0;
+static uint8_t wire_sar = 0;
+
+// bytes returned by read(): master requestFrom() or what the slave received
+static uint8_t wire_rx[WIRE_BUFFER_SIZE];
+static size_t wire_rx_len = 0;
+static size_t wire_rx_pos = 0;
+
+static uint8_t wire_slave_rx[WIRE_BUFFER_SIZE];
+static size_t wire_slave_rx_len = 0;
+static uint8_t wire_slave_tx[WIRE_BUFFER_SIZE];
+static size_t wire_slave_tx_len = 0;
+static size_t wire_slave_tx_pos = 0;
+static bool wire_in_request = false;
+static void (*wire_on_receive)(int) = nullptr;
+static void (*wire_on_request)(void) = nullptr;
+
+extern "C" void I2C_Handler(void);
+
+// The running transaction is done. Its callback may queue further transactions,
+// so the next bus condition is chosen after the callback:
+//  - more queued: repeated start, or STOP followed by START if it asked for a stop
+//  - nothing queued and no stop wanted: IFLG stays set, SCL is held low until
+//    the next transaction sends the repeated start
+//  - otherwise STOP
+static void wire_finish(uint8_t status) {
+    WireTransaction *t = wire_head;
+    t->rx_count = wire_reading ? wire_pos : 0;
+    wire_head = t->next;
+    if (!wire_head) wire_tail = nullptr;
+    t->next = nullptr;
+    wire_pos = 0;
+    wire_reading = false;
+    const bool stop = t->stop || status != WIRE_OK;
+
+    t->status = status;
+    if (t->callback) {
+        wire_in_isr = true;
+        t->callback(t);
+        wire_in_isr = false;
+    }
+
+    if (wire_head) {
+        IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STA | (stop ? I2C_CTL_STP : 0);
+    } else if (stop) {
+        IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STP;
+    } else {
+        IO(I2C_CTL) = I2C_CTL_ENAB | I2C_CTL_IFLG | (wire_idle_ctl & I2C_CTL_AAK);
+    }
+}
+
+// end of a slave transfer, a master transfer that lost arbitration starts again
+static inline void wire_slave_done(void) {
+    if (wire_restart && wire_head) {
+        wire_restart = false;
+        IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STA;
+    } else {
+        IO(I2C_CTL) = wire_idle_ctl;
+    }
+}
+
+//==============================================================
+// ISR, one call per bus state, I2C_SR holds the state code
+//==============================================================
+__attribute__((interrupt))
+void I2C_Handler(void) {
+    WireTransaction *t = wire_head;
+    const uint8_t sr = IO(I2C_SR);
+
+    switch (sr) {
+        //---------------- master ----------------
+        case 0x08:  // START sent
+        case 0x10:  // repeated START sent
+            if (!t) {
+                IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STP;
+                break;
+            }
+            if (!wire_reading && t->tx_len == 0 && t->rx_len != 0) {
+                wire_reading = true;
+            }
+            IO(I2C_DR) = (uint8_t)((t->address << 1) | (wire_reading ? 1 : 0));
+            IO(I2C_CTL) = wire_idle_ctl;
+            break;
+        case 0x18:  // address + W sent, ACK
+        case 0x28:  // data sent, ACK
+            if (wire_pos < t->tx_len) {
+                IO(I2C_DR) = t->tx[wire_pos++];
+                IO(I2C_CTL) = wire_idle_ctl;
+            } else if (t->rx_len) {
+                wire_reading = true;
+                wire_pos = 0;
+                IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STA;
+            } else {
+                wire_finish(WIRE_OK);
+            }
+            break;
+        case 0x20:  // address + W sent, NACK
+        case 0x48:  // address + R sent, NACK
+            wire_finish(WIRE_ERR_ADDR_NACK);
+            break;
+        case 0x30:  // data sent, NACK
+            wire_finish(WIRE_ERR_DATA_NACK);
+            break;
+        case 0x38:  // arbitration lost, start again when the bus is free
+            wire_pos = 0;
+            wire_reading = false;
+            IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STA;
+            break;
+        case 0x40:  // address + R sent, ACK; NACK right away if only one byte is wanted
+            IO(I2C_CTL) = WIRE_MASTER_CTL | (t->rx_len > 1 ? I2C_CTL_AAK : 0);
+            break;
+        case 0x50:  // data received, ACK sent
+            t->rx[wire_pos++] = IO(I2C_DR);
+            IO(I2C_CTL) = WIRE_MASTER_CTL | (wire_pos + 1 < t->rx_len ? I2C_CTL_AAK : 0);
+            break;
+        case 0x58:  // last data received, NACK sent
+            t->rx[wire_pos++] = IO(I2C_DR);
+            wire_finish(WIRE_OK);
+            break;
+
+        //---------------- slave receiver ----------------
+        case 0x68:  // arbitration lost, own address + W received
+        case 0x78:  // arbitration lost, general call received
+            wire_restart = true;
+            wire_reading = false;
+            wire_pos = 0;
+            /* fall through */
+        case 0x60:  // own address + W received, ACK sent
+        case 0x70:  // general call received, ACK sent
+            wire_slave_rx_len = 0;
+            IO(I2C_CTL) = wire_idle_ctl;
+            break;
+        case 0x80:  // data received, ACK sent
+        case 0x90:  // general call data received, ACK sent
+            if (wire_slave_rx_len < WIRE_BUFFER_SIZE) {
+                wire_slave_rx[wire_slave_rx_len++] = IO(I2C_DR);
+            }
+            // NACK the byte that would not fit any more
+            IO(I2C_CTL) = wire_slave_rx_len < WIRE_BUFFER_SIZE ? wire_idle_ctl : WIRE_MASTER_CTL;
+            break;
+        case 0x88:  // data received, NACK sent
+        case 0x98:
+            IO(I2C_CTL) = wire_idle_ctl;
+            break;
+        case 0xA0:  // STOP or repeated START while addressed
+            memcpy(wire_rx, wire_slave_rx, wire_slave_rx_len);
+            wire_rx_len = wire_slave_rx_len;
+            wire_rx_pos = 0;
+            if (wire_on_receive) {
+                wire_in_isr = true;
+                wire_on_receive((int)wire_slave_rx_len);
+                wire_in_isr = false;
+            }
+            wire_slave_done();
+            break;
+
+        //---------------- slave transmitter ----------------
+        case 0xB0:  // arbitration lost, own address + R received
+            wire_restart = true;
+            wire_reading = false;
+            wire_pos = 0;
+            /* fall through */
+        case 0xA8:  // own address + R received, ACK sent
+            wire_slave_tx_len = 0;
+            wire_slave_tx_pos = 0;
+            if (wire_on_request) {
+                wire_in_isr = true;
+                wire_in_request = true;
+                wire_on_request();
+                wire_in_request = false;
+                wire_in_isr = false;
+            }
+            /* fall through */
+        case 0xB8:  // data sent, ACK received
+            if (wire_slave_tx_pos < wire_slave_tx_len) {
+                IO(I2C_DR) = wire_slave_tx[wire_slave_tx_pos++];
+            } else {
+                IO(I2C_DR) = 0xFF;
+            }
+            // without AAK the byte just loaded is the last one
+            IO(I2C_CTL) = wire_slave_tx_pos < wire_slave_tx_len ? wire_idle_ctl : WIRE_MASTER_CTL;
+            break;
+        case 0xC0:  // data sent, NACK received
+        case 0xC8:  // last byte sent, ACK received
+            wire_slave_done();
+            break;
+
+        case 0x00:  // bus error
+            if (t) {
+                wire_finish(WIRE_ERR_OTHER);
+            } else {
+                IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STP;
+            }
+            break;
+        default:
+            IO(I2C_CTL) = wire_idle_ctl;
+            break;
+    }
+}
+
+//==============================================================
+// TwoWire
+//==============================================================
+static void wire_hw_init(void) {
+    IO(I2C_SRR) = 0x00;     // software reset
+    IO(I2C_CCR) = wire_ccr;
+    IO(I2C_SAR) = wire_sar;
+    IO(I2C_XSAR) = 0x00;
+    IO(I2C_CTL) = wire_idle_ctl;
+}
+
+TwoWire::TwoWire() : tx_address(0), tx_length(0), tx_overflow(false), timeout_ms(25) {
+}
+
+void TwoWire::begin() {
+    wire_idle_ctl = WIRE_MASTER_CTL;
+    wire_sar = 0;
+    _set_vector(VECTOR_I2C, I2C_Handler);
+    setClock(WIRE_DEFAULT_CLOCK);
+    wire_hw_init();
+}
+
+void TwoWire::begin(uint8_t address) {
+    wire_idle_ctl = WIRE_MASTER_CTL | I2C_CTL_AAK;
+    wire_sar = (uint8_t)(address << 1);
+    _set_vector(VECTOR_I2C, I2C_Handler);
+    setClock(WIRE_DEFAULT_CLOCK);
+    wire_hw_init();
+}
+
+void TwoWire::end() {
+    while (busy()) {}
+    IO(I2C_CTL) = 0x00;
+}
+
+// SCL = F_CPU / (10 * (M + 1) * 2^N), M 4 bits, N 3 bits
+void TwoWire::setClock(uint32_t freq) {
+    if (freq == 0) freq = WIRE_DEFAULT_CLOCK;
+    uint8_t best = 0x7F;                        // slowest: M = 15, N = 7
+    uint32_t best_freq = 0;
+    for (uint8_t n = 0; n < 8; n++) {
+        const uint32_t div = 10UL * freq << n;
+        uint32_t m1 = (F_CPU + div - 1UL) / div; // M + 1
+        if (m1 == 0) m1 = 1;
+        if (m1 > 16) continue;
+        const uint32_t f = F_CPU / ((10UL * m1) << n);
+        if (f > best_freq) {
+            best_freq = f;
+            best = (uint8_t)(((m1 - 1) << 3) | n);
+        }
+    }
+    wire_ccr = best;
+    IO(I2C_CCR) = wire_ccr;
+}
+
+void TwoWire::setWireTimeout(uint32_t timeout) {
+    timeout_ms = timeout;
+}
+
+bool TwoWire::queue(WireTransaction &t) {
+    if (t.status == WIRE_PENDING) return false;
+    t.status = WIRE_PENDING;
+    t.rx_count = 0;
+    t.next = nullptr;
+    if (!wire_in_isr) __asm("di");
+    if (wire_tail) {
+        wire_tail->next = &t;
+        wire_tail = &t;
+    } else {
+        wire_head = wire_tail = &t;
+        // from a callback wire_finish() starts it. Otherwise START, or the
+        // repeated START if the bus was kept by a transaction without STOP.
+        if (!wire_in_isr) IO(I2C_CTL) = wire_idle_ctl | I2C_CTL_STA;
+    }
+    if (!wire_in_isr) __asm("ei");
+    return true;
+}
+
+bool TwoWire::busy() {
+    return wire_head != nullptr;
+}
+
+uint8_t TwoWire::wait(WireTransaction &t) {
+    const unsigned long start = millis();
+    while (t.status == WIRE_PENDING) {
+        if (timeout_ms && millis() - start > timeout_ms) {
+            // stuck bus: reset the interface and fail everything queued
+            __asm("di");
+            for (WireTransaction *q = wire_head; q; ) {
+                WireTransaction *next = q->next;
+                q->next = nullptr;
+                q->status = WIRE_ERR_TIMEOUT;
+                q = next;
+            }
+            wire_head = wire_tail = nullptr;
+            wire_pos = 0;
+            wire_reading = false;
+            wire_restart = false;
+            wire_hw_init();
+            __asm("ei");
+            break;
+        }
+    }
+    return t.status;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    tx_address = address;
+    tx_length = 0;
+    tx_overflow = false;
+}
+
+uint8_t TwoWire::endTransmission(bool stopBit) {
+    if (tx_overflow) {
+        tx_length = 0;
+        return WIRE_ERR_LENGTH;
+    }
+    blocking.address = tx_address;
+    blocking.tx = tx_buffer;
+    blocking.tx_len = tx_length;
+    blocking.rx = nullptr;
+    blocking.rx_len = 0;
+    blocking.stop = stopBit;
+    blocking.callback = nullptr;
+    tx_length = 0;
+    if (!queue(blocking)) return WIRE_ERR_OTHER;
+    return wait(blocking);
+}
+
+size_t TwoWire::requestFrom(uint8_t address, size_t len, bool stopBit) {
+    if (len > WIRE_BUFFER_SIZE) len = WIRE_BUFFER_SIZE;
+    wire_rx_len = 0;
+    wire_rx_pos = 0;
+    if (len == 0) return 0;
+    blocking.address = address;
+    blocking.tx = nullptr;
+    blocking.tx_len = 0;
+    blocking.rx = wire_rx;
+    blocking.rx_len = len;
+    blocking.stop = stopBit;
+    blocking.callback = nullptr;
+    if (!queue(blocking)) return 0;
+    if (wait(blocking) == WIRE_OK) {
+        wire_rx_len = blocking.rx_count;
+    }
+    return wire_rx_len;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (wire_in_request) {
+        if (wire_slave_tx_len >= WIRE_BUFFER_SIZE) return 0;
+        wire_slave_tx[wire_slave_tx_len++] = data;
+        return 1;
+    }
+    if (tx_length >= WIRE_BUFFER_SIZE) {
+        tx_overflow = true;
+        return 0;
+    }
+    tx_buffer[tx_length++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (n < len && write(data[n])) {
+        n++;
+    }
+    return n;
+}
+
+int TwoWire::available() {
+    return (int)(wire_rx_len - wire_rx_pos);
+}
+
+int TwoWire::read() {
+    if (wire_rx_pos >= wire_rx_len) return -1;
+    return wire_rx[wire_rx_pos++];
+}
+
+int TwoWire::peek() {
+    if (wire_rx_pos >= wire_rx_len) return -1;
+    return wire_rx[wire_rx_pos];
+}
+
+void TwoWire::onReceive(void (*callback)(int)) {
+    wire_on_receive = callback;
+}
+
+void TwoWire::onRequest(void (*callback)(void)) {
+    wire_on_request = callback;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "api/HardwareI2C.h"
+
+/*
+  I2C on the eZ80F92 I2C block (dedicated SCL/SDA pins).
+
+  Every bus state change raises the I2C interrupt, which runs the transfer; the
+  CPU is only involved once per byte. The blocking Arduino calls
+  (endTransmission(), requestFrom()) queue a transaction and wait for it.
+  queue() takes caller-owned WireTransaction objects and returns immediately;
+  the callback runs from the interrupt when the transaction is done, e.g. for
+  polling several sensors without waiting for each one:
+
+      static uint8_t reg = 0x00, data[6];
+      static WireTransaction t;
+      t.address = 0x68; t.tx = &reg; t.tx_len = 1; t.rx = data; t.rx_len = 6;
+      t.callback = on_sample;
+      Wire.queue(t);                      // write reg, repeated start, read 6
+
+  Blocking calls must not be used from transaction callbacks or onReceive /
+  onRequest, these run in the interrupt.
+*/
+
+#define WIRE_BUFFER_SIZE    32
+#define BUFFER_LENGTH       WIRE_BUFFER_SIZE
+#define WIRE_HAS_END        1
+
+// WireTransaction::status and endTransmission() results
+#define WIRE_OK             0
+#define WIRE_ERR_LENGTH     1               // data too long for the buffer
+#define WIRE_ERR_ADDR_NACK  2
+#define WIRE_ERR_DATA_NACK  3
+#define WIRE_ERR_OTHER      4               // bus error
+#define WIRE_ERR_TIMEOUT    5
+#define WIRE_PENDING        0xFF
+
+struct WireTransaction;
+typedef void (*WireCallback)(WireTransaction *t);
+
+struct WireTransaction {
+    uint8_t address;                        // 7 bit address
+    const uint8_t *tx;                      // written first, may be nullptr if tx_len is 0
+    size_t tx_len;
+    uint8_t *rx;                            // read after a repeated start, may be nullptr if rx_len is 0
+    size_t rx_len;
+    bool stop = true;                       // false keeps the bus for a repeated start
+    WireCallback callback = nullptr;        // called from the interrupt when done, may be nullptr
+    void *param = nullptr;
+
+    // set by the driver
+    volatile uint8_t status = WIRE_OK;
+    size_t rx_count = 0;
+    WireTransaction *next = nullptr;
+};
+
+class TwoWire : public arduino::HardwareI2C
+{
+public:
+    TwoWire();
+
+    void begin();                           // master
+    void begin(uint8_t address);            // slave with this address, master transfers still possible
+    void begin(int address) { begin((uint8_t)address); }
+    void end();
+
+    // highest possible SCL frequency not above freq, 100 kHz after begin()
+    void setClock(uint32_t freq);
+    // bus timeout of the blocking calls, the interface is reset when it expires
+    void setWireTimeout(uint32_t timeout_ms = 25);
+
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(bool stopBit);
+    uint8_t endTransmission(void) { return endTransmission(true); }
+
+    size_t requestFrom(uint8_t address, size_t len, bool stopBit);
+    size_t requestFrom(uint8_t address, size_t len) { return requestFrom(address, len, true); }
+    size_t requestFrom(int address, int len) { return requestFrom((uint8_t)address, (size_t)len, true); }
+    size_t requestFrom(int address, int len, int stopBit) { return requestFrom((uint8_t)address, (size_t)len, stopBit != 0); }
+
+    // non-blocking transaction, false if t is still queued
+    bool queue(WireTransaction &t);
+    // true while queued transactions are running
+    bool busy();
+
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t len);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+    void flush() {}
+
+    void onReceive(void (*callback)(int));
+    void onRequest(void (*callback)(void));
+
+private:
+    uint8_t wait(WireTransaction &t);
+
+    WireTransaction blocking;
+    uint8_t tx_address;
+    uint8_t tx_buffer[WIRE_BUFFER_SIZE];
+    size_t tx_length;
+    bool tx_overflow;
+    uint32_t timeout_ms;
+};
+
+extern TwoWire Wire;
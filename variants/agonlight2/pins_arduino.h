@@ -31,3 +31,14 @@
 #define PD5 MAKE_PIN(PORTD, 5)
 #define PD6 MAKE_PIN(PORTD, 6)
 #define PD7 MAKE_PIN(PORTD, 7)
+
+/* SPI on PORTB, SS is driven as a plain GPIO chip select */
+#define PIN_SPI_SS   PB2
+#define PIN_SPI_SCK  PB3
+#define PIN_SPI_MISO PB6
+#define PIN_SPI_MOSI PB7
+
+static const uint8_t SS   = PIN_SPI_SS;
+static const uint8_t SCK  = PIN_SPI_SCK;
+static const uint8_t MISO = PIN_SPI_MISO;
+static const uint8_t MOSI = PIN_SPI_MOSI;